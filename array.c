@@ -0,0 +1,51 @@
+#include "lval.h"
+
+/* Returns NULL if room for capacity elements can not be allocated */
+larray* larray_new(long capacity) {
+    larray* a = malloc(sizeof(larray));
+    a->refs = 1;
+    a->count = 0;
+    a->capacity = capacity > 4 ? capacity : 4;
+    a->items = malloc(sizeof(lval*) * a->capacity);
+    if (!a->items) {
+        free(a);
+        return NULL;
+    }
+    return a;
+}
+
+larray* larray_retain(larray* a) {
+    a->refs++;
+    return a;
+}
+
+void larray_release(larray* a) {
+    if (--a->refs > 0) { return; }
+    for (long i = 0; i < a->count; i++) {
+        lval_del(a->items[i]);
+    }
+    free(a->items);
+    free(a);
+}
+
+/* Replaces element i, taking ownership of x */
+void larray_set(larray* a, long i, lval* x) {
+    lval_del(a->items[i]);
+    a->items[i] = x;
+}
+
+/* Appends x, taking ownership. The capacity doubles when full so
+ * pushes take amortised constant time. */
+void larray_push(larray* a, lval* x) {
+    if (a->count == a->capacity) {
+        a->capacity *= 2;
+        a->items = realloc(a->items, sizeof(lval*) * a->capacity);
+    }
+    a->items[a->count++] = x;
+}
+
+/* Removes the last element and hands it to the caller, NULL if empty */
+lval* larray_pop(larray* a) {
+    if (a->count == 0) { return NULL; }
+    return a->items[--a->count];
+}
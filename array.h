@@ -0,0 +1,22 @@
+#ifndef array_h
+#define array_h
+
+struct lval;
+
+/* Growable array of lvals, changed in place and shared by every lval
+ * that refers to it. Elements are owned by the array. */
+typedef struct larray {
+    int refs;
+    long count;
+    long capacity;
+    struct lval** items;
+} larray;
+
+larray* larray_new(long capacity);
+larray* larray_retain(larray* a);
+void larray_release(larray* a);
+void larray_set(larray* a, long i, struct lval* x);
+void larray_push(larray* a, struct lval* x);
+struct lval* larray_pop(larray* a);
+
+#endif
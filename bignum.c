@@ -0,0 +1,476 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "bignum.h"
+
+/* Operands with fewer limbs than this are multiplied with the schoolbook
+ * method, above it Karatsuba's recursion wins */
+#define KARATSUBA_THRESHOLD 32
+
+/***************************************************
+ *  Magnitude helpers (unsigned limb arrays)
+ ***************************************************/
+
+/* Length of a magnitude once leading zero limbs are dropped */
+static int mag_trim(const uint32_t* a, int n) {
+    while (n > 0 && a[n-1] == 0) { n--; }
+    return n;
+}
+
+static int mag_cmp(const uint32_t* a, int n, const uint32_t* b, int m) {
+    n = mag_trim(a, n);
+    m = mag_trim(b, m);
+    if (n != m) { return n < m ? -1 : 1; }
+    for (int i = n - 1; i >= 0; i--) {
+        if (a[i] != b[i]) { return a[i] < b[i] ? -1 : 1; }
+    }
+    return 0;
+}
+
+/* Adds x into r in place. r must be long enough to hold the carry */
+static void mag_add_into(uint32_t* r, int rn, const uint32_t* x, int xn) {
+    uint64_t carry = 0;
+    int i = 0;
+    for (; i < xn; i++) {
+        carry += (uint64_t) r[i] + x[i];
+        r[i] = (uint32_t) carry;
+        carry >>= 32;
+    }
+    for (; carry && i < rn; i++) {
+        carry += r[i];
+        r[i] = (uint32_t) carry;
+        carry >>= 32;
+    }
+}
+
+/* Subtracts x from r in place. Requires r >= x */
+static void mag_sub_into(uint32_t* r, int rn, const uint32_t* x, int xn) {
+    int64_t borrow = 0;
+    int i = 0;
+    for (; i < xn; i++) {
+        borrow += (int64_t) r[i] - x[i];
+        r[i] = (uint32_t) borrow;
+        borrow >>= 32;
+    }
+    for (; borrow && i < rn; i++) {
+        borrow += r[i];
+        r[i] = (uint32_t) borrow;
+        borrow >>= 32;
+    }
+}
+
+/* r += a * b using the schoolbook method. r needs n + m limbs */
+static void mag_mul_school(uint32_t* r, const uint32_t* a, int n,
+        const uint32_t* b, int m) {
+    for (int i = 0; i < n; i++) {
+        uint64_t carry = 0;
+        for (int j = 0; j < m; j++) {
+            carry += (uint64_t) a[i] * b[j] + r[i+j];
+            r[i+j] = (uint32_t) carry;
+            carry >>= 32;
+        }
+        for (int k = i + m; carry; k++) {
+            carry += r[k];
+            r[k] = (uint32_t) carry;
+            carry >>= 32;
+        }
+    }
+}
+
+/* r += a * b. r needs n + m limbs */
+static void mag_mul(uint32_t* r, const uint32_t* a, int n,
+        const uint32_t* b, int m) {
+    /* Keep a as the longer operand */
+    if (n < m) {
+        const uint32_t* t = a; a = b; b = t;
+        int tn = n; n = m; m = tn;
+    }
+    if (m < KARATSUBA_THRESHOLD) {
+        mag_mul_school(r, a, n, b, m);
+        return;
+    }
+
+    int h = n / 2;
+
+    /* Unbalanced operands: split only the longer one */
+    if (m <= h) {
+        uint32_t* t = calloc(n - h + m, sizeof(uint32_t));
+        mag_mul(r, a, h, b, m);
+        mag_mul(t, a + h, n - h, b, m);
+        mag_add_into(r + h, n + m - h, t, n - h + m);
+        free(t);
+        return;
+    }
+
+    /* a = a1*B^h + a0, b = b1*B^h + b0
+     * a*b = z2*B^2h + (z1 - z2 - z0)*B^h + z0 with z1 = (a0+a1)(b0+b1) */
+    int an = n - h, bn = m - h;
+    uint32_t* z0 = calloc(2 * h, sizeof(uint32_t));
+    uint32_t* z2 = calloc(an + bn, sizeof(uint32_t));
+    uint32_t* sa = calloc(an + 1, sizeof(uint32_t));
+    uint32_t* sb = calloc(an + 1, sizeof(uint32_t));
+    uint32_t* z1 = calloc(2 * an + 2, sizeof(uint32_t));
+
+    mag_mul(z0, a, h, b, h);
+    mag_mul(z2, a + h, an, b + h, bn);
+
+    memcpy(sa, a + h, an * sizeof(uint32_t));
+    mag_add_into(sa, an + 1, a, h);
+    memcpy(sb, b, h * sizeof(uint32_t));
+    mag_add_into(sb, an + 1, b + h, bn);
+    mag_mul(z1, sa, an + 1, sb, an + 1);
+
+    mag_sub_into(z1, 2 * an + 2, z0, 2 * h);
+    mag_sub_into(z1, 2 * an + 2, z2, an + bn);
+
+    mag_add_into(r, n + m, z0, 2 * h);
+    mag_add_into(r + h, n + m - h, z1, mag_trim(z1, 2 * an + 2));
+    mag_add_into(r + 2 * h, n + m - 2 * h, z2, an + bn);
+
+    free(z0); free(z2); free(sa); free(sb); free(z1);
+}
+
+/* Divides a in place by a single limb, returning the remainder */
+static uint32_t mag_divmod_small(uint32_t* a, int n, uint32_t d) {
+    uint64_t rem = 0;
+    for (int i = n - 1; i >= 0; i--) {
+        uint64_t cur = (rem << 32) | a[i];
+        a[i] = (uint32_t) (cur / d);
+        rem = cur % d;
+    }
+    return (uint32_t) rem;
+}
+
+/* Long division of a (n limbs) by b (m limbs, m >= 2, top limb non zero).
+ * Quotient goes to q (n - m + 1 limbs), remainder to r (m limbs).
+ * Knuth, TAOCP Vol 2, 4.3.1, Algorithm D */
+static void mag_divmod(uint32_t* q, uint32_t* r, const uint32_t* a, int n,
+        const uint32_t* b, int m) {
+    /* Normalize so the top limb of the divisor has its high bit set */
+    int s = __builtin_clz(b[m-1]);
+    uint32_t* bn = malloc(m * sizeof(uint32_t));
+    uint32_t* an = malloc((n + 1) * sizeof(uint32_t));
+
+    for (int i = m - 1; i > 0; i--) {
+        bn[i] = (b[i] << s) | (s ? (uint32_t) ((uint64_t) b[i-1] >> (32 - s)) : 0);
+    }
+    bn[0] = b[0] << s;
+    an[n] = s ? (uint32_t) ((uint64_t) a[n-1] >> (32 - s)) : 0;
+    for (int i = n - 1; i > 0; i--) {
+        an[i] = (a[i] << s) | (s ? (uint32_t) ((uint64_t) a[i-1] >> (32 - s)) : 0);
+    }
+    an[0] = a[0] << s;
+
+    for (int j = n - m; j >= 0; j--) {
+        /* Estimate the quotient limb from the top two limbs */
+        uint64_t num = ((uint64_t) an[j+m] << 32) | an[j+m-1];
+        uint64_t qhat = num / bn[m-1];
+        uint64_t rhat = num % bn[m-1];
+        while (qhat > UINT32_MAX ||
+                qhat * bn[m-2] > ((rhat << 32) | an[j+m-2])) {
+            qhat--;
+            rhat += bn[m-1];
+            if (rhat > UINT32_MAX) { break; }
+        }
+
+        /* Multiply and subtract */
+        int64_t borrow = 0;
+        uint64_t carry = 0;
+        for (int i = 0; i < m; i++) {
+            carry += qhat * bn[i];
+            borrow += (int64_t) an[i+j] - (uint32_t) carry;
+            an[i+j] = (uint32_t) borrow;
+            carry >>= 32;
+            borrow >>= 32;
+        }
+        borrow += (int64_t) an[j+m] - (int64_t) carry;
+        an[j+m] = (uint32_t) borrow;
+
+        /* Estimate was one too large, add the divisor back */
+        if (borrow < 0) {
+            qhat--;
+            uint64_t c = 0;
+            for (int i = 0; i < m; i++) {
+                c += (uint64_t) an[i+j] + bn[i];
+                an[i+j] = (uint32_t) c;
+                c >>= 32;
+            }
+            an[j+m] += (uint32_t) c;
+        }
+        q[j] = (uint32_t) qhat;
+    }
+
+    /* Unnormalize the remainder */
+    for (int i = 0; i < m; i++) {
+        r[i] = (an[i] >> s) | (s ? (uint32_t) ((uint64_t) an[i+1] << (32 - s)) : 0);
+    }
+
+    free(bn);
+    free(an);
+}
+
+/***************************************************
+ *  Construction
+ ***************************************************/
+
+/* Takes ownership of limbs, trims them and sets the sign */
+static bignum* bignum_make(int sign, uint32_t* limbs, int n) {
+    bignum* x = malloc(sizeof(bignum));
+    x->count = mag_trim(limbs, n);
+    x->sign = x->count ? sign : 0;
+    x->limbs = limbs;
+    return x;
+}
+
+bignum* bignum_from_long(long x) {
+    uint32_t* limbs = malloc(2 * sizeof(uint32_t));
+    /* Negate in unsigned arithmetic so LONG_MIN is safe */
+    unsigned long mag = x < 0 ? -(unsigned long) x : (unsigned long) x;
+    limbs[0] = (uint32_t) mag;
+    limbs[1] = (uint32_t) ((uint64_t) mag >> 32);
+    return bignum_make(x < 0 ? -1 : 1, limbs, 2);
+}
+
+bignum* bignum_from_i128(__int128 x) {
+    uint32_t* limbs = malloc(4 * sizeof(uint32_t));
+    unsigned __int128 mag = x < 0 ? -(unsigned __int128) x : (unsigned __int128) x;
+    for (int i = 0; i < 4; i++) {
+        limbs[i] = (uint32_t) mag;
+        mag >>= 32;
+    }
+    return bignum_make(x < 0 ? -1 : 1, limbs, 4);
+}
+
+/* Parses an optionally signed string of decimal digits */
+bignum* bignum_from_str(const char* s) {
+    int sign = 1;
+    if (*s == '-') { sign = -1; s++; }
+
+    int digits = strlen(s);
+    int cap = digits / 9 + 2;
+    uint32_t* limbs = calloc(cap, sizeof(uint32_t));
+    int n = 0;
+
+    /* Consume nine digits at a time: r = r * 10^9 + chunk */
+    int first = digits % 9 ? digits % 9 : 9;
+    for (int i = 0; i < digits; ) {
+        int len = i == 0 ? first : 9;
+        uint32_t chunk = 0, scale = 1;
+        for (int k = 0; k < len; k++, i++) {
+            chunk = chunk * 10 + (s[i] - '0');
+            scale *= 10;
+        }
+        uint64_t carry = chunk;
+        for (int k = 0; k < n; k++) {
+            carry += (uint64_t) limbs[k] * scale;
+            limbs[k] = (uint32_t) carry;
+            carry >>= 32;
+        }
+        if (carry) { limbs[n++] = (uint32_t) carry; }
+    }
+    return bignum_make(sign, limbs, n);
+}
+
+bignum* bignum_copy(bignum* a) {
+    bignum* x = malloc(sizeof(bignum));
+    x->sign = a->sign;
+    x->count = a->count;
+    x->limbs = malloc((a->count ? a->count : 1) * sizeof(uint32_t));
+    memcpy(x->limbs, a->limbs, a->count * sizeof(uint32_t));
+    return x;
+}
+
+void bignum_del(bignum* a) {
+    free(a->limbs);
+    free(a);
+}
+
+/***************************************************
+ *  Conversion
+ ***************************************************/
+
+bool bignum_fits_long(bignum* a) {
+    if (a->count > 2) { return false; }
+    uint64_t mag = a->count == 0 ? 0 :
+        a->count == 1 ? a->limbs[0] :
+        ((uint64_t) a->limbs[1] << 32) | a->limbs[0];
+    if (a->sign < 0) { return mag <= (uint64_t) LONG_MAX + 1; }
+    return mag <= LONG_MAX;
+}
+
+/* Only valid when bignum_fits_long is true */
+long bignum_to_long(bignum* a) {
+    uint64_t mag = a->count == 0 ? 0 :
+        a->count == 1 ? a->limbs[0] :
+        ((uint64_t) a->limbs[1] << 32) | a->limbs[0];
+    return a->sign < 0 ? (long) -mag : (long) mag;
+}
+
+double bignum_to_double(bignum* a) {
+    double d = 0;
+    for (int i = a->count - 1; i >= 0; i--) {
+        d = d * 4294967296.0 + a->limbs[i];
+    }
+    return a->sign < 0 ? -d : d;
+}
+
+/* Number of bits in the magnitude, 0 for zero */
+long bignum_bits(bignum* a) {
+    if (a->count == 0) { return 0; }
+    return 32L * (a->count - 1) + 32 - __builtin_clz(a->limbs[a->count - 1]);
+}
+
+/* Returns a newly allocated decimal representation */
+char* bignum_to_str(bignum* a) {
+    if (a->sign == 0) {
+        char* s = malloc(2);
+        strcpy(s, "0");
+        return s;
+    }
+
+    /* Peel off base 10^9 chunks from the low end */
+    uint32_t* t = malloc(a->count * sizeof(uint32_t));
+    memcpy(t, a->limbs, a->count * sizeof(uint32_t));
+    int n = a->count;
+    int cap = a->count * 10 / 9 + 2;
+    uint32_t* chunks = malloc(cap * sizeof(uint32_t));
+    int c = 0;
+    do {
+        chunks[c++] = mag_divmod_small(t, n, 1000000000);
+        n = mag_trim(t, n);
+    } while (n > 0);
+
+    char* s = malloc(c * 9 + 2);
+    char* p = s;
+    if (a->sign < 0) { *p++ = '-'; }
+    p += sprintf(p, "%u", chunks[c-1]);
+    for (int i = c - 2; i >= 0; i--) {
+        p += sprintf(p, "%09u", chunks[i]);
+    }
+
+    free(t);
+    free(chunks);
+    return s;
+}
+
+/***************************************************
+ *  Arithmetic
+ ***************************************************/
+
+int bignum_cmp(bignum* a, bignum* b) {
+    if (a->sign != b->sign) { return a->sign < b->sign ? -1 : 1; }
+    int c = mag_cmp(a->limbs, a->count, b->limbs, b->count);
+    return a->sign < 0 ? -c : c;
+}
+
+bignum* bignum_neg(bignum* a) {
+    bignum* x = bignum_copy(a);
+    x->sign = -x->sign;
+    return x;
+}
+
+/* Adds a and b where b's sign is taken to be bsign */
+static bignum* bignum_add_signed(bignum* a, bignum* b, int bsign) {
+    if (b->sign == 0) { return bignum_copy(a); }
+    if (a->sign == 0) {
+        bignum* x = bignum_copy(b);
+        x->sign = bsign;
+        return x;
+    }
+
+    int n = (a->count > b->count ? a->count : b->count) + 1;
+    uint32_t* r = calloc(n, sizeof(uint32_t));
+
+    if (a->sign == bsign) {
+        memcpy(r, a->limbs, a->count * sizeof(uint32_t));
+        mag_add_into(r, n, b->limbs, b->count);
+        return bignum_make(bsign, r, n);
+    }
+
+    /* Opposite signs: subtract the smaller magnitude from the larger */
+    if (mag_cmp(a->limbs, a->count, b->limbs, b->count) >= 0) {
+        memcpy(r, a->limbs, a->count * sizeof(uint32_t));
+        mag_sub_into(r, n, b->limbs, b->count);
+        return bignum_make(a->sign, r, n);
+    }
+    memcpy(r, b->limbs, b->count * sizeof(uint32_t));
+    mag_sub_into(r, n, a->limbs, a->count);
+    return bignum_make(bsign, r, n);
+}
+
+bignum* bignum_add(bignum* a, bignum* b) {
+    return bignum_add_signed(a, b, b->sign);
+}
+
+bignum* bignum_sub(bignum* a, bignum* b) {
+    return bignum_add_signed(a, b, -b->sign);
+}
+
+bignum* bignum_mul(bignum* a, bignum* b) {
+    int n = a->count + b->count;
+    uint32_t* r = calloc(n ? n : 1, sizeof(uint32_t));
+    if (a->sign && b->sign) {
+        mag_mul(r, a->limbs, a->count, b->limbs, b->count);
+    }
+    return bignum_make(a->sign * b->sign, r, n);
+}
+
+/* Truncating division, computing the quotient and/or remainder.
+ * Follows C semantics: the quotient rounds toward zero and the
+ * remainder takes the sign of the dividend. Divisor must be non zero. */
+static void bignum_divmod(bignum* a, bignum* b, bignum** q, bignum** r) {
+    int n = a->count, m = b->count;
+
+    if (mag_cmp(a->limbs, n, b->limbs, m) < 0) {
+        if (q) { *q = bignum_make(0, calloc(1, sizeof(uint32_t)), 0); }
+        if (r) { *r = bignum_copy(a); }
+        return;
+    }
+
+    uint32_t* qs = calloc(n, sizeof(uint32_t));
+    uint32_t* rs = calloc(m, sizeof(uint32_t));
+
+    if (m == 1) {
+        memcpy(qs, a->limbs, n * sizeof(uint32_t));
+        rs[0] = mag_divmod_small(qs, n, b->limbs[0]);
+    } else {
+        mag_divmod(qs, rs, a->limbs, n, b->limbs, m);
+    }
+
+    if (q) { *q = bignum_make(a->sign * b->sign, qs, n); } else { free(qs); }
+    if (r) { *r = bignum_make(a->sign, rs, m); } else { free(rs); }
+}
+
+bignum* bignum_div(bignum* a, bignum* b) {
+    bignum* q;
+    bignum_divmod(a, b, &q, NULL);
+    return q;
+}
+
+bignum* bignum_mod(bignum* a, bignum* b) {
+    bignum* r;
+    bignum_divmod(a, b, NULL, &r);
+    return r;
+}
+
+/* Raises a to the power n by repeated squaring */
+bignum* bignum_pow(bignum* a, unsigned long n) {
+    bignum* result = bignum_from_long(1);
+    bignum* base = bignum_copy(a);
+    while (n) {
+        if (n & 1) {
+            bignum* t = bignum_mul(result, base);
+            bignum_del(result);
+            result = t;
+        }
+        n >>= 1;
+        if (n) {
+            bignum* t = bignum_mul(base, base);
+            bignum_del(base);
+            base = t;
+        }
+    }
+    bignum_del(base);
+    return result;
+}
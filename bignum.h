@@ -0,0 +1,38 @@
+#ifndef bignum_h
+#define bignum_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Arbitrary precision integer.
+ * Stored as a sign and a magnitude of base 2^32 limbs, least significant
+ * limb first. The magnitude never has leading zero limbs and zero is
+ * represented with a sign of 0 and no limbs. */
+typedef struct bignum {
+    int sign;
+    int count;
+    uint32_t* limbs;
+} bignum;
+
+bignum* bignum_from_long(long x);
+bignum* bignum_from_i128(__int128 x);
+bignum* bignum_from_str(const char* s);
+bignum* bignum_copy(bignum* a);
+void bignum_del(bignum* a);
+
+bool bignum_fits_long(bignum* a);
+long bignum_to_long(bignum* a);
+double bignum_to_double(bignum* a);
+long bignum_bits(bignum* a);
+char* bignum_to_str(bignum* a);
+
+int bignum_cmp(bignum* a, bignum* b);
+bignum* bignum_neg(bignum* a);
+bignum* bignum_add(bignum* a, bignum* b);
+bignum* bignum_sub(bignum* a, bignum* b);
+bignum* bignum_mul(bignum* a, bignum* b);
+bignum* bignum_div(bignum* a, bignum* b);
+bignum* bignum_mod(bignum* a, bignum* b);
+bignum* bignum_pow(bignum* a, unsigned long n);
+
+#endif
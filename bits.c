@@ -0,0 +1,188 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "bits.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BITS_X86
+#include <immintrin.h>
+#endif
+
+/***************************************************
+ *  Bitset storage
+ ***************************************************/
+
+/* Words start out zero. Returns NULL if they cannot be allocated */
+lbits* lbits_new(long nwords) {
+    lbits* b = malloc(sizeof(lbits));
+    if (!b) { return NULL; }
+    b->words = calloc(nwords ? nwords : 1, sizeof(uint64_t));
+    if (!b->words) {
+        free(b);
+        return NULL;
+    }
+    b->refs = 1;
+    b->nwords = nwords;
+    return b;
+}
+
+lbits* lbits_retain(lbits* b) {
+    b->refs++;
+    return b;
+}
+
+void lbits_release(lbits* b) {
+    if (--b->refs > 0) { return; }
+    free(b->words);
+    free(b);
+}
+
+/* Grows to at least nwords words, at least doubling. Returns false,
+ * leaving the bitset unchanged, if the words cannot be allocated */
+bool lbits_reserve(lbits* b, long nwords) {
+    if (nwords <= b->nwords) { return true; }
+    long n = b->nwords * 2 > nwords ? b->nwords * 2 : nwords;
+    uint64_t* words = realloc(b->words, sizeof(uint64_t) * n);
+    if (!words) { return false; }
+    memset(words + b->nwords, 0, sizeof(uint64_t) * (n - b->nwords));
+    b->words = words;
+    b->nwords = n;
+    return true;
+}
+
+/* Number of words up to and including the last non-zero one */
+long lbits_used(lbits* b) {
+    long n = b->nwords;
+    while (n > 0 && b->words[n - 1] == 0) { n--; }
+    return n;
+}
+
+/***************************************************
+ *  Scalar kernels
+ ***************************************************/
+
+static void op_scalar(uint64_t* r, const uint64_t* a, const uint64_t* b,
+        long n, int op) {
+    switch (op) {
+        case BITS_AND: for (long i = 0; i < n; i++) { r[i] = a[i] & b[i]; } break;
+        case BITS_OR: for (long i = 0; i < n; i++) { r[i] = a[i] | b[i]; } break;
+        case BITS_XOR: for (long i = 0; i < n; i++) { r[i] = a[i] ^ b[i]; } break;
+        case BITS_ANDNOT: for (long i = 0; i < n; i++) { r[i] = a[i] & ~b[i]; } break;
+    }
+}
+
+static long count_scalar(const uint64_t* a, long n) {
+    long c = 0;
+    for (long i = 0; i < n; i++) { c += __builtin_popcountll(a[i]); }
+    return c;
+}
+
+#ifdef BITS_X86
+
+/***************************************************
+ *  POPCNT and AVX2 kernels
+ ***************************************************/
+
+/* Same loop, but the builtin becomes a single instruction */
+__attribute__((target("popcnt")))
+static long count_popcnt(const uint64_t* a, long n) {
+    long c = 0;
+    for (long i = 0; i < n; i++) { c += __builtin_popcountll(a[i]); }
+    return c;
+}
+
+__attribute__((target("avx2")))
+static void op_avx2(uint64_t* r, const uint64_t* a, const uint64_t* b,
+        long n, int op) {
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*) (b + i));
+        __m256i z;
+        switch (op) {
+            case BITS_AND: z = _mm256_and_si256(x, y); break;
+            case BITS_OR: z = _mm256_or_si256(x, y); break;
+            case BITS_XOR: z = _mm256_xor_si256(x, y); break;
+            default: z = _mm256_andnot_si256(y, x); break;
+        }
+        _mm256_storeu_si256((__m256i*) (r + i), z);
+    }
+    op_scalar(r + i, a + i, b + i, n - i, op);
+}
+
+/* Counts bits a nibble at a time with a shuffle as the lookup table,
+ * then sums the byte counts of each 64 bit lane */
+__attribute__((target("avx2,popcnt")))
+static long count_avx2(const uint64_t* a, long n) {
+    const __m256i table = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i total = _mm256_setzero_si256();
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (a + i));
+        __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, nibble));
+        __m256i hi = _mm256_shuffle_epi8(table,
+            _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+        total = _mm256_add_epi64(total,
+            _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+    }
+    uint64_t t[4];
+    _mm256_storeu_si256((__m256i*) t, total);
+    return (long) (t[0] + t[1] + t[2] + t[3]) + count_popcnt(a + i, n - i);
+}
+
+#endif
+
+/***************************************************
+ *  Dispatch
+ ***************************************************/
+
+static struct {
+    void (*op)(uint64_t*, const uint64_t*, const uint64_t*, long, int);
+    long (*count)(const uint64_t*, long);
+} kernels = { op_scalar, count_scalar };
+
+void bits_init(void) {
+#ifdef BITS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("popcnt")) {
+        kernels.count = count_popcnt;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        kernels.op = op_avx2;
+        kernels.count = count_avx2;
+    }
+#endif
+}
+
+/* Returns a new bitset, or NULL if it cannot be allocated. Words missing from the shorter operand count
+ * as zero, so only AND is cut to the shorter length. */
+lbits* bits_op(lbits* a, lbits* b, int op) {
+    long na = lbits_used(a), nb = lbits_used(b);
+    long common = na < nb ? na : nb;
+    long n;
+    switch (op) {
+        case BITS_AND: n = common; break;
+        case BITS_ANDNOT: n = na; break;
+        default: n = na > nb ? na : nb; break;
+    }
+
+    lbits* r = lbits_new(n);
+    if (!r) { return NULL; }
+    kernels.op(r->words, a->words, b->words, common, op);
+    if (op != BITS_AND) {
+        /* The tail comes from whichever operand is longer */
+        lbits* longer = na > nb ? a : b;
+        if (op != BITS_ANDNOT || longer == a) {
+            memcpy(r->words + common, longer->words + common,
+                sizeof(uint64_t) * (n - common));
+        }
+    }
+    return r;
+}
+
+long bits_count(const uint64_t* a, long n) {
+    return kernels.count(a, n);
+}
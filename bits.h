@@ -0,0 +1,30 @@
+#ifndef bits_h
+#define bits_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Set of non-negative integers, one bit per possible member. Changed in
+ * place by bits-set! and bits-clear!, and shared between copies. */
+typedef struct lbits {
+    int refs;
+    long nwords;
+    uint64_t* words;
+} lbits;
+
+/* Operations combining two bitsets word by word */
+enum { BITS_AND, BITS_OR, BITS_XOR, BITS_ANDNOT };
+
+lbits* lbits_new(long nwords);
+lbits* lbits_retain(lbits* b);
+void lbits_release(lbits* b);
+bool lbits_reserve(lbits* b, long nwords);
+long lbits_used(lbits* b);
+
+/* Picks the fastest kernels the CPU supports */
+void bits_init(void);
+
+lbits* bits_op(lbits* a, lbits* b, int op);
+long bits_count(const uint64_t* a, long n);
+
+#endif
@@ -1,4 +1,5 @@
 #include "builtins.h"
+#include <limits.h>
 
 lval* lval_eval(lenv* e, lval* v);
 
@@ -89,6 +90,11 @@ lval* builtin_eval(lenv* e, lval* a) {
 lval* lval_call(lenv* e, lval* f, lval* a) {
     /* If Builtin, then call that function */
     if (f->builtin) { 
+        /* Record and memo functions are passed themselves first, for
+         * their shape or cache */
+        if (f->data.field.shape || f->data.field.memo) {
+            a = lval_join(lval_add(lval_sexpr(), lval_copy(f)), a);
+        }
         return f->builtin(e, a); 
     }
 
@@ -182,6 +188,7 @@ lval* join_string(lval* x, lval* y) {
     x->data.str = (char *) realloc(x->data.str, 
             strlen(x->data.str) + strlen(y->data.str) + 1);
     strcat(x->data.str, y->data.str);
+    x->hash = 0;
     lval_del(y);
     return x;
 }
@@ -223,8 +230,38 @@ lval* builtin_join(lenv* e, lval* a) {
     return x;
 }
 
-/* Returns the number of elements in a Q-Expr */
+/* Returns the number of elements in a Q-Expr, vector, array, map or queue */
 lval* builtin_len(lenv* e, lval* a) {
+    if (a->cell[0]->type == LVAL_VEC) {
+        lval* x = lval_int(a->cell[0]->data.vec->count);
+        lval_del(a);
+        return x;
+    }
+    if (a->cell[0]->type == LVAL_DICT) {
+        lval* x = lval_int(a->cell[0]->data.dict->count);
+        lval_del(a);
+        return x;
+    }
+    if (a->cell[0]->type == LVAL_OMAP) {
+        lval* x = lval_int(a->cell[0]->data.omap->count);
+        lval_del(a);
+        return x;
+    }
+    if (a->cell[0]->type == LVAL_HEAP) {
+        lval* x = lval_int(a->cell[0]->data.heap->count);
+        lval_del(a);
+        return x;
+    }
+    if (a->cell[0]->type == LVAL_DEQUE) {
+        lval* x = lval_int(a->cell[0]->data.deque->count);
+        lval_del(a);
+        return x;
+    }
+    if (a->cell[0]->type == LVAL_ARRAY) {
+        lval* x = lval_int(a->cell[0]->data.array->count);
+        lval_del(a);
+        return x;
+    }
     LASSERT_TYPE("len", a, 0, LVAL_QEXPR);
     lval* x = lval_int(a->cell[0]->count);
     lval_del(a);
@@ -264,7 +301,7 @@ lval* builtin_env(lenv* e, lval* a) {
     for (int i = 0; i < e->count; i++) {
         y = lval_qexpr();
         lval_add(y, lval_sym(e->syms[i]));
-        lval_add(y, lval_copy(e->vals[i]));
+        lval_add(y, lval_unpack(e->vals[i]));
         lval_add(x, y);
     }
     return x;
@@ -301,7 +338,7 @@ lval* int_to_dec(lval* a) {
     /* check that all members of expression are integer or decimal */
     bool i = false, d = false;
     for (int j = 0; j < a->count; j++) {
-        if (a->cell[j]->type == LVAL_INT) {
+        if (a->cell[j]->type == LVAL_INT || a->cell[j]->type == LVAL_BIG) {
             i = true;
         }
         else if (a->cell[j]->type == LVAL_DEC) {
@@ -329,6 +366,10 @@ lval* int_to_dec(lval* a) {
             lval* y = lval_dec((double) x->data.integer);
             lval_del(x);
             lval_add(b, y);
+        } else if (x->type == LVAL_BIG) {
+            lval* y = lval_dec(bignum_to_double(x->data.big));
+            lval_del(x);
+            lval_add(b, y);
         } else {
             char* type = ltype_name(x->type);
             lval_del(x); lval_del(a); lval_del(b);
@@ -339,54 +380,115 @@ lval* int_to_dec(lval* a) {
     return b;
 }
 
-/* Evaluates basic math operations on integers */
+/* Operators understood by builtin_op_i, decoded once per call */
+enum { OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD, OP_MIN, OP_MAX };
+
+int op_code(char* op) {
+    if (strcmp(op, "+") == 0) { return OP_ADD; }
+    if (strcmp(op, "-") == 0) { return OP_SUB; }
+    if (strcmp(op, "*") == 0) { return OP_MUL; }
+    if (strcmp(op, "/") == 0) { return OP_DIV; }
+    if (strcmp(op, "%") == 0) { return OP_MOD; }
+    if (strcmp(op, "min") == 0) { return OP_MIN; }
+    return OP_MAX;
+}
+
+/* Returns the integer or bignum in v as a newly allocated bignum */
+bignum* lval_to_bignum(lval* v) {
+    if (v->type == LVAL_BIG) { return bignum_copy(v->data.big); }
+    return bignum_from_long(v->data.integer);
+}
+
+/* Applies op to two integers of which at least one needs bignum
+ * arithmetic. Deletes both arguments. Divisor must be non zero. */
+lval* builtin_op_big(lval* x, lval* y, int op) {
+    bignum* a = lval_to_bignum(x);
+    bignum* b = lval_to_bignum(y);
+    bignum* r;
+    switch (op) {
+        case OP_ADD: r = bignum_add(a, b); break;
+        case OP_SUB: r = bignum_sub(a, b); break;
+        case OP_MUL: r = bignum_mul(a, b); break;
+        case OP_DIV: r = bignum_div(a, b); break;
+        case OP_MOD: r = bignum_mod(a, b); break;
+        case OP_MIN: r = bignum_copy(bignum_cmp(b, a) < 0 ? b : a); break;
+        default:     r = bignum_copy(bignum_cmp(b, a) > 0 ? b : a); break;
+    }
+    bignum_del(a); bignum_del(b);
+    lval_del(x); lval_del(y);
+    return lval_big(r);
+}
+
+/* Checks whether an integer or bignum lval is zero */
+bool lval_int_is_zero(lval* v) {
+    return v->type == LVAL_INT ? v->data.integer == 0 : v->data.big->sign == 0;
+}
+
+/* Evaluates basic math operations on integers.
+ * Works on longs while the result fits, checking each step for
+ * overflow, and promotes to a bignum when it does not. */
 lval* builtin_op_i(lenv* e, lval* a, char* op) {
     for (int i = 0; i < a->count; i++) {
-        LASSERT_TYPE("builtin_op_i", a, i, LVAL_INT);
+        LASSERT(a, a->cell[i]->type == LVAL_INT || a->cell[i]->type == LVAL_BIG,
+            "Function '%s' passed incorrect type for argument %i. Got %s, Expected %s.",
+            "builtin_op_i", i, ltype_name(a->cell[i]->type), ltype_name(LVAL_INT));
     }   
 
+    int o = op_code(op);
+
     /* pop the first value into a temporary variable   */
     lval* x = lval_pop(a, 0);
 
     /* Check for unary negation */
-    if ((strcmp(op, "-") == 0) && a->count == 0) {
-        x->data.integer = -x->data.integer;
+    if (o == OP_SUB && a->count == 0) {
+        if (x->type == LVAL_INT && x->data.integer != LONG_MIN) {
+            x->data.integer = -x->data.integer;
+        } else {
+            bignum* n = lval_to_bignum(x);
+            lval_del(x);
+            x = lval_big(bignum_neg(n));
+            bignum_del(n);
+        }
     }
     
     while (a->count > 0) {  
         lval* y = lval_pop(a, 0);
-        if (strcmp(op, "+") == 0) { x->data.integer += y->data.integer;}
-        else if (strcmp(op, "-") == 0) { x->data.integer -= y->data.integer;}
-        else if (strcmp(op, "*") == 0) { x->data.integer *= y->data.integer;}
-        else if (strcmp(op, "/") == 0) {
-            if (y->data.integer == 0) {
-                lval_del(x); lval_del(y);
-                x = lval_err("Division By Zero.");
-                break;
-            }
-            x->data.integer /= y->data.integer;
+
+        if ((o == OP_DIV || o == OP_MOD) && lval_int_is_zero(y)) {
+            lval_del(x); lval_del(y);
+            x = lval_err("Division By Zero.");
+            break;
         }
-        else if (strcmp(op, "%") == 0) {
-            if (y->data.integer == 0) {
-                lval_del(x); lval_del(y);
-                x = lval_err("Division By Zero.");
-                break;
+
+        /* Fast path: both operands fit in a long */
+        if (x->type == LVAL_INT && y->type == LVAL_INT) {
+            long l = x->data.integer, r = y->data.integer, res;
+            bool overflow = false;
+            switch (o) {
+                case OP_ADD: overflow = __builtin_add_overflow(l, r, &res); break;
+                case OP_SUB: overflow = __builtin_sub_overflow(l, r, &res); break;
+                case OP_MUL: overflow = __builtin_mul_overflow(l, r, &res); break;
+                case OP_DIV:
+                    overflow = l == LONG_MIN && r == -1;
+                    res = overflow ? 0 : l / r;
+                    break;
+                case OP_MOD: res = r == -1 ? 0 : l % r; break;
+                case OP_MIN: res = r < l ? r : l; break;
+                default:     res = r > l ? r : l; break;
+            }
+            if (!overflow) {
+                x->data.integer = res;
+                lval_del(y);
+                continue;
             }
-            x->data.integer %= y->data.integer;
-        }   
-        else if (strcmp(op, "min") == 0) {
-            if (y->data.integer < x->data.integer) { x->data.integer = y->data.integer;}
-        }
-        else if (strcmp(op, "max") == 0) {
-            if (y->data.integer > x->data.integer) { x->data.integer = y->data.integer;}
         }
-        lval_del(y);
+
+        x = builtin_op_big(x, y, o);
     }
     lval_del(a);
     return x;
 }
 
-
 /* Evaluates basic math operations on decimals */
 lval* builtin_op_d(lenv* e, lval* a, char* op) {
     for (int i = 0; i < a->count; i++) {
@@ -445,7 +547,7 @@ lval* builtin_op(lenv* e, lval* a, char* op) {
         return a;
     }
     
-    if (a->cell[0]->type == LVAL_INT) {
+    if (a->cell[0]->type == LVAL_INT || a->cell[0]->type == LVAL_BIG) {
         return builtin_op_i(e, a, op);
     }
     else {
@@ -499,6 +601,25 @@ lval* builtin_cond_d(lenv* e, lval* v1, lval* v2, char* op) {
     return x;
 }
 
+/* Compares integers where at least one is a bignum */
+lval* builtin_cond_b(lenv* e, lval* v1, lval* v2, char* op) {
+    bignum* a = lval_to_bignum(v1);
+    bignum* b = lval_to_bignum(v2);
+    int c = bignum_cmp(a, b);
+    bignum_del(a); bignum_del(b);
+
+    lval* x = lval_bool(false);
+    
+    if (strcmp(op, "<") == 0) { x->data.boolean = c < 0; }
+    else if (strcmp(op, ">") == 0) { x->data.boolean = c > 0; }
+    else if (strcmp(op, ">=") == 0) { x->data.boolean = c >= 0; }
+    else if (strcmp(op, "<=") == 0) { x->data.boolean = c <= 0; }
+    else if (strcmp(op, "!=") == 0) { x->data.boolean = c != 0; }
+
+    lval_del(v1); lval_del(v2);
+    return x;
+}
+
 lval* builtin_cond(lenv* e, lval* a, char* op) {
     
     /* check that there are two values */
@@ -512,6 +633,9 @@ lval* builtin_cond(lenv* e, lval* a, char* op) {
     lval* v1 = lval_pop(a, 0);
     lval* v2 = lval_take(a, 0);
     
+    if (v1->type == LVAL_BIG || v2->type == LVAL_BIG) {
+        return builtin_cond_b(e, v1, v2, op);
+    }
     if (v1->type == LVAL_INT) {
         return builtin_cond_i(e, v1, v2, op);
     }
@@ -520,6 +644,42 @@ lval* builtin_cond(lenv* e, lval* a, char* op) {
     }
 }
 
+/* Orders two numbers by the same rules as builtin_cond, so mixed
+ * integers and decimals compare as decimals. Two strings are ordered
+ * by strcmp. Returns -1, 0 or 1. */
+int lval_cmp(lval* x, lval* y) {
+    if (x->type == LVAL_STR) {
+        int c = strcmp(x->data.str, y->data.str);
+        return (c > 0) - (c < 0);
+    }
+    if (x->type == LVAL_INT && y->type == LVAL_INT) {
+        return (x->data.integer > y->data.integer) -
+            (x->data.integer < y->data.integer);
+    }
+    if (x->type == LVAL_DEC || y->type == LVAL_DEC) {
+        double a = x->type == LVAL_DEC ? x->data.decimal :
+            x->type == LVAL_INT ? (double) x->data.integer : bignum_to_double(x->data.big);
+        double b = y->type == LVAL_DEC ? y->data.decimal :
+            y->type == LVAL_INT ? (double) y->data.integer : bignum_to_double(y->data.big);
+        return (a > b) - (a < b);
+    }
+    bignum* a = lval_to_bignum(x);
+    bignum* b = lval_to_bignum(y);
+    int c = bignum_cmp(a, b);
+    bignum_del(a); bignum_del(b);
+    return (c > 0) - (c < 0);
+}
+
+/* Checks that lval_cmp can order x, and order it against y if given.
+ * That needs numbers other than NaN, or strings, but not a mix. */
+bool lval_orderable(lval* x, lval* y) {
+    bool str = x->type == LVAL_STR;
+    bool num = x->type == LVAL_INT || x->type == LVAL_BIG ||
+        (x->type == LVAL_DEC && !isnan(x->data.decimal));
+    if (!str && !num) { return false; }
+    return !y || (y->type == LVAL_STR) == str;
+}
+
 lval* builtin_add(lenv* e, lval* a) {
     return builtin_op(e, a, "+");
 }
@@ -548,14 +708,73 @@ lval* builtin_max(lenv* e, lval* a) {
     return builtin_op(e, a, "max");
 }
 
+/* Largest power in bits that pow computes exactly. Bigger results are
+ * left to the decimal path rather than taking minutes to build. */
+#define POW_MAX_BITS (1L << 20)
+
+/* Upper bound on the bits in b^n for an integer b, saturating */
+static long pow_bits(lval* b, long n) {
+    long bits;
+    if (b->type == LVAL_BIG) {
+        bits = bignum_bits(b->data.big);
+    } else {
+        unsigned long u = b->data.integer < 0 ?
+            -(unsigned long) b->data.integer : (unsigned long) b->data.integer;
+        bits = u ? (long) (sizeof(long) * CHAR_BIT) - __builtin_clzl(u) : 0;
+    }
+    /* 0, 1 and -1 stay that size whatever the power */
+    if (bits <= 1) { return bits; }
+    return n > LONG_MAX / bits ? LONG_MAX : bits * n;
+}
+
+/* Raises an integer to a non negative integer power exactly. Squares
+ * and multiplies on longs, redoing the whole computation with bignums
+ * if any step overflows. Deletes b. */
+lval* builtin_pow_i(lval* b, long n) {
+    if (b->type == LVAL_INT) {
+        long result = 1, base = b->data.integer;
+        bool overflow = false;
+        for (long k = n; k && !overflow; ) {
+            if (k & 1) { overflow = __builtin_mul_overflow(result, base, &result); }
+            k >>= 1;
+            if (k && !overflow) { overflow = __builtin_mul_overflow(base, base, &base); }
+        }
+        if (!overflow) {
+            lval_del(b);
+            return lval_int(result);
+        }
+    }
+
+    bignum* base = lval_to_bignum(b);
+    lval* ans = lval_big(bignum_pow(base, n));
+    bignum_del(base);
+    lval_del(b);
+    return ans;
+}
+
 lval* builtin_pow(lenv* e, lval* a) {
     // Check if each argument is either int or dec
     LASSERT_NUM("pow", a, 2);
+
+    /* Integer to a non negative integer power stays exact */
+    if ((a->cell[0]->type == LVAL_INT || a->cell[0]->type == LVAL_BIG) &&
+            a->cell[1]->type == LVAL_INT && a->cell[1]->data.integer >= 0 &&
+            pow_bits(a->cell[0], a->cell[1]->data.integer) <= POW_MAX_BITS) {
+        lval* b = lval_pop(a, 0);
+        long n = a->cell[0]->data.integer;
+        lval_del(a);
+        return builtin_pow_i(b, n);
+    }
+
     lval* b, *exp, *temp;
     if (a->cell[0]->type == LVAL_INT) {
         temp = lval_pop(a, 0);
         b = lval_dec((double) temp->data.integer);
         lval_del(temp);
+    } else if (a->cell[0]->type == LVAL_BIG) {
+        temp = lval_pop(a, 0);
+        b = lval_dec(bignum_to_double(temp->data.big));
+        lval_del(temp);
     } else if (a->cell[0]->type == LVAL_DEC) {
         b = lval_pop(a, 0);
     } else {
@@ -582,159 +801,1926 @@ lval* builtin_pow(lenv* e, lval* a) {
     return ans;
 }
 
-lval* builtin_lessthan(lenv* e, lval* a) {
-    return builtin_cond(e, a, "<");
-}
-
-lval* builtin_greaterthan(lenv* e, lval* a) {
-    return builtin_cond(e, a, ">");
+/* Returns a 128 bit integer as an integer or bignum lval */
+lval* lval_from_i128(__int128 x) {
+    if (x >= LONG_MIN && x <= LONG_MAX) {
+        return lval_int((long) x);
+    }
+    return lval_big(bignum_from_i128(x));
 }
 
-bool lval_eq(lval* x, lval* y) {
+/* Creates a vector from numeric arguments or from a single Q-Expr */
+lval* builtin_vec(lenv* e, lval* a) {
+    lval* src = a;
+    if (a->count == 1 && a->cell[0]->type == LVAL_QEXPR) {
+        src = a->cell[0];
+    }
 
-    /* If two lvals are not the same type, return false. */
-    if (x->type != y->type) {
-        return false;
+    /* Any decimal makes a decimal vector */
+    int kind = LVEC_INT;
+    for (int i = 0; i < src->count; i++) {
+        int t = src->cell[i]->type;
+        LASSERT(a, t == LVAL_INT || t == LVAL_DEC,
+            "Function 'vec' passed incorrect type for element %i. "
+            "Got %s, Expected %s or %s.", i, ltype_name(t),
+            ltype_name(LVAL_INT), ltype_name(LVAL_DEC));
+        if (t == LVAL_DEC) { kind = LVEC_DEC; }
     }
-    
-    switch (x->type) {
-        case LVAL_INT: return (x->data.integer == y->data.integer);
-        case LVAL_DEC: return (x->data.decimal == y->data.decimal);
-        case LVAL_BOOL: return (x->data.boolean == y->data.boolean);
-        case LVAL_ERR: return (strcmp(x->data.err, y->data.err) == 0);
-        case LVAL_SYM: return (strcmp(x->data.sym, y->data.sym) == 0);
-        case LVAL_STR: return (strcmp(x->data.str, y->data.str) == 0);
-        case LVAL_FUN: 
-                   if (x->builtin || y-> builtin) {
-                       return x->builtin == y->builtin;
-                   } 
-                   else {
-                       return lval_eq(x->formals, y->formals) &&
-                          lval_eq(x->body, y->body); 
-                   }
-        case LVAL_QEXPR:
-        case LVAL_SEXPR:
-            if (x->count != y->count) { return false; }
-            
-            for (int i = 0; i < x->count; i++) {
-                if (!lval_eq(x->cell[i], y->cell[i])) {
-                    return false;
-                }
-            }
-            return true;
-        default: return false;
+
+    lvec* v = lvec_new(kind, src->count);
+    for (int i = 0; i < src->count; i++) {
+        lval* x = src->cell[i];
+        if (kind == LVEC_INT) {
+            v->items.ints[i] = x->data.integer;
+        } else {
+            v->items.decs[i] = x->type == LVAL_INT ? 
+                (double) x->data.integer : x->data.decimal;
+        }
     }
+
+    lval_del(a);
+    return lval_vec(v);
 }
 
-lval* builtin_comp(lenv* e, lval* a, char* op) {
-    LASSERT_NUM("==", a, 2);
-    lval* x = lval_pop(a, 0);
-    lval* y = lval_pop(a, 0);
-    bool b = lval_eq(x, y);
-    lval_del(a); lval_del(x); lval_del(y);
-    if (strcmp(op, "==") == 0) { return lval_bool(b); }
-    if (strcmp(op, "!=") == 0) { return lval_bool(!b); }
-    else { return lval_err("Incorrect operator passed to builtin_comp."); }
+/* Converts a vector back into a Q-Expr */
+lval* builtin_vec_list(lenv* e, lval* a) {
+    LASSERT_NUM("vec->list", a, 1);
+    LASSERT_TYPE("vec->list", a, 0, LVAL_VEC);
+
+    lvec* v = a->cell[0]->data.vec;
+    lval* q = lval_qexpr();
+    q->cell = malloc(sizeof(lval*) * v->count);
+    q->count = v->count;
+    for (long i = 0; i < v->count; i++) {
+        q->cell[i] = v->kind == LVEC_INT ?
+            lval_int(v->items.ints[i]) : lval_dec(v->items.decs[i]);
+    }
+    lval_del(a);
+    return q;
 }
 
-lval* builtin_equal(lenv* e, lval* a) {
-    return builtin_comp(e, a, "==");
+/* Returns x as a vector of the given kind and length. Integer vectors
+ * are converted and numbers are broadcast. Result must be released. */
+lvec* vec_operand(lval* x, int kind, long n) {
+    if (x->type == LVAL_VEC && x->data.vec->kind == kind) {
+        return lvec_retain(x->data.vec);
+    }
+    lvec* v = lvec_new(kind, n);
+    for (long i = 0; i < n; i++) {
+        if (x->type == LVAL_VEC) {
+            v->items.decs[i] = (double) x->data.vec->items.ints[i];
+        } else if (kind == LVEC_INT) {
+            v->items.ints[i] = x->data.integer;
+        } else {
+            v->items.decs[i] = x->type == LVAL_INT ?
+                (double) x->data.integer : x->data.decimal;
+        }
+    }
+    return v;
 }
 
-lval* builtin_notequal(lenv* e, lval* a) {
-    return builtin_comp(e, a, "!=");
+/* Element-wise vector arithmetic. Either argument may be a number */
+lval* builtin_vec_op(lenv* e, lval* a, char* op) {
+    LASSERT_NUM(op, a, 2);
+
+    long n = -1;
+    int kind = LVEC_INT;
+    for (int i = 0; i < 2; i++) {
+        lval* x = a->cell[i];
+        LASSERT(a, x->type == LVAL_VEC || x->type == LVAL_INT || x->type == LVAL_DEC,
+            "Function '%s' passed incorrect type for argument %i. "
+            "Got %s, Expected %s.", op, i, ltype_name(x->type), ltype_name(LVAL_VEC));
+        if (x->type == LVAL_VEC) {
+            LASSERT(a, n == -1 || n == x->data.vec->count,
+                "Function '%s' passed vectors of different lengths. "
+                "Got %li and %li.", op, n, x->data.vec->count);
+            n = x->data.vec->count;
+        }
+        if (x->type == LVAL_DEC || (x->type == LVAL_VEC && x->data.vec->kind == LVEC_DEC)) {
+            kind = LVEC_DEC;
+        }
+    }
+    LASSERT(a, n != -1, "Function '%s' passed no vector.", op);
+
+    lvec* x = vec_operand(a->cell[0], kind, n);
+    lvec* y = vec_operand(a->cell[1], kind, n);
+    lvec* r = lvec_new(kind, n);
+    bool ok = true;
+
+    if (kind == LVEC_INT) {
+        ok = strcmp(op, "vec+") == 0 ?
+            vec_add_i(r->items.ints, x->items.ints, y->items.ints, n) :
+            vec_mul_i(r->items.ints, x->items.ints, y->items.ints, n);
+    } else if (strcmp(op, "vec+") == 0) {
+        vec_add_d(r->items.decs, x->items.decs, y->items.decs, n);
+    } else {
+        vec_mul_d(r->items.decs, x->items.decs, y->items.decs, n);
+    }
+
+    lvec_release(x); lvec_release(y);
+    lval_del(a);
+    if (!ok) {
+        lvec_release(r);
+        return lval_err("Integer overflow in '%s'.", op);
+    }
+    return lval_vec(r);
 }
 
-lval* builtin_lessorequal(lenv* e, lval* a) {
-    return builtin_cond(e, a, "<=");
+lval* builtin_vec_add(lenv* e, lval* a) {
+    return builtin_vec_op(e, a, "vec+");
 }
 
-lval* builtin_greaterorequal(lenv* e, lval* a) {
-    return builtin_cond(e, a, ">=");
+lval* builtin_vec_mul(lenv* e, lval* a) {
+    return builtin_vec_op(e, a, "vec*");
 }
 
-lval* builtin_if(lenv* e, lval* a) {
-    LASSERT_NUM("if", a, 3);
-    LASSERT_TYPE("if", a, 0, LVAL_BOOL);
-    LASSERT_TYPE("if", a, 1, LVAL_QEXPR);
-    LASSERT_TYPE("if", a, 2, LVAL_QEXPR);
+/* Reduces a vector to a single number */
+lval* builtin_vec_reduce(lenv* e, lval* a, char* op) {
+    LASSERT_NUM(op, a, 1);
+    LASSERT_TYPE(op, a, 0, LVAL_VEC);
 
-    lval* b = lval_pop(a, 0);
+    lvec* v = a->cell[0]->data.vec;
+    lval* x;
 
-    if (b->data.boolean) {
-        /* Take first expression and evaluate it */
-        lval* s = lval_take(a, 0);
-        s->type = LVAL_SEXPR;
-        return lval_eval(e, s);
-    }
-    else {
-        /* Take the second expression and evaluate it */
-        lval* s = lval_take(a, 1);
-        s->type = LVAL_SEXPR;
-        return lval_eval(e, s);
+    if (strcmp(op, "vsum") == 0) {
+        x = v->kind == LVEC_INT ?
+            lval_from_i128(vec_sum_i(v->items.ints, v->count)) :
+            lval_dec(vec_sum_d(v->items.decs, v->count));
+    } else {
+        LASSERT(a, v->count != 0, "Function '%s' passed an empty vector.", op);
+        bool min = strcmp(op, "vmin") == 0;
+        if (v->kind == LVEC_INT) {
+            x = lval_int(min ? vec_min_i(v->items.ints, v->count) :
+                               vec_max_i(v->items.ints, v->count));
+        } else {
+            x = lval_dec(min ? vec_min_d(v->items.decs, v->count) :
+                               vec_max_d(v->items.decs, v->count));
+        }
     }
-}
-
-lval* builtin_xor(lenv* e, lval* a, char* op) {
-    LASSERT_NUM("or", a, 2);
-    LASSERT_TYPE("or", a, 0, LVAL_BOOL);
-    LASSERT_TYPE("or", a, 1, LVAL_BOOL);
 
-    lval* x = lval_pop(a, 0);
-    lval* y = lval_take(a, 0);
-    lval* b;
+    lval_del(a);
+    return x;
+}
 
-    if (strcmp(op, "||") == 0) {
-        b = lval_bool(x->data.boolean || y->data.boolean);
-    }
-    else if (strcmp(op, "&&") == 0) {
-        b = lval_bool(x->data.boolean && y->data.boolean);
-    }
-    lval_del(x); lval_del(y);
-    return b;
+lval* builtin_vsum(lenv* e, lval* a) {
+    return builtin_vec_reduce(e, a, "vsum");
 }
 
-lval* builtin_or(lenv* e, lval* a) {
-    return builtin_xor(e, a, "||");
+lval* builtin_vmin(lenv* e, lval* a) {
+    return builtin_vec_reduce(e, a, "vmin");
 }
 
-lval* builtin_and(lenv* e, lval* a) {
-    return builtin_xor(e, a, "&&");
+lval* builtin_vmax(lenv* e, lval* a) {
+    return builtin_vec_reduce(e, a, "vmax");
 }
 
-lval* builtin_not(lenv* e, lval* a) {
-    LASSERT_NUM("not", a, 1);
-    LASSERT_TYPE("not", a, 0, LVAL_BOOL);
+/* Dot product of two vectors of equal length */
+lval* builtin_dot(lenv* e, lval* a) {
+    LASSERT_NUM("dot", a, 2);
+    LASSERT_TYPE("dot", a, 0, LVAL_VEC);
+    LASSERT_TYPE("dot", a, 1, LVAL_VEC);
+
+    lvec* x = a->cell[0]->data.vec;
+    lvec* y = a->cell[1]->data.vec;
+    LASSERT(a, x->count == y->count,
+        "Function 'dot' passed vectors of different lengths. "
+        "Got %li and %li.", x->count, y->count);
+
+    lval* r;
+    if (x->kind == LVEC_INT && y->kind == LVEC_INT) {
+        __int128 s;
+        if (vec_dot_i(x->items.ints, y->items.ints, x->count, &s)) {
+            r = lval_from_i128(s);
+        } else {
+            /* Too large even for 128 bits, accumulate as bignums */
+            bignum* acc = bignum_from_long(0);
+            for (long i = 0; i < x->count; i++) {
+                bignum* p = bignum_from_i128((__int128) x->items.ints[i] * y->items.ints[i]);
+                bignum* t = bignum_add(acc, p);
+                bignum_del(acc); bignum_del(p);
+                acc = t;
+            }
+            r = lval_big(acc);
+        }
+    } else {
+        lvec* u = vec_operand(a->cell[0], LVEC_DEC, x->count);
+        lvec* v = vec_operand(a->cell[1], LVEC_DEC, y->count);
+        r = lval_dec(vec_dot_d(u->items.decs, v->items.decs, x->count));
+        lvec_release(u); lvec_release(v);
+    }
 
-    if (a->cell[0]->data.boolean) {
+    lval_del(a);
+    return r;
+}
+
+/* Creates a matrix from a Q-Expr of rows, or from a vector and dimensions */
+lval* builtin_mat(lenv* e, lval* a) {
+    LASSERT(a, a->count == 1 || a->count == 3,
+        "Function 'mat' passed incorrect number of arguments. "
+        "Got %i, Expected 1 or 3.", a->count);
+
+    if (a->count == 3) {
+        LASSERT_TYPE("mat", a, 0, LVAL_VEC);
+        LASSERT_TYPE("mat", a, 1, LVAL_INT);
+        LASSERT_TYPE("mat", a, 2, LVAL_INT);
+        lvec* v = a->cell[0]->data.vec;
+        long rows = a->cell[1]->data.integer, cols = a->cell[2]->data.integer;
+        long n;
+        LASSERT(a, rows >= 0 && cols >= 0 &&
+            !__builtin_mul_overflow(rows, cols, &n) && n == v->count,
+            "Function 'mat' cannot shape %li elements as %li x %li.",
+            v->count, rows, cols);
+        LASSERT(a, n <= MAT_MAX,
+            "Function 'mat' passed %li elements. Expected at most %li.", n, MAT_MAX);
+        lmat* m = lmat_new(rows, cols);
+        LASSERT(a, m, "Function 'mat' could not allocate %li elements.", n);
+        for (long i = 0; i < v->count; i++) {
+            m->items[i] = v->kind == LVEC_INT ?
+                (double) v->items.ints[i] : v->items.decs[i];
+        }
         lval_del(a);
-        return lval_bool(0);
+        return lval_mat(m);
     }
-    else {
-        lval_del(a);
-        return lval_bool(1);
+
+    LASSERT_TYPE("mat", a, 0, LVAL_QEXPR);
+    lval* q = a->cell[0];
+    long cols = q->count ? -1 : 0;
+
+    /* Every row must be a Q-Expr of numbers of the same length */
+    for (int i = 0; i < q->count; i++) {
+        lval* row = q->cell[i];
+        LASSERT(a, row->type == LVAL_QEXPR,
+            "Function 'mat' passed incorrect type for row %i. "
+            "Got %s, Expected %s.", i, ltype_name(row->type), ltype_name(LVAL_QEXPR));
+        LASSERT(a, cols == -1 || cols == row->count,
+            "Function 'mat' passed rows of different lengths. "
+            "Got %li and %i.", cols, row->count);
+        cols = row->count;
+        for (int j = 0; j < row->count; j++) {
+            int t = row->cell[j]->type;
+            LASSERT(a, t == LVAL_INT || t == LVAL_DEC,
+                "Function 'mat' passed incorrect type for element %i of row %i. "
+                "Got %s, Expected %s.", j, i, ltype_name(t), ltype_name(LVAL_DEC));
+        }
     }
-}
 
-bool is_builtin(lenv* e, lval* a) {
-    LASSERT(a, a->type == LVAL_SYM, "Function 'is_builtin' passed a non-function argument.");
-    /* Iterate to the first parent environment */
-    while (e->par) {
-        e = e->par;
+    LASSERT(a, (long) q->count * cols <= MAT_MAX,
+        "Function 'mat' passed %li elements. Expected at most %li.",
+        (long) q->count * cols, MAT_MAX);
+    lmat* m = lmat_new(q->count, cols);
+    LASSERT(a, m, "Function 'mat' could not allocate %li elements.", (long) q->count * cols);
+    for (int i = 0; i < q->count; i++) {
+        for (int j = 0; j < cols; j++) {
+            lval* x = q->cell[i]->cell[j];
+            m->items[i * cols + j] = x->type == LVAL_INT ?
+                (double) x->data.integer : x->data.decimal;
+        }
     }
-    /* Find the symbol in the environment and check if builtin == NULL */
-    for (int i = 0; i < e->count; i++) {
-        if (strcmp(a->data.sym, e->syms[i]) == 0) {
-            if (e->vals[i]->type == LVAL_FUN && e->vals[i]->builtin != NULL) {
-                return true; // Symbol found and builtin was not NULL
-            }
-            else { return false; } // Symbol found and builtin NULL
+    lval_del(a);
+    return lval_mat(m);
+}
+
+/* Converts a matrix to a Q-Expr of rows */
+lval* builtin_mat_list(lenv* e, lval* a) {
+    LASSERT_NUM("mat->list", a, 1);
+    LASSERT_TYPE("mat->list", a, 0, LVAL_MAT);
+
+    lmat* m = a->cell[0]->data.mat;
+    lval* q = lval_qexpr();
+    for (long i = 0; i < m->rows; i++) {
+        lval* row = lval_qexpr();
+        for (long j = 0; j < m->cols; j++) {
+            lval_add(row, lval_dec(m->items[i * m->cols + j]));
         }
+        lval_add(q, row);
     }
-    return false; // Symbol not found
+    lval_del(a);
+    return q;
 }
 
-lval* builtin_var(lenv* e, lval* a, char* func) {
+/* Returns the number of rows and columns of a matrix */
+lval* builtin_mat_dims(lenv* e, lval* a) {
+    LASSERT_NUM("mat-dims", a, 1);
+    LASSERT_TYPE("mat-dims", a, 0, LVAL_MAT);
+
+    lmat* m = a->cell[0]->data.mat;
+    lval* q = lval_qexpr();
+    lval_add(q, lval_int(m->rows));
+    lval_add(q, lval_int(m->cols));
+    lval_del(a);
+    return q;
+}
+
+/* Creates an n x n identity matrix */
+lval* builtin_mat_identity(lenv* e, lval* a) {
+    LASSERT_NUM("mat-identity", a, 1);
+    LASSERT_TYPE("mat-identity", a, 0, LVAL_INT);
+    long n = a->cell[0]->data.integer;
+    LASSERT(a, n >= 0, "Function 'mat-identity' passed negative size %li.", n);
+    LASSERT(a, n <= MAT_MAX / (n ? n : 1),
+        "Function 'mat-identity' passed size %li. A matrix has at most %li elements.",
+        n, MAT_MAX);
+
+    lmat* m = lmat_new(n, n);
+    LASSERT(a, m, "Function 'mat-identity' could not allocate a %li x %li matrix.", n, n);
+    for (long i = 0; i < n; i++) { m->items[i * n + i] = 1; }
+    lval_del(a);
+    return lval_mat(m);
+}
+
+/* Matrix product */
+lval* builtin_matmul(lenv* e, lval* a) {
+    LASSERT_NUM("matmul", a, 2);
+    LASSERT_TYPE("matmul", a, 0, LVAL_MAT);
+    LASSERT_TYPE("matmul", a, 1, LVAL_MAT);
+
+    lmat* x = a->cell[0]->data.mat;
+    lmat* y = a->cell[1]->data.mat;
+    LASSERT(a, x->cols == y->rows,
+        "Function 'matmul' cannot multiply %li x %li by %li x %li.",
+        x->rows, x->cols, y->rows, y->cols);
+
+    lmat* r = lmat_new(x->rows, y->cols);
+    LASSERT(a, r, "Function 'matmul' could not allocate a %li x %li matrix.",
+        x->rows, y->cols);
+    mat_mul(r->items, x->items, y->items, x->rows, x->cols, y->cols);
+    lval_del(a);
+    return lval_mat(r);
+}
+
+lval* builtin_transpose(lenv* e, lval* a) {
+    LASSERT_NUM("transpose", a, 1);
+    LASSERT_TYPE("transpose", a, 0, LVAL_MAT);
+
+    lmat* x = a->cell[0]->data.mat;
+    lmat* r = lmat_new(x->cols, x->rows);
+    LASSERT(a, r, "Function 'transpose' could not allocate a %li x %li matrix.",
+        x->cols, x->rows);
+    mat_transpose(r->items, x->items, x->rows, x->cols);
+    lval_del(a);
+    return lval_mat(r);
+}
+
+/* Element-wise matrix arithmetic. The second argument may be a number */
+lval* builtin_mat_op(lenv* e, lval* a, char* op) {
+    LASSERT_NUM(op, a, 2);
+    LASSERT_TYPE(op, a, 0, LVAL_MAT);
+    int t = a->cell[1]->type;
+    LASSERT(a, t == LVAL_MAT || t == LVAL_INT || t == LVAL_DEC,
+        "Function '%s' passed incorrect type for argument 1. "
+        "Got %s, Expected %s.", op, ltype_name(t), ltype_name(LVAL_MAT));
+
+    lmat* x = a->cell[0]->data.mat;
+    long n = x->rows * x->cols;
+    lmat* y;
+    if (t == LVAL_MAT) {
+        y = a->cell[1]->data.mat;
+        LASSERT(a, x->rows == y->rows && x->cols == y->cols,
+            "Function '%s' passed matrices of different sizes. "
+            "Got %li x %li and %li x %li.", op, x->rows, x->cols, y->rows, y->cols);
+        lmat_retain(y);
+    } else {
+        /* Broadcast the number */
+        double d = t == LVAL_INT ? (double) a->cell[1]->data.integer : a->cell[1]->data.decimal;
+        y = lmat_new(x->rows, x->cols);
+        LASSERT(a, y, "Function '%s' could not allocate a %li x %li matrix.",
+            op, x->rows, x->cols);
+        for (long i = 0; i < n; i++) { y->items[i] = d; }
+    }
+
+    lmat* r = lmat_new(x->rows, x->cols);
+    if (!r) {
+        lval* err = lval_err("Function '%s' could not allocate a %li x %li matrix.",
+            op, x->rows, x->cols);
+        lmat_release(y);
+        lval_del(a);
+        return err;
+    }
+    if (strcmp(op, "mat+") == 0) { vec_add_d(r->items, x->items, y->items, n); }
+    else if (strcmp(op, "mat-") == 0) { vec_sub_d(r->items, x->items, y->items, n); }
+    else { vec_mul_d(r->items, x->items, y->items, n); }
+
+    lmat_release(y);
+    lval_del(a);
+    return lval_mat(r);
+}
+
+lval* builtin_mat_add(lenv* e, lval* a) {
+    return builtin_mat_op(e, a, "mat+");
+}
+
+lval* builtin_mat_sub(lenv* e, lval* a) {
+    return builtin_mat_op(e, a, "mat-");
+}
+
+lval* builtin_mat_mul(lenv* e, lval* a) {
+    return builtin_mat_op(e, a, "mat*");
+}
+
+/* Solves A x = b for a square matrix A. b may be a matrix with
+ * one column per right hand side or a vector, x has the same shape. */
+lval* builtin_solve(lenv* e, lval* a) {
+    LASSERT_NUM("solve", a, 2);
+    LASSERT_TYPE("solve", a, 0, LVAL_MAT);
+    int t = a->cell[1]->type;
+    LASSERT(a, t == LVAL_MAT || t == LVAL_VEC,
+        "Function 'solve' passed incorrect type for argument 1. "
+        "Got %s, Expected %s or %s.", ltype_name(t),
+        ltype_name(LVAL_MAT), ltype_name(LVAL_VEC));
+
+    lmat* x = a->cell[0]->data.mat;
+    long n = x->rows;
+    long rhs = t == LVAL_MAT ? a->cell[1]->data.mat->rows : a->cell[1]->data.vec->count;
+    LASSERT(a, x->cols == n, "Function 'solve' passed a %li x %li matrix. "
+        "Expected a square matrix.", x->rows, x->cols);
+    LASSERT(a, rhs == n, "Function 'solve' passed %li right hand side rows. "
+        "Expected %li.", rhs, n);
+
+    /* Both sides are overwritten, so work on copies */
+    lmat* lu = lmat_new(n, n);
+    LASSERT(a, lu, "Function 'solve' could not allocate a %li x %li matrix.", n, n);
+    memcpy(lu->items, x->items, sizeof(double) * n * n);
+
+    lval* r;
+    double* b;
+    long m;
+    if (t == LVAL_MAT) {
+        lmat* y = a->cell[1]->data.mat;
+        lmat* s = lmat_new(y->rows, y->cols);
+        if (!s) {
+            lval* err = lval_err("Function 'solve' could not allocate a %li x %li matrix.",
+                y->rows, y->cols);
+            lmat_release(lu);
+            lval_del(a);
+            return err;
+        }
+        memcpy(s->items, y->items, sizeof(double) * y->rows * y->cols);
+        r = lval_mat(s);
+        b = s->items;
+        m = y->cols;
+    } else {
+        lvec* s = vec_operand(a->cell[1], LVEC_DEC, n);
+        if (s->refs > 1) {
+            lvec* c = lvec_new(LVEC_DEC, n);
+            memcpy(c->items.decs, s->items.decs, sizeof(double) * n);
+            lvec_release(s);
+            s = c;
+        }
+        r = lval_vec(s);
+        b = s->items.decs;
+        m = 1;
+    }
+
+    bool ok = mat_solve(lu->items, b, n, m);
+    lmat_release(lu);
+    lval_del(a);
+    if (!ok) {
+        lval_del(r);
+        return lval_err("Function 'solve' passed a singular matrix.");
+    }
+    return r;
+}
+
+/* Sets the number of threads used for reductions over large vectors */
+lval* builtin_set_threads(lenv* e, lval* a) {
+    LASSERT_NUM("set-threads", a, 1);
+    LASSERT_TYPE("set-threads", a, 0, LVAL_INT);
+    LASSERT(a, a->cell[0]->data.integer >= 1,
+        "Function 'set-threads' passed %li. Expected at least 1.",
+        a->cell[0]->data.integer);
+
+    pool_set_threads(a->cell[0]->data.integer);
+    lval_del(a);
+    return lval_sexpr();
+}
+
+/* Checks for a vector or a Q-Expr containing only numbers */
+bool lval_is_numbers(lval* v) {
+    if (v->type == LVAL_VEC) { return true; }
+    if (v->type != LVAL_QEXPR) { return false; }
+    for (int i = 0; i < v->count; i++) {
+        int t = v->cell[i]->type;
+        if (t != LVAL_INT && t != LVAL_BIG && t != LVAL_DEC) { return false; }
+    }
+    return true;
+}
+
+long lval_numbers_count(lval* v) {
+    return v->type == LVAL_VEC ? v->data.vec->count : v->count;
+}
+
+/* Element i of a vector or Q-Expr of numbers, as a decimal */
+double lval_numbers_at(lval* v, long i) {
+    if (v->type == LVAL_VEC) {
+        return v->data.vec->kind == LVEC_INT ?
+            (double) v->data.vec->items.ints[i] : v->data.vec->items.decs[i];
+    }
+    lval* x = v->cell[i];
+    switch (x->type) {
+        case LVAL_INT: return (double) x->data.integer;
+        case LVAL_BIG: return bignum_to_double(x->data.big);
+        default: return x->data.decimal;
+    }
+}
+
+/* Copies a vector or Q-Expr of numbers into a new array of decimals */
+double* lval_numbers_array(lval* v) {
+    long n = lval_numbers_count(v);
+    double* d = malloc(sizeof(double) * (n ? n : 1));
+    for (long i = 0; i < n; i++) { d[i] = lval_numbers_at(v, i); }
+    return d;
+}
+
+#define LASSERT_NUMBERS(func, args, index) \
+    LASSERT(args, lval_is_numbers(args->cell[index]), \
+        "Function '%s' passed incorrect type for argument %i. " \
+        "Got %s, Expected %s or %s of numbers.", func, index, \
+        ltype_name(args->cell[index]->type), ltype_name(LVAL_VEC), ltype_name(LVAL_QEXPR))
+
+/* Mean, variance and standard deviation in a single pass */
+lval* builtin_moments(lenv* e, lval* a, char* op) {
+    LASSERT_NUM(op, a, 1);
+    LASSERT_NUMBERS(op, a, 0);
+
+    welford w;
+    welford_init(&w);
+    long n = lval_numbers_count(a->cell[0]);
+    for (long i = 0; i < n; i++) {
+        welford_add(&w, lval_numbers_at(a->cell[0], i));
+    }
+
+    if (strcmp(op, "mean") == 0) {
+        LASSERT(a, n > 0, "Function 'mean' passed no values.");
+        lval_del(a);
+        return lval_dec(w.mean);
+    }
+
+    LASSERT(a, n > 1, "Function '%s' needs at least 2 values. Got %li.", op, n);
+    double var = welford_variance(&w);
+    lval_del(a);
+    return lval_dec(strcmp(op, "variance") == 0 ? var : sqrt(var));
+}
+
+lval* builtin_mean(lenv* e, lval* a) {
+    return builtin_moments(e, a, "mean");
+}
+
+lval* builtin_variance(lenv* e, lval* a) {
+    return builtin_moments(e, a, "variance");
+}
+
+lval* builtin_stddev(lenv* e, lval* a) {
+    return builtin_moments(e, a, "stddev");
+}
+
+/* Quantiles by selection. q may be a single number in [0, 1] or a
+ * Q-Expr of them, in which case a list of quantiles is returned */
+lval* builtin_quantile(lenv* e, lval* a) {
+    LASSERT_NUM("quantile", a, 2);
+    LASSERT_NUMBERS("quantile", a, 0);
+    LASSERT(a, (a->cell[1]->type == LVAL_QEXPR && lval_is_numbers(a->cell[1])) ||
+            a->cell[1]->type == LVAL_INT || a->cell[1]->type == LVAL_DEC,
+        "Function 'quantile' passed incorrect type for argument 1. "
+        "Got %s, Expected %s.", ltype_name(a->cell[1]->type), ltype_name(LVAL_DEC));
+
+    long n = lval_numbers_count(a->cell[0]);
+    LASSERT(a, n > 0, "Function 'quantile' passed no values.");
+
+    /* Treat a single q as a list of one */
+    bool single = a->cell[1]->type != LVAL_QEXPR;
+    lval* qs = single ? lval_add(lval_qexpr(), lval_copy(a->cell[1])) : lval_copy(a->cell[1]);
+    for (int i = 0; i < qs->count; i++) {
+        double q = lval_numbers_at(qs, i);
+        if (q < 0 || q > 1) {
+            lval_del(qs); lval_del(a);
+            return lval_err("Function 'quantile' passed %f. Expected a value from 0 to 1.", q);
+        }
+    }
+
+    double* d = lval_numbers_array(a->cell[0]);
+    lval* r = lval_qexpr();
+    for (int i = 0; i < qs->count; i++) {
+        lval_add(r, lval_dec(stats_quantile(d, n, lval_numbers_at(qs, i))));
+    }
+
+    free(d);
+    lval_del(qs);
+    lval_del(a);
+    return single ? lval_take(r, 0) : r;
+}
+
+/* Counts values into equal width bins. The range defaults to the
+ * smallest and largest values */
+/* The result is a list with one count per bin, so bins are capped */
+#define HISTOGRAM_BINS_MAX (1L << 20)
+
+lval* builtin_histogram(lenv* e, lval* a) {
+    LASSERT(a, a->count == 2 || a->count == 4,
+        "Function 'histogram' passed incorrect number of arguments. "
+        "Got %i, Expected 2 or 4.", a->count);
+    LASSERT_NUMBERS("histogram", a, 0);
+    LASSERT_TYPE("histogram", a, 1, LVAL_INT);
+    long bins = a->cell[1]->data.integer;
+    LASSERT(a, bins > 0, "Function 'histogram' passed %li bins.", bins);
+    LASSERT(a, bins <= HISTOGRAM_BINS_MAX,
+        "Function 'histogram' passed %li bins. Expected at most %li.",
+        bins, HISTOGRAM_BINS_MAX);
+
+    lval* xs = a->cell[0];
+    long n = lval_numbers_count(xs);
+
+    /* Decimal vectors are binned in place, anything else is converted */
+    bool borrowed = xs->type == LVAL_VEC && xs->data.vec->kind == LVEC_DEC;
+    double* d = borrowed ? xs->data.vec->items.decs : lval_numbers_array(xs);
+
+    double lo, hi;
+    if (a->count == 4) {
+        for (int i = 2; i < 4; i++) {
+            int t = a->cell[i]->type;
+            if (t != LVAL_INT && t != LVAL_DEC) {
+                if (!borrowed) { free(d); }
+                lval_del(a);
+                return lval_err("Function 'histogram' passed incorrect type for argument %i. "
+                    "Got %s, Expected %s.", i, ltype_name(t), ltype_name(LVAL_DEC));
+            }
+        }
+        lo = lval_numbers_at(a, 2);
+        hi = lval_numbers_at(a, 3);
+    } else {
+        lo = n ? vec_min_d(d, n) : 0;
+        hi = n ? vec_max_d(d, n) : 0;
+    }
+
+    long* counts = malloc(sizeof(long) * bins);
+    if (!counts) {
+        if (!borrowed) { free(d); }
+        lval_del(a);
+        return lval_err("Function 'histogram' could not allocate %li bins.", bins);
+    }
+    stats_histogram(d, n, lo, hi, bins, counts);
+
+    lval* r = lval_qexpr();
+    for (long b = 0; b < bins; b++) { lval_add(r, lval_int(counts[b])); }
+
+    free(counts);
+    if (!borrowed) { free(d); }
+    lval_del(a);
+    return r;
+}
+
+lval* builtin_lessthan(lenv* e, lval* a);
+lval* builtin_greaterthan(lenv* e, lval* a);
+
+/* State for sorting with lval_cmp or with a Lispy comparator */
+typedef struct lsort {
+    lenv* e;
+    lval* f;        /* Comparator, NULL to use lval_cmp */
+    lenv* env;      /* Reused environment of a two argument lambda */
+    int order;      /* 1 ascending or -1 descending for lval_cmp */
+    lval* err;      /* First error, no more calls are made after it */
+} lsort;
+
+bool sort_less_cmp(void* x, void* y, void* arg) {
+    lsort* s = arg;
+    return lval_cmp(x, y) * s->order < 0;
+}
+
+/* Calls the comparator on copies of two elements. A lambda taking
+ * exactly two arguments is evaluated directly in one environment that is
+ * reused for every comparison, rather than copying the whole function
+ * for each call as lval_call would need. */
+bool sort_less_call(void* x, void* y, void* arg) {
+    lsort* s = arg;
+    if (s->err) { return false; }
+
+    lval* r;
+    if (s->f->builtin) {
+        lval* args = lval_add(lval_sexpr(), lval_copy(x));
+        r = lval_call(s->e, s->f, lval_add(args, lval_copy(y)));
+    } else if (s->env) {
+        lenv_put(s->env, s->f->formals->cell[0], x);
+        lenv_put(s->env, s->f->formals->cell[1], y);
+        s->env->par = s->e;
+        r = builtin_eval(s->env, lval_add(lval_sexpr(), lval_copy(s->f->body)));
+    } else {
+        lval* f = lval_copy(s->f);
+        lval* args = lval_add(lval_sexpr(), lval_copy(x));
+        r = lval_call(s->e, f, lval_add(args, lval_copy(y)));
+        lval_del(f);
+    }
+
+    if (r->type == LVAL_BOOL) {
+        bool less = r->data.boolean;
+        lval_del(r);
+        return less;
+    }
+    if (r->type == LVAL_ERR) {
+        s->err = r;
+    } else {
+        s->err = lval_err("Function 'sort' comparator returned %s. Expected %s.",
+            ltype_name(r->type), ltype_name(LVAL_BOOL));
+        lval_del(r);
+    }
+    return false;
+}
+
+/* Sorts a Q-Expr of only integers or only decimals by radix sort on
+ * keys, moving the elements themselves */
+void sort_numbers(lval* q, int order) {
+    uint64_t* keys = malloc(sizeof(uint64_t) * (q->count ? q->count : 1));
+    for (int i = 0; i < q->count; i++) {
+        lval* x = q->cell[i];
+        keys[i] = x->type == LVAL_INT ?
+            sort_key_i(x->data.integer) : sort_key_d(x->data.decimal);
+        if (order < 0) { keys[i] = ~keys[i]; }
+    }
+    sort_radix(keys, (void**) q->cell, q->count);
+    q->hash = 0;
+    free(keys);
+}
+
+/* Sorts a copy of a vector's elements. Integers are decoded from their
+ * keys, decimals are carried along since -0.0 and 0.0 share a key. */
+lvec* sort_vec(lvec* v, int order) {
+    lvec* r = lvec_new(v->kind, v->count);
+    bool decs = v->kind == LVEC_DEC;
+    uint64_t* keys = malloc(sizeof(uint64_t) * (v->count ? v->count : 1));
+    double** items = decs ? malloc(sizeof(double*) * (v->count ? v->count : 1)) : NULL;
+    for (long i = 0; i < v->count; i++) {
+        keys[i] = decs ? sort_key_d(v->items.decs[i]) : sort_key_i(v->items.ints[i]);
+        if (order < 0) { keys[i] = ~keys[i]; }
+        if (decs) { items[i] = &v->items.decs[i]; }
+    }
+    sort_radix(keys, (void**) items, v->count);
+    for (long i = 0; i < v->count; i++) {
+        if (decs) { r->items.decs[i] = *items[i]; }
+        else { r->items.ints[i] = sort_unkey_i(order < 0 ? ~keys[i] : keys[i]); }
+    }
+    free(items);
+    free(keys);
+    return r;
+}
+
+/* Sorts a Q-Expr or vector, stably. Without a comparator numbers are
+ * ordered as by '<' and strings by their bytes. A comparator is a
+ * function of two values returning true if the first goes first. */
+lval* builtin_sort(lenv* e, lval* a) {
+    LASSERT(a, a->count == 1 || a->count == 2,
+        "Function 'sort' passed incorrect number of arguments. "
+        "Got %i, Expected 1 or 2.", a->count);
+    int t = a->cell[0]->type;
+    LASSERT(a, t == LVAL_QEXPR || t == LVAL_VEC,
+        "Function 'sort' passed incorrect type for argument 0. "
+        "Got %s, Expected %s or %s.", ltype_name(t),
+        ltype_name(LVAL_QEXPR), ltype_name(LVAL_VEC));
+    if (a->count == 2) { LASSERT_TYPE("sort", a, 1, LVAL_FUN); }
+
+    /* The builtins '<' and '>' are handled like no comparator */
+    lsort s = { e, NULL, NULL, 1, NULL };
+    if (a->count == 2) {
+        lbuiltin b = a->cell[1]->builtin;
+        if (b == builtin_lessthan) { s.order = 1; }
+        else if (b == builtin_greaterthan) { s.order = -1; }
+        else { s.f = a->cell[1]; }
+    }
+
+    if (t == LVAL_VEC) {
+        if (!s.f) {
+            lval* x = lval_vec(sort_vec(a->cell[0]->data.vec, s.order));
+            lval_del(a);
+            return x;
+        }
+        /* Box the elements to call the comparator on them */
+        lval* v = a->cell[0];
+        a->cell[0] = builtin_vec_list(e, lval_add(lval_sexpr(), v));
+    }
+
+    lval* q = a->cell[0];
+    bool ints = true, decs = true, nums = true, strs = true;
+    for (int i = 0; i < q->count; i++) {
+        int ti = q->cell[i]->type;
+        ints = ints && ti == LVAL_INT;
+        decs = decs && ti == LVAL_DEC;
+        nums = nums && (ti == LVAL_INT || ti == LVAL_BIG || ti == LVAL_DEC);
+        strs = strs && ti == LVAL_STR;
+    }
+
+    if (!s.f && (ints || decs)) {
+        sort_numbers(q, s.order);
+    } else if (!s.f) {
+        LASSERT(a, nums || strs,
+            "Function 'sort' cannot order these values without a comparator.");
+        LASSERT(a, nums || a->count == 1,
+            "Function 'sort' cannot order strings with '<' or '>'. "
+            "Leave out the comparator to order them by their bytes.");
+        sort_merge((void**) q->cell, q->count, sort_less_cmp, &s);
+        q->hash = 0;
+    } else {
+        if (!s.f->builtin && s.f->formals->count == 2 &&
+                strcmp(s.f->formals->cell[0]->data.sym, "&") != 0 &&
+                strcmp(s.f->formals->cell[1]->data.sym, "&") != 0) {
+            s.env = lenv_copy(s.f->env);
+        }
+        sort_merge((void**) q->cell, q->count, sort_less_call, &s);
+        q->hash = 0;
+        if (s.env) { lenv_del(s.env); }
+        if (s.err) {
+            lval_del(a);
+            return s.err;
+        }
+    }
+
+    if (t == LVAL_VEC) {
+        return builtin_vec(e, lval_add(lval_sexpr(), lval_take(a, 0)));
+    }
+    return lval_take(a, 0);
+}
+
+/* Values that change in place and are shared between copies */
+bool lval_is_mutable(lval* v) {
+    switch (v->type) {
+        case LVAL_DICT:
+        case LVAL_OMAP:
+        case LVAL_HEAP:
+        case LVAL_DEQUE:
+        case LVAL_ARRAY:
+        case LVAL_BITS:
+            return true;
+        default: return false;
+    }
+}
+
+/* Values that could change after being used as a key */
+bool lval_has_mutable(lval* v) {
+    if (lval_is_mutable(v)) { return true; }
+    if (v->type == LVAL_SEXPR || v->type == LVAL_QEXPR) {
+        for (int i = 0; i < v->count; i++) {
+            if (lval_has_mutable(v->cell[i])) { return true; }
+        }
+    }
+    if (v->type == LVAL_RECORD) {
+        for (int i = 0; i < v->data.record->shape->count; i++) {
+            if (lval_has_mutable(v->data.record->fields[i])) { return true; }
+        }
+    }
+    return false;
+}
+
+/* Mutable values cannot be keys or be inside keys, their hash would go stale */
+#define LASSERT_KEY(func, args, index) \
+    LASSERT(args, !lval_has_mutable(args->cell[index]), \
+        "Function '%s' passed a %s as a key. Keys cannot contain mutable values.", \
+        func, ltype_name(args->cell[index]->type))
+
+/* Arguments to a map constructor are alternating keys and values, or a
+ * single Q-Expr of {key value} pairs. Flattens the second form into the
+ * first. */
+lval* lval_flatten_pairs(lval* a, char* func) {
+    if (a->count == 1) {
+        LASSERT_TYPE(func, a, 0, LVAL_QEXPR);
+        lval* pairs = lval_pop(a, 0);
+        while (pairs->count) {
+            lval* p = lval_pop(pairs, 0);
+            if (p->type != LVAL_QEXPR || p->count != 2) {
+                lval_del(p); lval_del(pairs); lval_del(a);
+                return lval_err("Function '%s' expected {key value} pairs.", func);
+            }
+            lval_join(a, p);
+        }
+        lval_del(pairs);
+    }
+    LASSERT(a, a->count % 2 == 0,
+        "Function '%s' passed a key without a value.", func);
+    return a;
+}
+
+/* Builds a dictionary from alternating keys and values, or from a
+ * single Q-Expr of {key value} pairs */
+lval* builtin_dict(lenv* e, lval* a) {
+    a = lval_flatten_pairs(a, "dict");
+    if (a->type == LVAL_ERR) { return a; }
+    for (int i = 0; i < a->count; i += 2) {
+        LASSERT_KEY("dict", a, i);
+    }
+
+    ldict* d = ldict_new();
+    while (a->count) {
+        lval* k = lval_pop(a, 0);
+        ldict_put(d, k, lval_pop(a, 0));
+    }
+    lval_del(a);
+    return lval_dict(d);
+}
+
+/* Looks up a key, returning the optional default if it is missing */
+lval* builtin_dict_get(lenv* e, lval* a) {
+    LASSERT(a, a->count == 2 || a->count == 3,
+        "Function 'dict-get' passed incorrect number of arguments. "
+        "Got %i, Expected 2 or 3.", a->count);
+    LASSERT_TYPE("dict-get", a, 0, LVAL_DICT);
+
+    lval* v = ldict_get(a->cell[0]->data.dict, a->cell[1]);
+    if (v) {
+        v = lval_copy(v);
+        lval_del(a);
+        return v;
+    }
+    LASSERT(a, a->count == 3, "Function 'dict-get' passed a missing key.");
+    return lval_take(a, 2);
+}
+
+lval* builtin_dict_has(lenv* e, lval* a) {
+    LASSERT_NUM("dict-has", a, 2);
+    LASSERT_TYPE("dict-has", a, 0, LVAL_DICT);
+
+    bool found = ldict_get(a->cell[0]->data.dict, a->cell[1]) != NULL;
+    lval_del(a);
+    return lval_bool(found);
+}
+
+/* Adds or replaces one or more keys in place and returns the dictionary */
+lval* builtin_dict_put(lenv* e, lval* a) {
+    LASSERT(a, a->count >= 3 && a->count % 2 == 1,
+        "Function 'dict-put!' passed incorrect number of arguments. "
+        "Got %i, Expected a dictionary then keys and values.", a->count);
+    LASSERT_TYPE("dict-put!", a, 0, LVAL_DICT);
+    for (int i = 1; i < a->count; i += 2) {
+        LASSERT_KEY("dict-put!", a, i);
+    }
+
+    lval* x = lval_pop(a, 0);
+    while (a->count) {
+        lval* k = lval_pop(a, 0);
+        ldict_put(x->data.dict, k, lval_pop(a, 0));
+    }
+    lval_del(a);
+    return x;
+}
+
+/* Removes keys in place, ignoring missing ones, and returns the dictionary */
+lval* builtin_dict_remove(lenv* e, lval* a) {
+    LASSERT(a, a->count >= 2,
+        "Function 'dict-remove!' passed incorrect number of arguments. "
+        "Got %i, Expected at least 2.", a->count);
+    LASSERT_TYPE("dict-remove!", a, 0, LVAL_DICT);
+
+    lval* x = lval_pop(a, 0);
+    for (int i = 0; i < a->count; i++) {
+        ldict_remove(x->data.dict, a->cell[i]);
+    }
+    lval_del(a);
+    return x;
+}
+
+/* Keys or values as a Q-Expr, in the dictionary's internal order */
+lval* builtin_dict_list(lenv* e, lval* a, char* func) {
+    LASSERT_NUM(func, a, 1);
+    LASSERT_TYPE(func, a, 0, LVAL_DICT);
+
+    ldict* d = a->cell[0]->data.dict;
+    bool keys = strcmp(func, "dict-keys") == 0;
+    lval* x = lval_qexpr();
+    for (long i = 0; i < d->capacity; i++) {
+        if (d->entries[i].key) {
+            lval_add(x, lval_copy(keys ? d->entries[i].key : d->entries[i].val));
+        }
+    }
+    lval_del(a);
+    return x;
+}
+
+lval* builtin_dict_keys(lenv* e, lval* a) {
+    return builtin_dict_list(e, a, "dict-keys");
+}
+
+lval* builtin_dict_vals(lenv* e, lval* a) {
+    return builtin_dict_list(e, a, "dict-vals");
+}
+
+/* Returns a new dictionary with the entries of all arguments. Later
+ * arguments win when a key appears more than once. */
+lval* builtin_dict_merge(lenv* e, lval* a) {
+    LASSERT(a, a->count >= 1,
+        "Function 'dict-merge' passed no arguments.");
+    for (int i = 0; i < a->count; i++) {
+        LASSERT_TYPE("dict-merge", a, i, LVAL_DICT);
+    }
+
+    ldict* d = ldict_copy(a->cell[0]->data.dict);
+    for (int i = 1; i < a->count; i++) {
+        ldict* y = a->cell[i]->data.dict;
+        for (long j = 0; j < y->capacity; j++) {
+            if (y->entries[j].key) {
+                ldict_put(d, lval_copy(y->entries[j].key),
+                    lval_copy(y->entries[j].val));
+            }
+        }
+    }
+    lval_del(a);
+    return lval_dict(d);
+}
+
+/* Ordered map keys, like heap priorities, are numbers or strings of the
+ * same kind as the ones already there */
+bool omap_key_ok(lomap* m, lval* k) {
+    return lval_orderable(k, m->count ? m->root->keys[0] : NULL);
+}
+
+#define LASSERT_OMAP_KEY(func, args, m, index) \
+    LASSERT(args, omap_key_ok(m, args->cell[index]), \
+        "Function '%s' passed a %s as a key. Expected numbers or strings, " \
+        "matching the keys already in the map.", func, \
+        ltype_name(args->cell[index]->type))
+
+/* Builds an ordered map from alternating keys and values, or from a
+ * single Q-Expr of {key value} pairs */
+lval* builtin_omap(lenv* e, lval* a) {
+    a = lval_flatten_pairs(a, "omap");
+    if (a->type == LVAL_ERR) { return a; }
+
+    lval* x = lval_omap(lomap_new());
+    while (a->count) {
+        if (!omap_key_ok(x->data.omap, a->cell[0])) {
+            lval* err = lval_err("Function 'omap' passed a %s as a key. "
+                "Expected numbers or strings, matching the other keys.",
+                ltype_name(a->cell[0]->type));
+            lval_del(x); lval_del(a);
+            return err;
+        }
+        lval* k = lval_pop(a, 0);
+        lomap_put(x->data.omap, k, lval_pop(a, 0));
+    }
+    lval_del(a);
+    return x;
+}
+
+/* Looks up a key, returning the optional default if it is missing */
+lval* builtin_omap_get(lenv* e, lval* a) {
+    LASSERT(a, a->count == 2 || a->count == 3,
+        "Function 'omap-get' passed incorrect number of arguments. "
+        "Got %i, Expected 2 or 3.", a->count);
+    LASSERT_TYPE("omap-get", a, 0, LVAL_OMAP);
+    lomap* m = a->cell[0]->data.omap;
+    LASSERT_OMAP_KEY("omap-get", a, m, 1);
+
+    lval* v = lomap_get(m, a->cell[1]);
+    if (v) {
+        v = lval_copy(v);
+        lval_del(a);
+        return v;
+    }
+    LASSERT(a, a->count == 3, "Function 'omap-get' passed a missing key.");
+    return lval_take(a, 2);
+}
+
+/* Adds or replaces one or more keys in place and returns the map */
+lval* builtin_omap_put(lenv* e, lval* a) {
+    LASSERT(a, a->count >= 3 && a->count % 2 == 1,
+        "Function 'omap-put!' passed incorrect number of arguments. "
+        "Got %i, Expected a map then keys and values.", a->count);
+    LASSERT_TYPE("omap-put!", a, 0, LVAL_OMAP);
+
+    lval* x = lval_pop(a, 0);
+    while (a->count) {
+        if (!omap_key_ok(x->data.omap, a->cell[0])) {
+            lval* err = lval_err("Function 'omap-put!' passed a %s as a key. "
+                "Expected numbers or strings, matching the other keys.",
+                ltype_name(a->cell[0]->type));
+            lval_del(x); lval_del(a);
+            return err;
+        }
+        lval* k = lval_pop(a, 0);
+        lomap_put(x->data.omap, k, lval_pop(a, 0));
+    }
+    lval_del(a);
+    return x;
+}
+
+/* Removes keys in place, ignoring missing ones, and returns the map */
+lval* builtin_omap_remove(lenv* e, lval* a) {
+    LASSERT(a, a->count >= 2,
+        "Function 'omap-remove!' passed incorrect number of arguments. "
+        "Got %i, Expected at least 2.", a->count);
+    LASSERT_TYPE("omap-remove!", a, 0, LVAL_OMAP);
+    for (int i = 1; i < a->count; i++) {
+        LASSERT_OMAP_KEY("omap-remove!", a, a->cell[0]->data.omap, i);
+    }
+
+    lval* x = lval_pop(a, 0);
+    for (int i = 0; i < a->count; i++) {
+        lomap_remove(x->data.omap, a->cell[i]);
+    }
+    lval_del(a);
+    return x;
+}
+
+/* Visitors that copy entries into a Q-Expr */
+bool omap_collect_pair(lval* k, lval* v, void* arg) {
+    lval* p = lval_add(lval_qexpr(), lval_copy(k));
+    lval_add(arg, lval_add(p, lval_copy(v)));
+    return true;
+}
+
+bool omap_collect_key(lval* k, lval* v, void* arg) {
+    lval_add(arg, lval_copy(k));
+    return true;
+}
+
+bool omap_collect_val(lval* k, lval* v, void* arg) {
+    lval_add(arg, lval_copy(v));
+    return true;
+}
+
+/* Entries with lo <= key < hi as {key value} pairs, in order */
+lval* builtin_omap_range(lenv* e, lval* a) {
+    LASSERT_NUM("omap-range", a, 3);
+    LASSERT_TYPE("omap-range", a, 0, LVAL_OMAP);
+    lomap* m = a->cell[0]->data.omap;
+    LASSERT_OMAP_KEY("omap-range", a, m, 1);
+    LASSERT_OMAP_KEY("omap-range", a, m, 2);
+
+    lval* x = lval_qexpr();
+    lomap_range(m, a->cell[1], a->cell[2], omap_collect_pair, x);
+    lval_del(a);
+    return x;
+}
+
+/* The {key value} pair with the greatest key not above k for
+ * omap-floor, or the least key not below k for omap-ceiling.
+ * {} if there is none. */
+lval* builtin_omap_bound(lenv* e, lval* a, char* func) {
+    LASSERT_NUM(func, a, 2);
+    LASSERT_TYPE(func, a, 0, LVAL_OMAP);
+    lomap* m = a->cell[0]->data.omap;
+    LASSERT_OMAP_KEY(func, a, m, 1);
+
+    lval* k;
+    lval* v;
+    bool found = strcmp(func, "omap-floor") == 0 ?
+        lomap_floor(m, a->cell[1], &k, &v) : lomap_ceiling(m, a->cell[1], &k, &v);
+    lval* x = lval_qexpr();
+    if (found) { omap_collect_pair(k, v, x); x = lval_take(x, 0); }
+    lval_del(a);
+    return x;
+}
+
+lval* builtin_omap_floor(lenv* e, lval* a) {
+    return builtin_omap_bound(e, a, "omap-floor");
+}
+
+lval* builtin_omap_ceiling(lenv* e, lval* a) {
+    return builtin_omap_bound(e, a, "omap-ceiling");
+}
+
+/* All entries, keys or values in key order */
+lval* builtin_omap_list(lenv* e, lval* a, char* func) {
+    LASSERT_NUM(func, a, 1);
+    LASSERT_TYPE(func, a, 0, LVAL_OMAP);
+
+    lomap_visit fn = strcmp(func, "omap-keys") == 0 ? omap_collect_key :
+        strcmp(func, "omap-vals") == 0 ? omap_collect_val : omap_collect_pair;
+    lval* x = lval_qexpr();
+    lomap_range(a->cell[0]->data.omap, NULL, NULL, fn, x);
+    lval_del(a);
+    return x;
+}
+
+lval* builtin_omap_items(lenv* e, lval* a) {
+    return builtin_omap_list(e, a, "omap-items");
+}
+
+lval* builtin_omap_keys(lenv* e, lval* a) {
+    return builtin_omap_list(e, a, "omap-keys");
+}
+
+lval* builtin_omap_vals(lenv* e, lval* a) {
+    return builtin_omap_list(e, a, "omap-vals");
+}
+
+/* Builds a heap from alternating priorities and values, or from a
+ * single Q-Expr of {priority value} pairs */
+lval* builtin_heap(lenv* e, lval* a) {
+    a = lval_flatten_pairs(a, "heap");
+    if (a->type == LVAL_ERR) { return a; }
+
+    lval* x = lval_heap(lheap_new());
+    while (a->count) {
+        lheap* h = x->data.heap;
+        if (!lval_orderable(a->cell[0], h->count ? h->items[0].prio : NULL)) {
+            lval* err = lval_err("Function 'heap' passed a %s as a priority. "
+                "Expected numbers or strings, matching the other priorities.",
+                ltype_name(a->cell[0]->type));
+            lval_del(x); lval_del(a);
+            return err;
+        }
+        lval* p = lval_pop(a, 0);
+        lheap_push(h, p, lval_pop(a, 0));
+    }
+    lval_del(a);
+    return x;
+}
+
+/* Adds values with priorities in place and returns the heap */
+lval* builtin_heap_push(lenv* e, lval* a) {
+    LASSERT(a, a->count >= 3 && a->count % 2 == 1,
+        "Function 'heap-push!' passed incorrect number of arguments. "
+        "Got %i, Expected a heap then priorities and values.", a->count);
+    LASSERT_TYPE("heap-push!", a, 0, LVAL_HEAP);
+    lheap* h = a->cell[0]->data.heap;
+    for (int i = 1; i < a->count; i += 2) {
+        lval* other = h->count ? h->items[0].prio : a->cell[1];
+        LASSERT(a, lval_orderable(a->cell[i], other),
+            "Function 'heap-push!' passed a %s as a priority. "
+            "Expected numbers or strings, matching the other priorities.",
+            ltype_name(a->cell[i]->type));
+    }
+
+    lval* x = lval_pop(a, 0);
+    while (a->count) {
+        lval* p = lval_pop(a, 0);
+        lheap_push(h, p, lval_pop(a, 0));
+    }
+    lval_del(a);
+    return x;
+}
+
+/* Returns the {priority value} pair with the least priority. Equal
+ * priorities come out in the order they went in. heap-pop! also
+ * removes it. */
+lval* builtin_heap_first(lenv* e, lval* a, char* func) {
+    LASSERT_NUM(func, a, 1);
+    LASSERT_TYPE(func, a, 0, LVAL_HEAP);
+    lheap* h = a->cell[0]->data.heap;
+    LASSERT(a, h->count > 0, "Function '%s' passed an empty heap.", func);
+
+    lval* p;
+    lval* v;
+    if (strcmp(func, "heap-pop!") == 0) {
+        lheap_pop(h, &p, &v);
+    } else {
+        p = lval_copy(h->items[0].prio);
+        v = lval_copy(h->items[0].val);
+    }
+    lval_del(a);
+    return lval_add(lval_add(lval_qexpr(), p), v);
+}
+
+lval* builtin_heap_pop(lenv* e, lval* a) {
+    return builtin_heap_first(e, a, "heap-pop!");
+}
+
+lval* builtin_heap_peek(lenv* e, lval* a) {
+    return builtin_heap_first(e, a, "heap-peek");
+}
+
+/* Builds a deque from the arguments, or from the elements of a single
+ * Q-Expr */
+lval* builtin_deque(lenv* e, lval* a) {
+    if (a->count == 1 && a->cell[0]->type == LVAL_QEXPR) {
+        a = lval_take(a, 0);
+    }
+    ldeque* d = ldeque_new();
+    while (a->count) {
+        ldeque_push_back(d, lval_pop(a, 0));
+    }
+    lval_del(a);
+    return lval_deque(d);
+}
+
+/* Adds values in place at one end and returns the deque */
+lval* builtin_deque_push(lenv* e, lval* a, char* func) {
+    LASSERT(a, a->count >= 2,
+        "Function '%s' passed incorrect number of arguments. "
+        "Got %i, Expected at least 2.", func, a->count);
+    LASSERT_TYPE(func, a, 0, LVAL_DEQUE);
+
+    lval* x = lval_pop(a, 0);
+    bool front = strcmp(func, "deque-push-front!") == 0;
+    while (a->count) {
+        lval* y = lval_pop(a, 0);
+        if (front) { ldeque_push_front(x->data.deque, y); }
+        else { ldeque_push_back(x->data.deque, y); }
+    }
+    lval_del(a);
+    return x;
+}
+
+lval* builtin_deque_push_front(lenv* e, lval* a) {
+    return builtin_deque_push(e, a, "deque-push-front!");
+}
+
+lval* builtin_deque_push_back(lenv* e, lval* a) {
+    return builtin_deque_push(e, a, "deque-push-back!");
+}
+
+/* Returns the value at one end. The pop functions also remove it. */
+lval* builtin_deque_end(lenv* e, lval* a, char* func) {
+    LASSERT_NUM(func, a, 1);
+    LASSERT_TYPE(func, a, 0, LVAL_DEQUE);
+    ldeque* d = a->cell[0]->data.deque;
+    LASSERT(a, d->count > 0, "Function '%s' passed an empty deque.", func);
+
+    lval* x;
+    if (strcmp(func, "deque-pop-front!") == 0) { x = ldeque_pop_front(d); }
+    else if (strcmp(func, "deque-pop-back!") == 0) { x = ldeque_pop_back(d); }
+    else if (strcmp(func, "deque-front") == 0) { x = lval_copy(ldeque_get(d, 0)); }
+    else { x = lval_copy(ldeque_get(d, d->count - 1)); }
+    lval_del(a);
+    return x;
+}
+
+lval* builtin_deque_pop_front(lenv* e, lval* a) {
+    return builtin_deque_end(e, a, "deque-pop-front!");
+}
+
+lval* builtin_deque_pop_back(lenv* e, lval* a) {
+    return builtin_deque_end(e, a, "deque-pop-back!");
+}
+
+lval* builtin_deque_front(lenv* e, lval* a) {
+    return builtin_deque_end(e, a, "deque-front");
+}
+
+lval* builtin_deque_back(lenv* e, lval* a) {
+    return builtin_deque_end(e, a, "deque-back");
+}
+
+/* Returns element i counting from the front */
+lval* builtin_deque_get(lenv* e, lval* a) {
+    LASSERT_NUM("deque-get", a, 2);
+    LASSERT_TYPE("deque-get", a, 0, LVAL_DEQUE);
+    LASSERT_TYPE("deque-get", a, 1, LVAL_INT);
+    ldeque* d = a->cell[0]->data.deque;
+    long i = a->cell[1]->data.integer;
+    LASSERT(a, i >= 0 && i < d->count,
+        "Function 'deque-get' passed index %li. Expected 0 to %li.", i, d->count - 1);
+
+    lval* x = lval_copy(ldeque_get(d, i));
+    lval_del(a);
+    return x;
+}
+
+lval* builtin_deque_list(lenv* e, lval* a) {
+    LASSERT_NUM("deque->list", a, 1);
+    LASSERT_TYPE("deque->list", a, 0, LVAL_DEQUE);
+
+    ldeque* d = a->cell[0]->data.deque;
+    lval* q = lval_qexpr();
+    for (long i = 0; i < d->count; i++) {
+        lval_add(q, lval_copy(ldeque_get(d, i)));
+    }
+    lval_del(a);
+    return q;
+}
+
+/* Builds an array from the arguments, or from the elements of a single
+ * Q-Expr */
+lval* builtin_array(lenv* e, lval* a) {
+    if (a->count == 1 && a->cell[0]->type == LVAL_QEXPR) {
+        a = lval_take(a, 0);
+    }
+    larray* x = larray_new(a->count);
+    for (int i = 0; i < a->count; i++) {
+        larray_push(x, a->cell[i]);
+    }
+    /* The elements now belong to the array */
+    a->count = 0;
+    lval_del(a);
+    return lval_array(x);
+}
+
+/* An array of n copies of a value */
+/* Sizes past this are refused rather than allocating gigabytes */
+#define ARRAY_MAX (1L << 24)
+
+lval* builtin_make_array(lenv* e, lval* a) {
+    LASSERT_NUM("make-array", a, 2);
+    LASSERT_TYPE("make-array", a, 0, LVAL_INT);
+    long n = a->cell[0]->data.integer;
+    LASSERT(a, n >= 0, "Function 'make-array' passed a negative size %li.", n);
+    LASSERT(a, n <= ARRAY_MAX,
+        "Function 'make-array' passed size %li. Expected at most %li.", n, ARRAY_MAX);
+
+    larray* x = larray_new(n);
+    LASSERT(a, x, "Function 'make-array' could not allocate %li elements.", n);
+    for (long i = 0; i < n; i++) {
+        larray_push(x, lval_copy(a->cell[1]));
+    }
+    lval_del(a);
+    return lval_array(x);
+}
+
+#define LASSERT_INDEX(func, args, index, count) \
+    LASSERT(args, args->cell[index]->data.integer >= 0 && \
+            args->cell[index]->data.integer < count, \
+        "Function '%s' passed index %li. Expected 0 to %li.", func, \
+        args->cell[index]->data.integer, (long) (count) - 1)
+
+/* Element i of an array or numeric vector, in constant time */
+lval* builtin_vec_get(lenv* e, lval* a) {
+    LASSERT_NUM("vec-get", a, 2);
+    int t = a->cell[0]->type;
+    LASSERT(a, t == LVAL_ARRAY || t == LVAL_VEC,
+        "Function 'vec-get' passed incorrect type for argument 0. "
+        "Got %s, Expected %s or %s.", ltype_name(t),
+        ltype_name(LVAL_ARRAY), ltype_name(LVAL_VEC));
+    LASSERT_TYPE("vec-get", a, 1, LVAL_INT);
+    long i = a->cell[1]->data.integer;
+
+    lval* x;
+    if (t == LVAL_ARRAY) {
+        larray* arr = a->cell[0]->data.array;
+        LASSERT_INDEX("vec-get", a, 1, arr->count);
+        x = lval_copy(arr->items[i]);
+    } else {
+        lvec* v = a->cell[0]->data.vec;
+        LASSERT_INDEX("vec-get", a, 1, v->count);
+        x = v->kind == LVEC_INT ? lval_int(v->items.ints[i]) : lval_dec(v->items.decs[i]);
+    }
+    lval_del(a);
+    return x;
+}
+
+/* Replaces element i in place and returns the array */
+lval* builtin_vec_set(lenv* e, lval* a) {
+    LASSERT_NUM("vec-set!", a, 3);
+    LASSERT_TYPE("vec-set!", a, 0, LVAL_ARRAY);
+    LASSERT_TYPE("vec-set!", a, 1, LVAL_INT);
+    LASSERT_INDEX("vec-set!", a, 1, a->cell[0]->data.array->count);
+
+    lval* x = lval_pop(a, 0);
+    long i = a->cell[0]->data.integer;
+    larray_set(x->data.array, i, lval_pop(a, 1));
+    lval_del(a);
+    return x;
+}
+
+/* Appends values in place and returns the array */
+lval* builtin_vec_push(lenv* e, lval* a) {
+    LASSERT(a, a->count >= 2,
+        "Function 'vec-push!' passed incorrect number of arguments. "
+        "Got %i, Expected at least 2.", a->count);
+    LASSERT_TYPE("vec-push!", a, 0, LVAL_ARRAY);
+
+    lval* x = lval_pop(a, 0);
+    while (a->count) {
+        larray_push(x->data.array, lval_pop(a, 0));
+    }
+    lval_del(a);
+    return x;
+}
+
+/* Removes and returns the last element */
+lval* builtin_vec_pop(lenv* e, lval* a) {
+    LASSERT_NUM("vec-pop!", a, 1);
+    LASSERT_TYPE("vec-pop!", a, 0, LVAL_ARRAY);
+    LASSERT(a, a->cell[0]->data.array->count > 0,
+        "Function 'vec-pop!' passed an empty array.");
+
+    lval* x = larray_pop(a->cell[0]->data.array);
+    lval_del(a);
+    return x;
+}
+
+/* Copies the current contents of an array into a Q-Expr. The array can
+ * still be changed afterwards without affecting the list. */
+lval* builtin_freeze(lenv* e, lval* a) {
+    LASSERT_NUM("freeze", a, 1);
+    LASSERT_TYPE("freeze", a, 0, LVAL_ARRAY);
+
+    larray* arr = a->cell[0]->data.array;
+    lval* q = lval_qexpr();
+    q->cell = malloc(sizeof(lval*) * arr->count);
+    q->count = arr->count;
+    for (long i = 0; i < arr->count; i++) {
+        q->cell[i] = lval_copy(arr->items[i]);
+    }
+    lval_del(a);
+    return q;
+}
+
+/* Bits past this are refused, the same limit as make-array */
+#define BITS_MAX (1L << 24)
+
+#define LASSERT_BIT(func, args, index) \
+    LASSERT_TYPE(func, args, index, LVAL_INT); \
+    LASSERT(args, args->cell[index]->data.integer >= 0 && \
+            args->cell[index]->data.integer < BITS_MAX, \
+        "Function '%s' passed bit %li. Expected 0 to %li.", func, \
+        args->cell[index]->data.integer, BITS_MAX - 1)
+
+/* Sets or clears the bits given by arguments from 'from' on. Returns
+ * false if the bitset could not grow to hold a bit */
+bool bits_assign(lbits* b, lval* a, int from, bool on) {
+    for (int i = from; i < a->count; i++) {
+        long n = a->cell[i]->data.integer;
+        if (on) {
+            if (!lbits_reserve(b, n / 64 + 1)) { return false; }
+            b->words[n / 64] |= (uint64_t) 1 << (n % 64);
+        } else if (n / 64 < b->nwords) {
+            b->words[n / 64] &= ~((uint64_t) 1 << (n % 64));
+        }
+    }
+    return true;
+}
+
+/* Builds a bitset holding the arguments, or the elements of a single
+ * Q-Expr */
+lval* builtin_bits(lenv* e, lval* a) {
+    if (a->count == 1 && a->cell[0]->type == LVAL_QEXPR) {
+        a = lval_take(a, 0);
+    }
+    for (int i = 0; i < a->count; i++) {
+        LASSERT_BIT("bits", a, i);
+    }
+    lbits* b = lbits_new(1);
+    LASSERT(a, b, "Function 'bits' could not allocate a bitset.");
+    if (!bits_assign(b, a, 0, true)) {
+        lbits_release(b);
+        lval_del(a);
+        return lval_err("Function 'bits' could not allocate a bitset.");
+    }
+    lval_del(a);
+    return lval_bits(b);
+}
+
+lval* builtin_bits_change(lenv* e, lval* a, char* func, bool on) {
+    LASSERT(a, a->count >= 2,
+        "Function '%s' passed incorrect number of arguments. "
+        "Got %i, Expected at least 2.", func, a->count);
+    LASSERT_TYPE(func, a, 0, LVAL_BITS);
+    for (int i = 1; i < a->count; i++) {
+        LASSERT_BIT(func, a, i);
+    }
+    LASSERT(a, bits_assign(a->cell[0]->data.bits, a, 1, on),
+        "Function '%s' could not grow the bitset.", func);
+    return lval_take(a, 0);
+}
+
+/* Adds bits in place and returns the bitset */
+lval* builtin_bits_set(lenv* e, lval* a) {
+    return builtin_bits_change(e, a, "bits-set!", true);
+}
+
+/* Removes bits in place and returns the bitset */
+lval* builtin_bits_clear(lenv* e, lval* a) {
+    return builtin_bits_change(e, a, "bits-clear!", false);
+}
+
+lval* builtin_bits_test(lenv* e, lval* a) {
+    LASSERT_NUM("bits-test", a, 2);
+    LASSERT_TYPE("bits-test", a, 0, LVAL_BITS);
+    LASSERT_BIT("bits-test", a, 1);
+
+    lbits* b = a->cell[0]->data.bits;
+    long n = a->cell[1]->data.integer;
+    bool on = n / 64 < b->nwords && (b->words[n / 64] >> (n % 64) & 1);
+    lval_del(a);
+    return lval_bool(on);
+}
+
+/* Combines two bitsets into a new one, leaving both unchanged */
+lval* builtin_bits_op(lenv* e, lval* a, char* func, int op) {
+    LASSERT_NUM(func, a, 2);
+    LASSERT_TYPE(func, a, 0, LVAL_BITS);
+    LASSERT_TYPE(func, a, 1, LVAL_BITS);
+
+    lbits* r = bits_op(a->cell[0]->data.bits, a->cell[1]->data.bits, op);
+    LASSERT(a, r, "Function '%s' could not allocate a bitset.", func);
+    lval_del(a);
+    return lval_bits(r);
+}
+
+lval* builtin_bits_and(lenv* e, lval* a) {
+    return builtin_bits_op(e, a, "bits-and", BITS_AND);
+}
+
+lval* builtin_bits_or(lenv* e, lval* a) {
+    return builtin_bits_op(e, a, "bits-or", BITS_OR);
+}
+
+lval* builtin_bits_xor(lenv* e, lval* a) {
+    return builtin_bits_op(e, a, "bits-xor", BITS_XOR);
+}
+
+lval* builtin_bits_andnot(lenv* e, lval* a) {
+    return builtin_bits_op(e, a, "bits-andnot", BITS_ANDNOT);
+}
+
+/* Number of bits set */
+lval* builtin_bits_count(lenv* e, lval* a) {
+    LASSERT_NUM("bits-count", a, 1);
+    LASSERT_TYPE("bits-count", a, 0, LVAL_BITS);
+
+    lbits* b = a->cell[0]->data.bits;
+    long n = bits_count(b->words, b->nwords);
+    lval_del(a);
+    return lval_int(n);
+}
+
+/* The bits that are set, in increasing order */
+lval* builtin_bits_list(lenv* e, lval* a) {
+    LASSERT_NUM("bits->list", a, 1);
+    LASSERT_TYPE("bits->list", a, 0, LVAL_BITS);
+
+    lbits* b = a->cell[0]->data.bits;
+    lval* q = lval_qexpr();
+    for (long i = 0; i < b->nwords; i++) {
+        for (uint64_t w = b->words[i]; w; w &= w - 1) {
+            lval_add(q, lval_int(i * 64 + __builtin_ctzll(w)));
+        }
+    }
+    lval_del(a);
+    return q;
+}
+
+lval* builtin_lessthan(lenv* e, lval* a) {
+    return builtin_cond(e, a, "<");
+}
+
+lval* builtin_greaterthan(lenv* e, lval* a) {
+    return builtin_cond(e, a, ">");
+}
+
+/* Checks an entry of one ordered map against another, given as
+ * {mismatch, other map}. Sets mismatch and stops on a difference. */
+bool omap_eq_entry(lval* k, lval* v, void* arg) {
+    lval** pair = arg;
+    lval* yk;
+    lval* yv;
+    if (lomap_floor(pair[1]->data.omap, k, &yk, &yv) &&
+            lval_eq(k, yk) && lval_eq(v, yv)) {
+        return true;
+    }
+    pair[0] = k;
+    return false;
+}
+
+/* Orders heap entries the way they are popped */
+static int heap_entry_cmp(const void* a, const void* b) {
+    const lheap_entry* x = a;
+    const lheap_entry* y = b;
+    int c = lval_cmp(x->prio, y->prio);
+    return c ? c : (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+/* Heaps are equal when they would pop the same entries in the same
+ * order, whatever the layout of their arrays */
+static bool heap_eq(lheap* x, lheap* y) {
+    if (x->count != y->count) { return false; }
+    lheap_entry* xs = malloc(sizeof(lheap_entry) * (x->count + 1));
+    lheap_entry* ys = malloc(sizeof(lheap_entry) * (y->count + 1));
+    memcpy(xs, x->items, sizeof(lheap_entry) * x->count);
+    memcpy(ys, y->items, sizeof(lheap_entry) * y->count);
+    qsort(xs, x->count, sizeof(lheap_entry), heap_entry_cmp);
+    qsort(ys, y->count, sizeof(lheap_entry), heap_entry_cmp);
+
+    bool eq = true;
+    for (long i = 0; i < x->count && eq; i++) {
+        eq = lval_eq(xs[i].prio, ys[i].prio) && lval_eq(xs[i].val, ys[i].val);
+    }
+    free(xs);
+    free(ys);
+    return eq;
+}
+
+/* Pairs of containers being compared, innermost first */
+static lval_walk* comparing;
+
+/* Compares two containers of the same type. Meeting a pair again means
+ * the comparison has come round a cycle, which is no reason for the two
+ * to differ, so the pair counts as equal. */
+static bool lval_eq_shared(lval* x, lval* y) {
+    void* sx = lval_shared(x);
+    void* sy = lval_shared(y);
+    if (sx == sy || lval_walking(comparing, sx, sy)) { return true; }
+
+    lval_walk w = { sx, sy, comparing };
+    comparing = &w;
+    bool eq = true;
+
+    switch (x->type) {
+        case LVAL_DICT: {
+            ldict* d = x->data.dict;
+            if (d->count != y->data.dict->count) { eq = false; break; }
+            for (long i = 0; i < d->capacity && eq; i++) {
+                if (!d->entries[i].key) { continue; }
+                lval* v = ldict_get(y->data.dict, d->entries[i].key);
+                eq = v && lval_eq(d->entries[i].val, v);
+            }
+            break;
+        }
+        case LVAL_HEAP: eq = heap_eq(x->data.heap, y->data.heap); break;
+        case LVAL_ARRAY:
+            if (x->data.array->count != y->data.array->count) { eq = false; break; }
+            for (long i = 0; i < x->data.array->count && eq; i++) {
+                eq = lval_eq(x->data.array->items[i], y->data.array->items[i]);
+            }
+            break;
+        case LVAL_DEQUE:
+            if (x->data.deque->count != y->data.deque->count) { eq = false; break; }
+            for (long i = 0; i < x->data.deque->count && eq; i++) {
+                eq = lval_eq(ldeque_get(x->data.deque, i), ldeque_get(y->data.deque, i));
+            }
+            break;
+        case LVAL_OMAP: {
+            if (x->data.omap->count != y->data.omap->count) { eq = false; break; }
+            lval* pair[2] = { NULL, y };
+            lomap_range(x->data.omap, NULL, NULL, omap_eq_entry, pair);
+            eq = pair[0] == NULL;
+            break;
+        }
+    }
+
+    comparing = w.up;
+    return eq;
+}
+
+bool lval_eq(lval* x, lval* y) {
+
+    /* If two lvals are not the same type, return false. */
+    if (x->type != y->type) {
+        return false;
+    }
+    if (lval_shared(x)) {
+        return lval_eq_shared(x, y);
+    }
+    
+    switch (x->type) {
+        case LVAL_INT: return (x->data.integer == y->data.integer);
+        case LVAL_BIG: return bignum_cmp(x->data.big, y->data.big) == 0;
+        case LVAL_VEC:
+            if (x->data.vec->kind != y->data.vec->kind ||
+                    x->data.vec->count != y->data.vec->count) { return false; }
+            for (long i = 0; i < x->data.vec->count; i++) {
+                if (x->data.vec->kind == LVEC_INT ?
+                        x->data.vec->items.ints[i] != y->data.vec->items.ints[i] :
+                        x->data.vec->items.decs[i] != y->data.vec->items.decs[i]) {
+                    return false;
+                }
+            }
+            return true;
+        case LVAL_BITS: {
+            lbits* b = x->data.bits;
+            long n = lbits_used(b);
+            return n == lbits_used(y->data.bits) &&
+                memcmp(b->words, y->data.bits->words, sizeof(uint64_t) * n) == 0;
+        }
+        case LVAL_RECORD: {
+            lrecord* r = x->data.record;
+            if (r->shape != y->data.record->shape) { return false; }
+            for (int i = 0; i < r->shape->count; i++) {
+                if (!lval_eq(r->fields[i], y->data.record->fields[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case LVAL_DEC: return (x->data.decimal == y->data.decimal);
+        case LVAL_BOOL: return (x->data.boolean == y->data.boolean);
+        case LVAL_ERR: return (strcmp(x->data.err, y->data.err) == 0);
+        case LVAL_SYM: return (strcmp(x->data.sym, y->data.sym) == 0);
+        case LVAL_STR: return (strcmp(x->data.str, y->data.str) == 0);
+        case LVAL_FUN: 
+                   if (x->builtin || y-> builtin) {
+                       return x->builtin == y->builtin &&
+                           x->data.field.shape == y->data.field.shape &&
+                           x->data.field.memo == y->data.field.memo &&
+                           (!x->data.field.shape ||
+                            x->data.field.index == y->data.field.index);
+                   } 
+                   else {
+                       return lval_eq(x->formals, y->formals) &&
+                          lval_eq(x->body, y->body); 
+                   }
+        case LVAL_QEXPR:
+        case LVAL_SEXPR:
+            if (x->count != y->count) { return false; }
+            
+            for (int i = 0; i < x->count; i++) {
+                if (!lval_eq(x->cell[i], y->cell[i])) {
+                    return false;
+                }
+            }
+            return true;
+        default: return false;
+    }
+}
+
+lval* builtin_comp(lenv* e, lval* a, char* op) {
+    LASSERT_NUM("==", a, 2);
+    lval* x = lval_pop(a, 0);
+    lval* y = lval_pop(a, 0);
+    bool b = lval_eq(x, y);
+    lval_del(a); lval_del(x); lval_del(y);
+    if (strcmp(op, "==") == 0) { return lval_bool(b); }
+    if (strcmp(op, "!=") == 0) { return lval_bool(!b); }
+    else { return lval_err("Incorrect operator passed to builtin_comp."); }
+}
+
+lval* builtin_equal(lenv* e, lval* a) {
+    return builtin_comp(e, a, "==");
+}
+
+lval* builtin_notequal(lenv* e, lval* a) {
+    return builtin_comp(e, a, "!=");
+}
+
+lval* builtin_lessorequal(lenv* e, lval* a) {
+    return builtin_cond(e, a, "<=");
+}
+
+lval* builtin_greaterorequal(lenv* e, lval* a) {
+    return builtin_cond(e, a, ">=");
+}
+
+lval* builtin_if(lenv* e, lval* a) {
+    LASSERT_NUM("if", a, 3);
+    LASSERT_TYPE("if", a, 0, LVAL_BOOL);
+    LASSERT_TYPE("if", a, 1, LVAL_QEXPR);
+    LASSERT_TYPE("if", a, 2, LVAL_QEXPR);
+
+    lval* b = lval_pop(a, 0);
+
+    if (b->data.boolean) {
+        /* Take first expression and evaluate it */
+        lval* s = lval_take(a, 0);
+        s->type = LVAL_SEXPR;
+        return lval_eval(e, s);
+    }
+    else {
+        /* Take the second expression and evaluate it */
+        lval* s = lval_take(a, 1);
+        s->type = LVAL_SEXPR;
+        return lval_eval(e, s);
+    }
+}
+
+lval* builtin_xor(lenv* e, lval* a, char* op) {
+    LASSERT_NUM("or", a, 2);
+    LASSERT_TYPE("or", a, 0, LVAL_BOOL);
+    LASSERT_TYPE("or", a, 1, LVAL_BOOL);
+
+    lval* x = lval_pop(a, 0);
+    lval* y = lval_take(a, 0);
+    lval* b = NULL;
+
+    if (strcmp(op, "||") == 0) {
+        b = lval_bool(x->data.boolean || y->data.boolean);
+    }
+    else if (strcmp(op, "&&") == 0) {
+        b = lval_bool(x->data.boolean && y->data.boolean);
+    }
+    else {
+        b = lval_err("Unknown boolean operator '%s'.", op);
+    }
+    lval_del(x); lval_del(y);
+    return b;
+}
+
+lval* builtin_or(lenv* e, lval* a) {
+    return builtin_xor(e, a, "||");
+}
+
+lval* builtin_and(lenv* e, lval* a) {
+    return builtin_xor(e, a, "&&");
+}
+
+lval* builtin_not(lenv* e, lval* a) {
+    LASSERT_NUM("not", a, 1);
+    LASSERT_TYPE("not", a, 0, LVAL_BOOL);
+
+    if (a->cell[0]->data.boolean) {
+        lval_del(a);
+        return lval_bool(0);
+    }
+    else {
+        lval_del(a);
+        return lval_bool(1);
+    }
+}
+
+bool is_builtin(lenv* e, lval* a) {
+    LASSERT(a, a->type == LVAL_SYM, "Function 'is_builtin' passed a non-function argument.");
+    /* Iterate to the first parent environment */
+    while (e->par) {
+        e = e->par;
+    }
+    /* Find the symbol in the environment and check if builtin == NULL */
+    for (int i = 0; i < e->count; i++) {
+        if (strcmp(a->data.sym, e->syms[i]) == 0) {
+            if (e->vals[i]->type == LVAL_FUN && e->vals[i]->builtin != NULL &&
+                    e->vals[i]->data.field.shape == NULL &&
+                    e->vals[i]->data.field.memo == NULL) {
+                return true; // Symbol found and builtin was not NULL
+            }
+            else { return false; } // Symbol found and builtin NULL
+        }
+    }
+    return false; // Symbol not found
+}
+
+lval* builtin_var(lenv* e, lval* a, char* func) {
     LASSERT_TYPE("def", a, 0, LVAL_QEXPR);
     
     /* First argument is symbol list */
@@ -808,35 +2794,368 @@ lval* builtin_fun(lenv* e, lval* a) {
     return builtin_def(e, x);
 }
 
+/* Record types. The functions defrecord makes are builtins that carry
+ * the record's shape, and lval_call passes them themselves as the
+ * first argument. */
+
+/* Makes a record from one value per field */
+lval* builtin_record_new(lenv* e, lval* a) {
+    lshape* s = a->cell[0]->data.field.shape;
+    LASSERT(a, a->count - 1 == s->count,
+        "Function '%s' passed incorrect number of arguments. "
+        "Got %i, Expected %i.", s->name, a->count - 1, s->count);
+
+    lrecord* r = lrecord_new(s);
+    for (int i = 0; i < s->count; i++) {
+        r->fields[i] = lval_pop(a, 1);
+    }
+    lval_del(a);
+    return lval_record(r);
+}
+
+/* Reads one field, at an index fixed when the accessor was made */
+lval* builtin_record_get(lenv* e, lval* a) {
+    lshape* s = a->cell[0]->data.field.shape;
+    int index = a->cell[0]->data.field.index;
+    char* name = s->accessors[index];
+    LASSERT(a, a->count == 2,
+        "Function '%s' passed incorrect number of arguments. "
+        "Got %i, Expected 1.", name, a->count - 1);
+    LASSERT(a, a->cell[1]->type == LVAL_RECORD && a->cell[1]->data.record->shape == s,
+        "Function '%s' passed incorrect type for argument 0. "
+        "Got %s%s, Expected %s.", name,
+        a->cell[1]->type == LVAL_RECORD ?
+            a->cell[1]->data.record->shape->name : ltype_name(a->cell[1]->type),
+        a->cell[1]->type == LVAL_RECORD &&
+            strcmp(a->cell[1]->data.record->shape->name, s->name) == 0 ?
+            " from an earlier defrecord" : "",
+        s->name);
+
+    lval* x = lval_copy(a->cell[1]->data.record->fields[index]);
+    lval_del(a);
+    return x;
+}
+
+lval* builtin_record_is(lenv* e, lval* a) {
+    lshape* s = a->cell[0]->data.field.shape;
+    LASSERT(a, a->count == 2,
+        "Function '%s' passed incorrect number of arguments. "
+        "Got %i, Expected 1.", s->predicate, a->count - 1);
+    bool is = a->cell[1]->type == LVAL_RECORD && a->cell[1]->data.record->shape == s;
+    lval_del(a);
+    return lval_bool(is);
+}
+
+/* Shape of the record type the global constructor name currently makes,
+ * if it has these fields, so repeating a defrecord keeps old values valid */
+static lshape* record_shape(lenv* e, char* name, int count, char** fields) {
+    while (e->par) { e = e->par; }
+    for (int i = 0; i < e->count; i++) {
+        if (strcmp(e->syms[i], name) != 0) { continue; }
+        lval* v = e->vals[i];
+        if (v->type == LVAL_FUN && v->builtin == builtin_record_new &&
+                lshape_matches(v->data.field.shape, name, count, fields)) {
+            return lshape_retain(v->data.field.shape);
+        }
+        return NULL;
+    }
+    return NULL;
+}
+
+/* (defrecord {name field ...}) defines the constructor name, the test
+ * is-name and an accessor name-field for each field */
+lval* builtin_defrecord(lenv* e, lval* a) {
+    LASSERT_NUM("defrecord", a, 1);
+    LASSERT_TYPE("defrecord", a, 0, LVAL_QEXPR);
+    lval* q = a->cell[0];
+    LASSERT(a, q->count >= 1, "Function 'defrecord' passed no record name.");
+    for (int i = 0; i < q->count; i++) {
+        LASSERT(a, q->cell[i]->type == LVAL_SYM,
+            "Function 'defrecord' passed incorrect type for element %i. "
+            "Got %s, Expected %s.", i, ltype_name(q->cell[i]->type),
+            ltype_name(LVAL_SYM));
+        for (int j = 1; j < i; j++) {
+            LASSERT(a, strcmp(q->cell[i]->data.sym, q->cell[j]->data.sym) != 0,
+                "Function 'defrecord' passed field %s twice.", q->cell[i]->data.sym);
+        }
+    }
+
+    char** fields = malloc(sizeof(char*) * q->count);
+    for (int i = 1; i < q->count; i++) { fields[i - 1] = q->cell[i]->data.sym; }
+    lshape* s = record_shape(e, q->cell[0]->data.sym, q->count - 1, fields);
+    if (!s) { s = lshape_new(q->cell[0]->data.sym, q->count - 1, fields); }
+    free(fields);
+
+    /* Collect the definitions, then check none replaces a builtin */
+    lval* defs = lval_qexpr();
+    lval_add(defs, lval_add(lval_add(lval_qexpr(), lval_sym(s->name)),
+        lval_record_fun(builtin_record_new, s, -1)));
+    lval_add(defs, lval_add(lval_add(lval_qexpr(), lval_sym(s->predicate)),
+        lval_record_fun(builtin_record_is, s, -1)));
+    for (int i = 0; i < s->count; i++) {
+        lval_add(defs, lval_add(lval_add(lval_qexpr(), lval_sym(s->accessors[i])),
+            lval_record_fun(builtin_record_get, s, i)));
+    }
+    lshape_release(s);
+
+    for (int i = 0; i < defs->count; i++) {
+        lval* sym = defs->cell[i]->cell[0];
+        if (is_builtin(e, sym)) {
+            lval* err = lval_err("Invalid attempt to redefine builtin function %s.",
+                sym->data.sym);
+            lval_del(defs); lval_del(a);
+            return err;
+        }
+    }
+    for (int i = 0; i < defs->count; i++) {
+        lenv_def(e, defs->cell[i]->cell[0], defs->cell[i]->cell[1]);
+    }
+
+    lval_del(defs);
+    lval_del(a);
+    return lval_sexpr();
+}
+
+/* Memoised functions. memo wraps a function in a builtin that carries a
+ * table of its results, and lval_call passes the builtin itself first. */
+
+/* Entries kept when memo is not given a size */
+#define MEMO_CAPACITY 4096
+
+/* Calls the wrapped function, which lval_call may change, on a copy */
+lval* memo_apply(lenv* e, lmemo* m, lval* args) {
+    lval* f = lval_copy(m->fn);
+    lval* r = lval_call(e, f, args);
+    lval_del(f);
+    return r;
+}
+
+/* Identifies a function the same way in every run: a builtin by its
+ * name, a lambda by its formals, body and any arguments already bound.
+ * What the body calls is not included. Returns false for a function
+ * that cannot be encoded. */
+bool memo_fn_id(lval* f, uint64_t* id) {
+    if (f->builtin && (f->data.field.shape || f->data.field.memo)) { return false; }
+    lbuf b;
+    lbuf_init(&b);
+    bool ok;
+    if (f->builtin) {
+        lval* name = lval_sym(func_name(f));
+        ok = lval_encode(&b, name);
+        lval_del(name);
+    } else {
+        ok = lval_encode(&b, f->formals) && lval_encode(&b, f->body);
+        for (int i = 0; ok && i < f->env->count; i++) {
+            lval* sym = lval_sym(f->env->syms[i]);
+            ok = lval_encode(&b, sym) && lval_encode(&b, f->env->vals[i]);
+            lval_del(sym);
+        }
+    }
+    *id = lbuf_hash(&b);
+    lbuf_free(&b);
+    return ok;
+}
+
+/* Result stored on disk for the encoded arguments, or NULL */
+lval* memo_disk_get(lmemo* m, lbuf* key) {
+    const uint8_t* p;
+    uint32_t n;
+    if (key->count > UINT32_MAX ||
+            !memofile_get(m->disk, m->id, key->data, key->count, &p, &n)) {
+        return NULL;
+    }
+    return lval_decode(&p, p + n);
+}
+
+/* Results that cannot be encoded are only kept in memory */
+void memo_disk_put(lmemo* m, lbuf* key, lval* r) {
+    lbuf val;
+    lbuf_init(&val);
+    if (key->count <= UINT32_MAX && lval_encode(&val, r) && val.count <= UINT32_MAX) {
+        memofile_put(m->disk, m->id, key->data, key->count, val.data, val.count);
+    }
+    lbuf_free(&val);
+}
+
+/* Looks the arguments up, in memory and then on disk, and calls the
+ * function on a miss. Errors are not cached, and neither are calls with
+ * mutable arguments. */
+lval* builtin_memo_call(lenv* e, lval* a) {
+    lval* self = lval_pop(a, 0);
+    lmemo* m = self->data.field.memo;
+    a->type = LVAL_QEXPR;
+
+    if (lval_has_mutable(a)) {
+        lval* r = memo_apply(e, m, a);
+        lval_del(self);
+        return r;
+    }
+
+    uint64_t h = lval_hash(a);
+    lval* r = lmemo_get(m, a, h);
+    if (r) {
+        r = lval_copy(r);
+        lval_del(a);
+        lval_del(self);
+        return r;
+    }
+
+    lbuf key;
+    lbuf_init(&key);
+    bool disk = m->disk && lval_encode(&key, a);
+    r = disk ? memo_disk_get(m, &key) : NULL;
+    if (r) {
+        /* Found on disk, so not a miss after all */
+        m->misses--;
+        m->hits++;
+    } else {
+        r = memo_apply(e, m, lval_copy(a));
+        if (disk && r->type != LVAL_ERR) { memo_disk_put(m, &key, r); }
+    }
+    lbuf_free(&key);
+
+    if (r->type != LVAL_ERR) {
+        lmemo_put(m, a, h, lval_copy(r));
+    } else {
+        lval_del(a);
+    }
+    lval_del(self);
+    return r;
+}
+
+/* Wraps a function so results are cached by argument value. Given a
+ * path, results are also kept in that file for later runs. */
+lval* builtin_memo(lenv* e, lval* a) {
+    LASSERT(a, a->count >= 1 && a->count <= 3,
+        "Function 'memo' passed incorrect number of arguments. "
+        "Got %i, Expected 1 to 3.", a->count);
+    LASSERT_TYPE("memo", a, 0, LVAL_FUN);
+    long n = MEMO_CAPACITY;
+    char* path = NULL;
+    int i = 1;
+    if (i < a->count && a->cell[i]->type == LVAL_INT) {
+        n = a->cell[i]->data.integer;
+        LASSERT(a, n > 0, "Function 'memo' passed size %li. Expected at least 1.", n);
+        i++;
+    }
+    if (i < a->count) {
+        LASSERT_TYPE("memo", a, i, LVAL_STR);
+        path = a->cell[i]->data.str;
+        i++;
+    }
+    LASSERT(a, i == a->count,
+        "Function 'memo' passed incorrect arguments. "
+        "Expected a function, then optionally a size and a path.");
+
+    lmemo* m = lmemo_new(lval_copy(a->cell[0]), n);
+    if (path && !memo_fn_id(m->fn, &m->id)) {
+        lmemo_release(m);
+        lval_del(a);
+        return lval_err("Function 'memo' cannot keep results of this function on disk.");
+    }
+    if (path && !(m->disk = memofile_open(path))) {
+        lval* err = lval_err("Function 'memo' could not open memo file '%s'.", path);
+        lmemo_release(m);
+        lval_del(a);
+        return err;
+    }
+    lval_del(a);
+    return lval_memo_fun(builtin_memo_call, m);
+}
+
+/* Like fun, but the function is memoised. Recursive calls go through
+ * the name, so they use the cache too. */
+lval* builtin_defmemo(lenv* e, lval* a) {
+    LASSERT(a, a->count == 2 || a->count == 3,
+        "Function 'defmemo' passed incorrect number of arguments. "
+        "Got %i, Expected 2 or 3.", a->count);
+    LASSERT_TYPE("defmemo", a, 0, LVAL_QEXPR);
+    LASSERT_TYPE("defmemo", a, 1, LVAL_QEXPR);
+    LASSERT(a, a->cell[0]->count > 0, "Function 'defmemo' passed no name.");
+    if (a->count == 3) { LASSERT_TYPE("defmemo", a, 2, LVAL_STR); }
+
+    lval* path = a->count == 3 ? lval_pop(a, 2) : NULL;
+    lval* name = lval_add(lval_qexpr(), lval_pop(a->cell[0], 0));
+    lval* lambda = builtin_lambda(e, a);
+    if (lambda->type == LVAL_ERR) {
+        lval_del(name);
+        if (path) { lval_del(path); }
+        return lambda;
+    }
+    lval* args = lval_add(lval_sexpr(), lambda);
+    if (path) { lval_add(args, path); }
+    lval* f = builtin_memo(e, args);
+    if (f->type == LVAL_ERR) {
+        lval_del(name);
+        return f;
+    }
+    return builtin_def(e, lval_add(lval_add(lval_qexpr(), name), f));
+}
+
+#define LASSERT_MEMO(func, args, index) \
+    LASSERT(args, args->cell[index]->type == LVAL_FUN && \
+            args->cell[index]->builtin == builtin_memo_call, \
+        "Function '%s' passed a function that is not memoised.", func)
+
+/* {hits misses size} for a memoised function */
+lval* builtin_memo_stats(lenv* e, lval* a) {
+    LASSERT_NUM("memo-stats", a, 1);
+    LASSERT_MEMO("memo-stats", a, 0);
+
+    lmemo* m = a->cell[0]->data.field.memo;
+    lval* q = lval_qexpr();
+    lval_add(q, lval_int(m->hits));
+    lval_add(q, lval_int(m->misses));
+    lval_add(q, lval_int(m->count));
+    lval_del(a);
+    return q;
+}
+
+/* Empties the cache and resets the counters */
+lval* builtin_memo_clear(lenv* e, lval* a) {
+    LASSERT_NUM("memo-clear!", a, 1);
+    LASSERT_MEMO("memo-clear!", a, 0);
+
+    lmemo* m = a->cell[0]->data.field.memo;
+    lmemo_clear(m);
+    m->hits = 0;
+    m->misses = 0;
+    return lval_take(a, 0);
+}
+
 lval* lval_read(mpc_ast_t* t);
 
 lval* builtin_load(lenv* e, lval* a) {
     LASSERT_NUM("load", a, 1);
     LASSERT_TYPE("load", a, 0, LVAL_STR);
 
-    /* Parse file given by string name */
-    mpc_result_t r;
-    if (mpc_parse_contents(a->cell[0]->data.str, Lispy, &r)) {
-        
-        /* Read contents */
-        lval* expr = lval_read(r.output);
-        mpc_ast_delete(r.output);
-
-        /* Evaluate each expression */
-        while (expr->count) {
-            lval* x = lval_eval(e, lval_pop(expr, 0));
+    /* Read and evaluate one expression at a time, so each is freed
+     * before the next is read */
+    long done = 0;
+    lsource src;
+    if (lsource_open(&src, a->cell[0]->data.str)) {
+        reader r;
+        reader_init(&r, src.data, src.count);
+        lval* x;
+        while ((x = reader_next(&r))) {
+            x = lval_eval(e, x);
             /* If evaluation is an error, print it */
             if (x->type == LVAL_ERR) { lval_println(x); }
             lval_del(x);
+            done++;
         }
+        bool ok = !r.error;
+        lsource_close(&src);
+        if (ok) {
+            lval_del(a);
+            return lval_sexpr();
+        }
+    }
 
-        /* Delete expression and arguments */
-        lval_del(expr);
-        lval_del(a);
-
-        /* Return empty list */
-        return lval_sexpr();
-    } else {
+    /* If it could not be read, parse with mpc for the error message.
+     * Expressions before the error have already been evaluated. */
+    mpc_result_t r;
+    if (!mpc_parse_contents_with(a->cell[0]->data.str, Lispy, &r, MPC_PARSE_ARENA)) {
         /* Get parse error as a string */
         char* err_msg = mpc_err_string(r.error);
         mpc_err_delete(r.error);
@@ -849,6 +3168,25 @@ lval* builtin_load(lenv* e, lval* a) {
         lval_del(a);
         return err;
     }
+
+    /* Should mpc accept it after all, evaluate the rest */
+    lval* expr = lval_read(r.output);
+    mpc_ast_delete(r.output);
+    while (expr->count) {
+        lval* x = lval_pop(expr, 0);
+        if (done-- <= 0) {
+            x = lval_eval(e, x);
+            if (x->type == LVAL_ERR) { lval_println(x); }
+        }
+        lval_del(x);
+    }
+
+    /* Delete expression and arguments */
+    lval_del(expr);
+    lval_del(a);
+
+    /* Return empty list */
+    return lval_sexpr();
 }
 
 lval* builtin_print(lenv* e, lval* a) {
@@ -875,6 +3213,13 @@ lval* builtin_error(lenv* e, lval* a) {
 }
 
 char* func_name(lval* func) {
+        if (func->data.field.shape) {
+            lshape* s = func->data.field.shape;
+            if (func->builtin == builtin_record_new) return s->name;
+            if (func->builtin == builtin_record_is) return s->predicate;
+            return s->accessors[func->data.field.index];
+        }
+        if (func->builtin == builtin_memo_call) return "memo";
         if (func->builtin == builtin_add) return "add";
         else if (func->builtin == builtin_sub) return "sub";
         else if (func->builtin == builtin_mul) return "mul";
@@ -883,6 +3228,83 @@ char* func_name(lval* func) {
         else if (func->builtin == builtin_pow) return "pow";
         else if (func->builtin == builtin_min) return "min";
         else if (func->builtin == builtin_max) return "max";
+        else if (func->builtin == builtin_vec) return "vec";
+        else if (func->builtin == builtin_vec_list) return "vec->list";
+        else if (func->builtin == builtin_vec_add) return "vec+";
+        else if (func->builtin == builtin_vec_mul) return "vec*";
+        else if (func->builtin == builtin_vsum) return "vsum";
+        else if (func->builtin == builtin_vmin) return "vmin";
+        else if (func->builtin == builtin_vmax) return "vmax";
+        else if (func->builtin == builtin_dot) return "dot";
+        else if (func->builtin == builtin_set_threads) return "set-threads";
+        else if (func->builtin == builtin_mean) return "mean";
+        else if (func->builtin == builtin_variance) return "variance";
+        else if (func->builtin == builtin_stddev) return "stddev";
+        else if (func->builtin == builtin_quantile) return "quantile";
+        else if (func->builtin == builtin_histogram) return "histogram";
+        else if (func->builtin == builtin_mat) return "mat";
+        else if (func->builtin == builtin_mat_list) return "mat->list";
+        else if (func->builtin == builtin_mat_dims) return "mat-dims";
+        else if (func->builtin == builtin_mat_identity) return "mat-identity";
+        else if (func->builtin == builtin_matmul) return "matmul";
+        else if (func->builtin == builtin_transpose) return "transpose";
+        else if (func->builtin == builtin_mat_add) return "mat+";
+        else if (func->builtin == builtin_mat_sub) return "mat-";
+        else if (func->builtin == builtin_mat_mul) return "mat*";
+        else if (func->builtin == builtin_solve) return "solve";
+        else if (func->builtin == builtin_sort) return "sort";
+        else if (func->builtin == builtin_dict) return "dict";
+        else if (func->builtin == builtin_dict_get) return "dict-get";
+        else if (func->builtin == builtin_dict_has) return "dict-has";
+        else if (func->builtin == builtin_dict_put) return "dict-put!";
+        else if (func->builtin == builtin_dict_remove) return "dict-remove!";
+        else if (func->builtin == builtin_dict_keys) return "dict-keys";
+        else if (func->builtin == builtin_dict_vals) return "dict-vals";
+        else if (func->builtin == builtin_dict_merge) return "dict-merge";
+        else if (func->builtin == builtin_omap) return "omap";
+        else if (func->builtin == builtin_omap_get) return "omap-get";
+        else if (func->builtin == builtin_omap_put) return "omap-put!";
+        else if (func->builtin == builtin_omap_remove) return "omap-remove!";
+        else if (func->builtin == builtin_omap_range) return "omap-range";
+        else if (func->builtin == builtin_omap_floor) return "omap-floor";
+        else if (func->builtin == builtin_omap_ceiling) return "omap-ceiling";
+        else if (func->builtin == builtin_omap_items) return "omap-items";
+        else if (func->builtin == builtin_omap_keys) return "omap-keys";
+        else if (func->builtin == builtin_omap_vals) return "omap-vals";
+        else if (func->builtin == builtin_heap) return "heap";
+        else if (func->builtin == builtin_heap_push) return "heap-push!";
+        else if (func->builtin == builtin_heap_pop) return "heap-pop!";
+        else if (func->builtin == builtin_heap_peek) return "heap-peek";
+        else if (func->builtin == builtin_deque) return "deque";
+        else if (func->builtin == builtin_deque_push_front) return "deque-push-front!";
+        else if (func->builtin == builtin_deque_push_back) return "deque-push-back!";
+        else if (func->builtin == builtin_deque_pop_front) return "deque-pop-front!";
+        else if (func->builtin == builtin_deque_pop_back) return "deque-pop-back!";
+        else if (func->builtin == builtin_deque_front) return "deque-front";
+        else if (func->builtin == builtin_deque_back) return "deque-back";
+        else if (func->builtin == builtin_deque_get) return "deque-get";
+        else if (func->builtin == builtin_deque_list) return "deque->list";
+        else if (func->builtin == builtin_array) return "array";
+        else if (func->builtin == builtin_make_array) return "make-array";
+        else if (func->builtin == builtin_vec_get) return "vec-get";
+        else if (func->builtin == builtin_vec_set) return "vec-set!";
+        else if (func->builtin == builtin_vec_push) return "vec-push!";
+        else if (func->builtin == builtin_vec_pop) return "vec-pop!";
+        else if (func->builtin == builtin_freeze) return "freeze";
+        else if (func->builtin == builtin_memo) return "memo";
+        else if (func->builtin == builtin_defmemo) return "defmemo";
+        else if (func->builtin == builtin_memo_stats) return "memo-stats";
+        else if (func->builtin == builtin_memo_clear) return "memo-clear!";
+        else if (func->builtin == builtin_bits) return "bits";
+        else if (func->builtin == builtin_bits_set) return "bits-set!";
+        else if (func->builtin == builtin_bits_clear) return "bits-clear!";
+        else if (func->builtin == builtin_bits_test) return "bits-test";
+        else if (func->builtin == builtin_bits_and) return "bits-and";
+        else if (func->builtin == builtin_bits_or) return "bits-or";
+        else if (func->builtin == builtin_bits_xor) return "bits-xor";
+        else if (func->builtin == builtin_bits_andnot) return "bits-andnot";
+        else if (func->builtin == builtin_bits_count) return "bits-count";
+        else if (func->builtin == builtin_bits_list) return "bits->list";
         else if (func->builtin == builtin_list) return "list";
         else if (func->builtin == builtin_head) return "head";
         else if (func->builtin == builtin_tail) return "tail";
@@ -911,6 +3333,7 @@ char* func_name(lval* func) {
         else if (func->builtin == builtin_or) return "or";
         else if (func->builtin == builtin_and) return "and";
         else if (func->builtin == builtin_fun) return "fun";
+        else if (func->builtin == builtin_defrecord) return "defrecord";
         else return "<function>";
 }
 
@@ -932,6 +3355,11 @@ void lenv_add_builtins(lenv* e) {
     lenv_add_builtin(e, "\\", builtin_lambda);
     lenv_add_builtin(e, "lambda", builtin_lambda);
     lenv_add_builtin(e, "fun", builtin_fun);
+    lenv_add_builtin(e, "defrecord", builtin_defrecord);
+    lenv_add_builtin(e, "memo", builtin_memo);
+    lenv_add_builtin(e, "defmemo", builtin_defmemo);
+    lenv_add_builtin(e, "memo-stats", builtin_memo_stats);
+    lenv_add_builtin(e, "memo-clear!", builtin_memo_clear);
     
     /* List Functions */
     lenv_add_builtin(e, "list", builtin_list);
@@ -942,6 +3370,7 @@ void lenv_add_builtins(lenv* e) {
     lenv_add_builtin(e, "cons", builtin_cons);
     lenv_add_builtin(e, "init", builtin_init);
     lenv_add_builtin(e, "len", builtin_len); 
+    lenv_add_builtin(e, "sort", builtin_sort);
 
     /* Mathematical Functions */
     lenv_add_builtin(e, "+", builtin_add);
@@ -959,6 +3388,94 @@ void lenv_add_builtins(lenv* e) {
     lenv_add_builtin(e, "min", builtin_min);
     lenv_add_builtin(e, "max", builtin_max);
 
+    /* Vector Functions */
+    lenv_add_builtin(e, "vec", builtin_vec);
+    lenv_add_builtin(e, "vec->list", builtin_vec_list);
+    lenv_add_builtin(e, "vec+", builtin_vec_add);
+    lenv_add_builtin(e, "vec*", builtin_vec_mul);
+    lenv_add_builtin(e, "vsum", builtin_vsum);
+    lenv_add_builtin(e, "vmin", builtin_vmin);
+    lenv_add_builtin(e, "vmax", builtin_vmax);
+    lenv_add_builtin(e, "dot", builtin_dot);
+    lenv_add_builtin(e, "set-threads", builtin_set_threads);
+
+    /* Statistics Functions */
+    lenv_add_builtin(e, "mean", builtin_mean);
+    lenv_add_builtin(e, "variance", builtin_variance);
+    lenv_add_builtin(e, "stddev", builtin_stddev);
+    lenv_add_builtin(e, "quantile", builtin_quantile);
+    lenv_add_builtin(e, "histogram", builtin_histogram);
+
+    /* Matrix Functions */
+    lenv_add_builtin(e, "mat", builtin_mat);
+    lenv_add_builtin(e, "mat->list", builtin_mat_list);
+    lenv_add_builtin(e, "mat-dims", builtin_mat_dims);
+    lenv_add_builtin(e, "mat-identity", builtin_mat_identity);
+    lenv_add_builtin(e, "matmul", builtin_matmul);
+    lenv_add_builtin(e, "transpose", builtin_transpose);
+    lenv_add_builtin(e, "mat+", builtin_mat_add);
+    lenv_add_builtin(e, "mat-", builtin_mat_sub);
+    lenv_add_builtin(e, "mat*", builtin_mat_mul);
+    lenv_add_builtin(e, "solve", builtin_solve);
+
+    /* Dictionary Functions */
+    lenv_add_builtin(e, "dict", builtin_dict);
+    lenv_add_builtin(e, "dict-get", builtin_dict_get);
+    lenv_add_builtin(e, "dict-has", builtin_dict_has);
+    lenv_add_builtin(e, "dict-put!", builtin_dict_put);
+    lenv_add_builtin(e, "dict-remove!", builtin_dict_remove);
+    lenv_add_builtin(e, "dict-keys", builtin_dict_keys);
+    lenv_add_builtin(e, "dict-vals", builtin_dict_vals);
+    lenv_add_builtin(e, "dict-merge", builtin_dict_merge);
+
+    /* Ordered Map Functions */
+    lenv_add_builtin(e, "omap", builtin_omap);
+    lenv_add_builtin(e, "omap-get", builtin_omap_get);
+    lenv_add_builtin(e, "omap-put!", builtin_omap_put);
+    lenv_add_builtin(e, "omap-remove!", builtin_omap_remove);
+    lenv_add_builtin(e, "omap-range", builtin_omap_range);
+    lenv_add_builtin(e, "omap-floor", builtin_omap_floor);
+    lenv_add_builtin(e, "omap-ceiling", builtin_omap_ceiling);
+    lenv_add_builtin(e, "omap-items", builtin_omap_items);
+    lenv_add_builtin(e, "omap-keys", builtin_omap_keys);
+    lenv_add_builtin(e, "omap-vals", builtin_omap_vals);
+
+    /* Array Functions */
+    lenv_add_builtin(e, "array", builtin_array);
+    lenv_add_builtin(e, "make-array", builtin_make_array);
+    lenv_add_builtin(e, "vec-get", builtin_vec_get);
+    lenv_add_builtin(e, "vec-set!", builtin_vec_set);
+    lenv_add_builtin(e, "vec-push!", builtin_vec_push);
+    lenv_add_builtin(e, "vec-pop!", builtin_vec_pop);
+    lenv_add_builtin(e, "freeze", builtin_freeze);
+
+    /* Bitset Functions */
+    lenv_add_builtin(e, "bits", builtin_bits);
+    lenv_add_builtin(e, "bits-set!", builtin_bits_set);
+    lenv_add_builtin(e, "bits-clear!", builtin_bits_clear);
+    lenv_add_builtin(e, "bits-test", builtin_bits_test);
+    lenv_add_builtin(e, "bits-and", builtin_bits_and);
+    lenv_add_builtin(e, "bits-or", builtin_bits_or);
+    lenv_add_builtin(e, "bits-xor", builtin_bits_xor);
+    lenv_add_builtin(e, "bits-andnot", builtin_bits_andnot);
+    lenv_add_builtin(e, "bits-count", builtin_bits_count);
+    lenv_add_builtin(e, "bits->list", builtin_bits_list);
+
+    /* Heap and Deque Functions */
+    lenv_add_builtin(e, "heap", builtin_heap);
+    lenv_add_builtin(e, "heap-push!", builtin_heap_push);
+    lenv_add_builtin(e, "heap-pop!", builtin_heap_pop);
+    lenv_add_builtin(e, "heap-peek", builtin_heap_peek);
+    lenv_add_builtin(e, "deque", builtin_deque);
+    lenv_add_builtin(e, "deque-push-front!", builtin_deque_push_front);
+    lenv_add_builtin(e, "deque-push-back!", builtin_deque_push_back);
+    lenv_add_builtin(e, "deque-pop-front!", builtin_deque_pop_front);
+    lenv_add_builtin(e, "deque-pop-back!", builtin_deque_pop_back);
+    lenv_add_builtin(e, "deque-front", builtin_deque_front);
+    lenv_add_builtin(e, "deque-back", builtin_deque_back);
+    lenv_add_builtin(e, "deque-get", builtin_deque_get);
+    lenv_add_builtin(e, "deque->list", builtin_deque_list);
+
     /* Conditional and Ordering Functions */
     lenv_add_builtin(e, "<", builtin_lessthan);
     lenv_add_builtin(e, ">", builtin_greaterthan);
@@ -988,6 +3505,7 @@ void lenv_add_builtins(lenv* e) {
 
 lval* lval_eval_sexpr(lenv* e, lval* v) {
     /* Evaluate each cell in the sexpr  */
+    v->hash = 0;
     for (int i = 0; i < v->count; i++) {
         v->cell[i] = lval_eval(e, v->cell[i]);
     }
@@ -3,6 +3,12 @@
 
 #include "lenv.h"
 #include "lval.h"
+#include "pool.h"
+#include "stats.h"
+#include "sort.h"
+#include "serial.h"
+#include "reader.h"
+#include "grammar.h"
 
 #define LASSERT(args, cond, fmt, ...) \
     if (!(cond)) { lval* err = lval_err(fmt, ##__VA_ARGS__); lval_del(args); return err; }
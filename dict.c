@@ -0,0 +1,134 @@
+#include "lval.h"
+
+#define DICT_MIN_CAPACITY 8
+
+ldict* ldict_new(void) {
+    ldict* d = malloc(sizeof(ldict));
+    d->refs = 1;
+    d->count = 0;
+    d->capacity = DICT_MIN_CAPACITY;
+    d->entries = calloc(d->capacity, sizeof(ldict_entry));
+    return d;
+}
+
+ldict* ldict_retain(ldict* d) {
+    d->refs++;
+    return d;
+}
+
+void ldict_release(ldict* d) {
+    if (--d->refs > 0) { return; }
+    for (long i = 0; i < d->capacity; i++) {
+        if (d->entries[i].key) {
+            lval_del(d->entries[i].key);
+            lval_del(d->entries[i].val);
+        }
+    }
+    free(d->entries);
+    free(d);
+}
+
+/* Returns a new dictionary with copies of every entry. Slots are the
+ * same so nothing needs rehashing. */
+ldict* ldict_copy(ldict* d) {
+    ldict* c = malloc(sizeof(ldict));
+    c->refs = 1;
+    c->count = d->count;
+    c->capacity = d->capacity;
+    c->entries = calloc(c->capacity, sizeof(ldict_entry));
+    for (long i = 0; i < d->capacity; i++) {
+        if (d->entries[i].key) {
+            c->entries[i].hash = d->entries[i].hash;
+            c->entries[i].key = lval_copy(d->entries[i].key);
+            c->entries[i].val = lval_copy(d->entries[i].val);
+        }
+    }
+    return c;
+}
+
+/* Index of the slot holding k, or of the empty slot where it belongs */
+static long ldict_find(ldict* d, lval* k, uint64_t h) {
+    long mask = d->capacity - 1;
+    long i = h & mask;
+    while (d->entries[i].key) {
+        if (d->entries[i].hash == h && lval_eq(d->entries[i].key, k)) {
+            return i;
+        }
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+/* Doubles the table, reinserting entries by their stored hash */
+static void ldict_grow(ldict* d) {
+    ldict_entry* old = d->entries;
+    long n = d->capacity;
+    d->capacity *= 2;
+    d->entries = calloc(d->capacity, sizeof(ldict_entry));
+
+    long mask = d->capacity - 1;
+    for (long i = 0; i < n; i++) {
+        if (!old[i].key) { continue; }
+        long j = old[i].hash & mask;
+        while (d->entries[j].key) { j = (j + 1) & mask; }
+        d->entries[j] = old[i];
+    }
+    free(old);
+}
+
+/* Returns the value for k without copying it, or NULL if k is missing */
+lval* ldict_get(ldict* d, lval* k) {
+    long i = ldict_find(d, k, lval_hash(k));
+    return d->entries[i].key ? d->entries[i].val : NULL;
+}
+
+/* Takes ownership of k and v, replacing any existing value for k */
+void ldict_put(ldict* d, lval* k, lval* v) {
+    uint64_t h = lval_hash(k);
+    long i = ldict_find(d, k, h);
+    if (d->entries[i].key) {
+        lval_del(d->entries[i].val);
+        d->entries[i].val = v;
+        lval_del(k);
+        return;
+    }
+
+    /* Keep the load factor at or below 3/4 */
+    if ((d->count + 1) * 4 > d->capacity * 3) {
+        ldict_grow(d);
+        i = ldict_find(d, k, h);
+    }
+    d->entries[i].hash = h;
+    d->entries[i].key = k;
+    d->entries[i].val = v;
+    d->count++;
+}
+
+/* Removes k, returning false if it was missing. Later entries in the
+ * probe run are shifted back into the hole, so no tombstones are left. */
+bool ldict_remove(ldict* d, lval* k) {
+    long i = ldict_find(d, k, lval_hash(k));
+    if (!d->entries[i].key) { return false; }
+    lval_del(d->entries[i].key);
+    lval_del(d->entries[i].val);
+    d->count--;
+
+    long mask = d->capacity - 1;
+    long j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        if (!d->entries[j].key) { break; }
+
+        /* An entry may move back unless its home slot lies
+         * cyclically between the hole and where it is now */
+        long home = d->entries[j].hash & mask;
+        bool stays = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+        if (!stays) {
+            d->entries[i] = d->entries[j];
+            i = j;
+        }
+    }
+    d->entries[i].key = NULL;
+    d->entries[i].val = NULL;
+    return true;
+}
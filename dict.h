@@ -0,0 +1,34 @@
+#ifndef dict_h
+#define dict_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct lval;
+
+/* Hash table from lvals to lvals with open addressing and linear probing.
+ * Keys are compared structurally with lval_eq and hashed with lval_hash.
+ * A dictionary is mutable and shared by every lval that refers to it. */
+
+typedef struct ldict_entry {
+    uint64_t hash;
+    struct lval* key;   /* NULL for an empty slot */
+    struct lval* val;
+} ldict_entry;
+
+typedef struct ldict {
+    int refs;
+    long count;
+    long capacity;      /* Always a power of two */
+    ldict_entry* entries;
+} ldict;
+
+ldict* ldict_new(void);
+ldict* ldict_retain(ldict* d);
+void ldict_release(ldict* d);
+ldict* ldict_copy(ldict* d);
+struct lval* ldict_get(ldict* d, struct lval* k);
+void ldict_put(ldict* d, struct lval* k, struct lval* v);
+bool ldict_remove(ldict* d, struct lval* k);
+
+#endif
@@ -0,0 +1,12 @@
+#include "grammar.h"
+
+const char* grammar_src =
+    "number  : /-?(([0-9]*[.])?[0-9]+([.][0-9]*)?)/ ;          \n"
+    "symbol  : /[a-zA-Z0-9_+\\-*\\/%^\\\\=<>!&|]+/ ;            \n"
+    "string  : /\"(\\\\.|[^\"])*\"/ ;                           \n"
+    "comment : /;.[^\\n\\r]*/ ;                                 \n"
+    "sexpr   : '(' <expr>* ')' ;                                \n"
+    "qexpr   : '{' <expr>* '}' ;                                \n"
+    "expr    : <number> | <symbol> | <string> |                 \n"
+    "          <comment> | <sexpr> | <qexpr> ;                  \n"
+    "lispy   : /^/ <expr>* /$/ ;                                \n";
@@ -0,0 +1,17 @@
+#ifndef grammar_h
+#define grammar_h
+
+#include "mpc.h"
+
+/* The lispy grammar in mpca_lang syntax. The build runs mkgrammar to
+ * turn it into grammar_table, so main can define the parsers from the
+ * tables instead of compiling this text on every start. */
+extern const char* grammar_src;
+extern const mpc_table_t grammar_table;
+
+/* Rule numbers mpca_lang gives the parsers, in the order main passes
+ * them. AST nodes carry these so lval_read can switch on them. */
+enum { RULE_NUMBER = 1, RULE_SYMBOL, RULE_STRING, RULE_COMMENT,
+       RULE_SEXPR, RULE_QEXPR, RULE_EXPR, RULE_LISPY };
+
+#endif
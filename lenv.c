@@ -42,7 +42,7 @@ lval* lenv_get(lenv* e, lval* k) {
         /* Check if the stored string matches the symbol string */
         /* If it does, return a copy of the value */
         if (strcmp(e->syms[i], k->data.sym) == 0) {
-            return lval_copy(e->vals[i]);
+            return lval_unpack(e->vals[i]);
         }
     }
     /* If no symbol found, search parent or return error */
@@ -81,7 +81,7 @@ void lenv_put(lenv* e, lval* k, lval* v) {
         /* And replace with variable supplied by user */
         if (strcmp(e->syms[i], k->data.sym) == 0) {
             lval_del(e->vals[i]);
-            e->vals[i] = lval_copy(v);
+            e->vals[i] = lval_pack(v);
             return;
         }
     }
@@ -91,8 +91,9 @@ void lenv_put(lenv* e, lval* k, lval* v) {
     e->vals = realloc(e->vals, sizeof(lval*) * e->count);
     e->syms = realloc(e->syms, sizeof(char*) * e->count);
     
-    /* Copy contents of lval and symbol string into new location */
-    e->vals[e->count-1] = lval_copy(v);
+    /* Copy contents of lval and symbol string into new location.
+     * Lists of numbers are stored unboxed. */
+    e->vals[e->count-1] = lval_pack(v);
     e->syms[e->count-1] = malloc(strlen(k->data.sym)+1);
     strcpy(e->syms[e->count-1], k->data.sym);
 }
@@ -34,16 +34,7 @@ void add_history(char* unused) {}
  ***************************************************************/
 
 lval* lval_read_num(mpc_ast_t* t) {
-    errno = 0;
-    if (strchr(t->contents, '.') != NULL) {
-        double d = strtof(t->contents, NULL);
-        return errno != ERANGE ? lval_dec(d) : lval_err("Invalid number.");
-    }
-    else {
-        long x = strtol(t->contents, NULL, 10);
-        return errno != ERANGE ? lval_int(x) : lval_err("Invalid Number.");
-    }
-    printf("\n");
+    return lval_read_number(t->contents, strlen(t->contents));
 }
 
 lval* lval_read_str(mpc_ast_t* t) {
@@ -62,26 +53,24 @@ lval* lval_read_str(mpc_ast_t* t) {
 }
 
 lval* lval_read(mpc_ast_t* t) {
-    if (strstr(t->tag, "number")) { return lval_read_num(t); }
-    if (strstr(t->tag, "symbol")) { 
-        if (strcmp(t->contents, "true") == 0) { return lval_bool(true); }
-        else if (strcmp(t->contents, "false") == 0) { return lval_bool(false); }
-        else { return lval_sym(t->contents); }
+    lval* x = NULL;
+    switch (t->rule) {
+        case RULE_NUMBER: return lval_read_num(t);
+        case RULE_SYMBOL:
+            if (strcmp(t->contents, "true") == 0) { return lval_bool(true); }
+            else if (strcmp(t->contents, "false") == 0) { return lval_bool(false); }
+            else { return lval_sym(t->contents); }
+        case RULE_STRING: return lval_read_str(t);
+        case RULE_SEXPR: x = lval_sexpr(); break;
+        case RULE_QEXPR: x = lval_qexpr(); break;
+        /* The root of the input belongs to no rule */
+        default: if (strcmp(t->tag, ">") == 0) { x = lval_sexpr(); }
     }
-    if (strstr(t->tag, "string")) { return lval_read_str(t); }
 
-    lval* x = NULL;
-    if (strcmp(t->tag, ">") == 0) { x = lval_sexpr(); } 
-    if (strstr(t->tag, "sexpr"))  { x = lval_sexpr(); }
-    if (strstr(t->tag, "qexpr"))  { x = lval_qexpr(); }
-    
     for (int i = 0; i < t->children_num; i++) {
-        if (strstr(t->children[i]->tag, "comment")) { continue; }
-        if (strcmp(t->children[i]->contents, "(") == 0) { continue; }
-        if (strcmp(t->children[i]->contents, ")") == 0) { continue; }
-        if (strcmp(t->children[i]->contents, "}") == 0) { continue; }
-        if (strcmp(t->children[i]->contents, "{") == 0) { continue; }
-        if (strcmp(t->children[i]->tag,  "regex") == 0) { continue; }
+        /* Brackets and the start and end of input belong to no rule */
+        int rule = t->children[i]->rule;
+        if (rule == 0 || rule == RULE_COMMENT) { continue; }
         x = lval_add(x, lval_read(t->children[i]));
     }
     
@@ -104,23 +93,23 @@ int main(int argc, char** argv) {
     Expr   = mpc_new("expr");
     Lispy  = mpc_new("lispy");
     
-    mpca_lang(MPCA_LANG_DEFAULT,
-        "                                                       \
-            number : /-?(([0-9]*[.])?[0-9]+([.][0-9]*)?)/ ;     \
-            symbol : /[a-zA-Z0-9_+\\-*\\/\%^\\\\=<>!&|]+/ ;     \
-            string : /\"(\\\\.|[^\"])*\"/ ;                     \
-            comment : /;.[^\\n\\r]*/ ;                          \
-            sexpr  : '(' <expr>* ')' ;                          \
-            qexpr  : '{' <expr>* '}' ;                          \
-            expr   : <number> | <symbol> | <string> |           \
-                     <comment> | <sexpr> | <qexpr> ;            \
-            lispy  : /^/ <expr>* /$/ ;                          \
-        ",
-        Number, Symbol, String, Comment, Sexpr, Qexpr, Expr, Lispy);
+    /* Parsers come from the tables built by mkgrammar, unless those
+     * are out of step with the rules above */
+    if (!mpc_load(&grammar_table, 8,
+            Number, Symbol, String, Comment, Sexpr, Qexpr, Expr, Lispy)) {
+        mpca_lang(MPCA_LANG_DEFAULT, grammar_src,
+            Number, Symbol, String, Comment, Sexpr, Qexpr, Expr, Lispy);
+    }
     
     puts("Lispy50 Version 0.9.2");
     puts("Press Ctrl+c or 'exit' to Exit\n");
     
+    /* Select SIMD kernels for vectors and bitsets, and size the thread
+     * pool for vector builtins */
+    vec_init();
+    bits_init();
+    pool_init();
+
     lenv* e = lenv_new();
     lenv_add_builtins(e);
 
@@ -138,18 +127,24 @@ int main(int argc, char** argv) {
             char* input = readline("lispy> ");
             add_history(input);
             
+            /* Read directly, falling back to mpc for error messages */
+            lval* expr = lval_read_src(input, strlen(input));
             mpc_result_t r;
-            if (mpc_parse("<stdin>", input, Lispy, &r)) {
-                lval* x = lval_eval(e, lval_read(r.output));
+            if (!expr && mpc_parse_with("<stdin>", input, Lispy, &r, MPC_PARSE_ARENA)) {
+                expr = lval_read(r.output);
+                mpc_ast_delete(r.output);
+            } else if (!expr) {
+                mpc_err_print(r.error);
+                mpc_err_delete(r.error);
+            }
+
+            if (expr) {
+                lval* x = lval_eval(e, expr);
                 lval_println(x);
                 if (x->type == LVAL_FUN && x->builtin == builtin_exit) {
                     quit = true;
                 }
                 lval_del(x);
-                mpc_ast_delete(r.output);
-            } else {    
-                mpc_err_print(r.error);
-                mpc_err_delete(r.error);
             }
             
             free(input);
@@ -8,6 +8,20 @@ lval* lval_int(long x) {
     return v;
 }
 
+/* Takes ownership of a bignum. Values that fit in a long are
+ * demoted to a plain integer so the fast path is used again */
+lval* lval_big(bignum* x) {
+    if (bignum_fits_long(x)) {
+        lval* v = lval_int(bignum_to_long(x));
+        bignum_del(x);
+        return v;
+    }
+    lval* v = malloc(sizeof(lval));
+    v->type = LVAL_BIG;
+    v->data.big = x;
+    return v;
+}
+
 lval* lval_dec(double x) {
     lval* v = malloc(sizeof(lval));
     v->type = LVAL_DEC;
@@ -15,6 +29,78 @@ lval* lval_dec(double x) {
     return v;
 }
 
+/* Takes ownership of a reference to the vector */
+lval* lval_vec(lvec* x) {
+    lval* v = malloc(sizeof(lval));
+    v->type = LVAL_VEC;
+    v->data.vec = x;
+    return v;
+}
+
+/* Takes ownership of a reference to the matrix */
+lval* lval_mat(lmat* x) {
+    lval* v = malloc(sizeof(lval));
+    v->type = LVAL_MAT;
+    v->data.mat = x;
+    return v;
+}
+
+/* Takes ownership of a reference to the dictionary */
+lval* lval_dict(ldict* x) {
+    lval* v = malloc(sizeof(lval));
+    v->type = LVAL_DICT;
+    v->data.dict = x;
+    return v;
+}
+
+/* Takes ownership of a reference to the ordered map */
+lval* lval_omap(lomap* x) {
+    lval* v = malloc(sizeof(lval));
+    v->type = LVAL_OMAP;
+    v->data.omap = x;
+    return v;
+}
+
+/* Takes ownership of a reference to the heap */
+lval* lval_heap(lheap* x) {
+    lval* v = malloc(sizeof(lval));
+    v->type = LVAL_HEAP;
+    v->data.heap = x;
+    return v;
+}
+
+/* Takes ownership of a reference to the deque */
+lval* lval_deque(ldeque* x) {
+    lval* v = malloc(sizeof(lval));
+    v->type = LVAL_DEQUE;
+    v->data.deque = x;
+    return v;
+}
+
+/* Takes ownership of a reference to the record */
+lval* lval_record(lrecord* x) {
+    lval* v = malloc(sizeof(lval));
+    v->type = LVAL_RECORD;
+    v->data.record = x;
+    return v;
+}
+
+/* Takes ownership of a reference to the bitset */
+lval* lval_bits(lbits* x) {
+    lval* v = malloc(sizeof(lval));
+    v->type = LVAL_BITS;
+    v->data.bits = x;
+    return v;
+}
+
+/* Takes ownership of a reference to the array */
+lval* lval_array(larray* x) {
+    lval* v = malloc(sizeof(lval));
+    v->type = LVAL_ARRAY;
+    v->data.array = x;
+    return v;
+}
+
 lval* lval_bool(bool boolean) {
     lval* b = malloc(sizeof(lval));
     b->type = LVAL_BOOL;
@@ -27,6 +113,7 @@ lval* lval_str(char* s) {
     v->type = LVAL_STR;
     v->data.str = malloc(strlen(s) + 1);
     strcpy(v->data.str, s);
+    v->hash = 0;
     return v;
 }
 
@@ -65,6 +152,23 @@ lval* lval_fun(lbuiltin func) {
     lval* v = malloc(sizeof(lval));
     v->type = LVAL_FUN;
     v->builtin = func;
+    v->data.field.shape = NULL;
+    v->data.field.memo = NULL;
+    return v;
+}
+
+/* A builtin that belongs to a record type, taking a reference to shape */
+lval* lval_record_fun(lbuiltin func, lshape* shape, int index) {
+    lval* v = lval_fun(func);
+    v->data.field.shape = lshape_retain(shape);
+    v->data.field.index = index;
+    return v;
+}
+
+/* A builtin that calls through a memo table, taking a reference to it */
+lval* lval_memo_fun(lbuiltin func, lmemo* memo) {
+    lval* v = lval_fun(func);
+    v->data.field.memo = memo;
     return v;
 }
 
@@ -83,6 +187,7 @@ lval* lval_sexpr(void) {
     v->type = LVAL_SEXPR;
     v->count = 0;
     v->cell = NULL;
+    v->hash = 0;
     return v;
 }
 
@@ -91,6 +196,7 @@ lval* lval_qexpr(void) {
     v->type = LVAL_QEXPR;
     v->count = 0;
     v->cell = NULL;
+    v->hash = 0;
     return v;
 }
 
@@ -99,9 +205,26 @@ lval* lval_qexpr(void) {
 void lval_del(lval* v) {
     switch (v->type) {
         case LVAL_INT: break;
+        case LVAL_BIG: bignum_del(v->data.big); break;
         case LVAL_DEC: break;
         case LVAL_BOOL: break;
+        case LVAL_VEC: lvec_release(v->data.vec); break;
+        case LVAL_MAT: lmat_release(v->data.mat); break;
+        case LVAL_DICT: ldict_release(v->data.dict); break;
+        case LVAL_OMAP: lomap_release(v->data.omap); break;
+        case LVAL_HEAP: lheap_release(v->data.heap); break;
+        case LVAL_DEQUE: ldeque_release(v->data.deque); break;
+        case LVAL_ARRAY: larray_release(v->data.array); break;
+        case LVAL_RECORD: lrecord_release(v->data.record); break;
+        case LVAL_BITS: lbits_release(v->data.bits); break;
+        case LVAL_PACKED: lvec_release(v->data.vec); break;
         case LVAL_FUN: 
+            if (v->builtin && v->data.field.shape) {
+                lshape_release(v->data.field.shape);
+            }
+            if (v->builtin && v->data.field.memo) {
+                lmemo_release(v->data.field.memo);
+            }
             if (!v->builtin) {
                 lval_del(v->formals);
                 lval_del(v->body);
@@ -133,10 +256,26 @@ lval* lval_copy(lval* v) {
         /* Copy Numbers and Bools Directly */
         case LVAL_DEC: x->data.decimal = v->data.decimal; break;
         case LVAL_INT: x->data.integer = v->data.integer; break;
+        case LVAL_BIG: x->data.big = bignum_copy(v->data.big); break;
         case LVAL_BOOL: x->data.boolean = v->data.boolean; break; 
+        /* Vectors share their elements */
+        case LVAL_VEC: x->data.vec = lvec_retain(v->data.vec); break;
+        case LVAL_MAT: x->data.mat = lmat_retain(v->data.mat); break;
+        case LVAL_PACKED: x->data.vec = lvec_retain(v->data.vec); break;
+        /* Dictionaries are mutable, so copies refer to the same one */
+        case LVAL_DICT: x->data.dict = ldict_retain(v->data.dict); break;
+        case LVAL_OMAP: x->data.omap = lomap_retain(v->data.omap); break;
+        case LVAL_HEAP: x->data.heap = lheap_retain(v->data.heap); break;
+        case LVAL_DEQUE: x->data.deque = ldeque_retain(v->data.deque); break;
+        case LVAL_ARRAY: x->data.array = larray_retain(v->data.array); break;
+        case LVAL_RECORD: x->data.record = lrecord_retain(v->data.record); break;
+        case LVAL_BITS: x->data.bits = lbits_retain(v->data.bits); break;
         case LVAL_FUN: 
             if (v->builtin) {
                 x->builtin = v->builtin;
+                x->data.field = v->data.field;
+                if (x->data.field.shape) { lshape_retain(x->data.field.shape); }
+                if (x->data.field.memo) { lmemo_retain(x->data.field.memo); }
             }
             else {
                 x->builtin = NULL;
@@ -151,7 +290,8 @@ lval* lval_copy(lval* v) {
             strcpy(x->data.err, v->data.err); break;
         case LVAL_STR:
             x->data.str = malloc(strlen(v->data.str) + 1);
-            strcpy(x->data.str, v->data.str); break;
+            strcpy(x->data.str, v->data.str);
+            x->hash = v->hash; break;
         case LVAL_SYM:
             x->data.sym = malloc(strlen(v->data.sym) + 1);
             strcpy(x->data.sym, v->data.sym); break;
@@ -160,6 +300,7 @@ lval* lval_copy(lval* v) {
         case LVAL_SEXPR:
         case LVAL_QEXPR:
             x->count = v->count;
+            x->hash = v->hash;
             x->cell = malloc(sizeof(lval*) * x->count);
             for (int i = 0; i < x->count; i++) {
                 x->cell[i] = lval_copy(v->cell[i]);
@@ -169,8 +310,51 @@ lval* lval_copy(lval* v) {
     return x;
 }
 
+/* Lists shorter than this are cheaper to keep boxed */
+#define PACK_MIN 8
+
+/* Copy of v for an environment to hold. A Q-Expr of all integers or all
+ * decimals is stored as one unboxed array, so it takes 8 bytes a number
+ * and copying the environment shares it instead of copying every cell. */
+lval* lval_pack(lval* v) {
+    if (v->type != LVAL_QEXPR || v->count < PACK_MIN) { return lval_copy(v); }
+    int t = v->cell[0]->type;
+    if (t != LVAL_INT && t != LVAL_DEC) { return lval_copy(v); }
+    for (int i = 1; i < v->count; i++) {
+        if (v->cell[i]->type != t) { return lval_copy(v); }
+    }
+
+    lvec* x = lvec_new(t == LVAL_INT ? LVEC_INT : LVEC_DEC, v->count);
+    for (int i = 0; i < v->count; i++) {
+        if (t == LVAL_INT) {
+            x->items.ints[i] = v->cell[i]->data.integer;
+        } else {
+            x->items.decs[i] = v->cell[i]->data.decimal;
+        }
+    }
+    lval* p = malloc(sizeof(lval));
+    p->type = LVAL_PACKED;
+    p->data.vec = x;
+    return p;
+}
+
+/* Copy of a value held by an environment, boxing a packed list again */
+lval* lval_unpack(lval* v) {
+    if (v->type != LVAL_PACKED) { return lval_copy(v); }
+    lvec* x = v->data.vec;
+    lval* q = lval_qexpr();
+    q->count = x->count;
+    q->cell = malloc(sizeof(lval*) * x->count);
+    for (long i = 0; i < x->count; i++) {
+        q->cell[i] = x->kind == LVEC_INT ?
+            lval_int(x->items.ints[i]) : lval_dec(x->items.decs[i]);
+    }
+    return q;
+}
+
 /* Adds an element (x) to lval v */
 lval* lval_add(lval* v, lval* x) {
+    v->hash = 0;
     v->count++;
     v->cell = realloc(v->cell, sizeof(lval*) * v->count);
     v->cell[v->count-1] = x;
@@ -190,6 +374,7 @@ lval* lval_join(lval* x, lval* y) {
 /* Pops and returns the ith element of an lval */
 lval* lval_pop(lval* v, int i) {
     lval* x = v->cell[i];  
+    v->hash = 0;
     memmove(&v->cell[i], &v->cell[i+1],
         sizeof(lval*) * (v->count-i-1));  
     v->count--;  
@@ -204,6 +389,183 @@ lval* lval_take(lval* v, int i) {
     return x;
 }
 
+/* Structural hashing, consistent with lval_eq */
+
+/* Final mixing step of splitmix64 */
+static uint64_t hash_mix(uint64_t x) {
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/* FNV-1a */
+static uint64_t hash_bytes(const void* p, size_t n, uint64_t h) {
+    const unsigned char* b = p;
+    h ^= 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < n; i++) {
+        h ^= b[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/* Decimals by value, so that 0.0 and -0.0 hash the same */
+static uint64_t hash_decs(const double* d, long n, uint64_t h) {
+    for (long i = 0; i < n; i++) {
+        double x = d[i] == 0 ? 0 : d[i];
+        h = hash_bytes(&x, sizeof(x), h);
+    }
+    return hash_mix(h);
+}
+
+static uint64_t hash_str(const char* s, uint64_t seed) {
+    return hash_mix(hash_bytes(s, strlen(s), seed));
+}
+
+void* lval_shared(lval* v) {
+    switch (v->type) {
+        case LVAL_DICT:  return v->data.dict;
+        case LVAL_OMAP:  return v->data.omap;
+        case LVAL_HEAP:  return v->data.heap;
+        case LVAL_DEQUE: return v->data.deque;
+        case LVAL_ARRAY: return v->data.array;
+        default: return NULL;
+    }
+}
+
+/* Whether the pair x, y is already on the chain w */
+bool lval_walking(lval_walk* w, void* x, void* y) {
+    for (; w; w = w->up) {
+        if (w->x == x && w->y == y) { return true; }
+    }
+    return false;
+}
+
+/* Containers inside a value hash by type and size alone. Equal values
+ * still hash alike, and a container holding itself is never followed. */
+static uint64_t hash_elem(lval* v) {
+    long n;
+    switch (v->type) {
+        case LVAL_DICT:  n = v->data.dict->count; break;
+        case LVAL_OMAP:  n = v->data.omap->count; break;
+        case LVAL_HEAP:  n = v->data.heap->count; break;
+        case LVAL_DEQUE: n = v->data.deque->count; break;
+        case LVAL_ARRAY: n = v->data.array->count; break;
+        default: return lval_hash(v);
+    }
+    return hash_mix((uint64_t) v->type * 31 + (uint64_t) n);
+}
+
+/* Folds an ordered map entry into a running hash */
+static bool hash_entry(lval* k, lval* v, void* arg) {
+    uint64_t* h = arg;
+    *h = hash_mix(*h * 31 + hash_elem(k)) ^ hash_elem(v);
+    return true;
+}
+
+uint64_t lval_hash(lval* v) {
+    /* Strings and lists keep their hash until they change. The list
+     * hash ignores the S/Q distinction, since lists switch between the
+     * two in place. */
+    if (v->type == LVAL_STR || v->type == LVAL_SEXPR || v->type == LVAL_QEXPR) {
+        if (v->hash) { return v->hash; }
+        uint64_t h;
+        if (v->type == LVAL_STR) {
+            h = hash_str(v->data.str, LVAL_STR);
+        } else {
+            h = hash_mix(LVAL_QEXPR + v->count);
+            for (int i = 0; i < v->count; i++) {
+                h = hash_mix(h * 31 + hash_elem(v->cell[i]));
+            }
+        }
+        v->hash = h ? h : 1;
+        return v->hash;
+    }
+
+    uint64_t h = v->type;
+    switch (v->type) {
+        case LVAL_INT: return hash_mix(h ^ (uint64_t) v->data.integer);
+        case LVAL_BOOL: return hash_mix(h ^ v->data.boolean);
+        case LVAL_DEC: return hash_decs(&v->data.decimal, 1, h);
+        case LVAL_BIG:
+            h = hash_bytes(v->data.big->limbs,
+                sizeof(uint32_t) * v->data.big->count, h);
+            return hash_mix(h ^ (uint64_t) v->data.big->sign);
+        case LVAL_ERR: return hash_str(v->data.err, h);
+        case LVAL_SYM: return hash_str(v->data.sym, h);
+        case LVAL_VEC: {
+            lvec* x = v->data.vec;
+            h = hash_mix(h + x->kind);
+            if (x->kind == LVEC_DEC) { return hash_decs(x->items.decs, x->count, h); }
+            return hash_mix(hash_bytes(x->items.ints, sizeof(int64_t) * x->count, h));
+        }
+        case LVAL_MAT: {
+            lmat* m = v->data.mat;
+            h = hash_mix(h + m->rows * 31 + m->cols);
+            return hash_decs(m->items, m->rows * m->cols, h);
+        }
+        case LVAL_FUN:
+            if (v->builtin) {
+                h ^= (uint64_t) (uintptr_t) v->data.field.shape;
+                h ^= hash_mix((uint64_t) (uintptr_t) v->data.field.memo);
+                return hash_mix(h ^ (uint64_t) (uintptr_t) v->builtin);
+            }
+            return hash_mix(lval_hash(v->formals) * 31 + lval_hash(v->body));
+        case LVAL_DICT: {
+            /* Sum over entries, so the order of slots does not matter */
+            ldict* d = v->data.dict;
+            for (long i = 0; i < d->capacity; i++) {
+                if (d->entries[i].key) {
+                    h += hash_mix(d->entries[i].hash ^ hash_elem(d->entries[i].val));
+                }
+            }
+            return hash_mix(h);
+        }
+        case LVAL_OMAP:
+            lomap_range(v->data.omap, NULL, NULL, hash_entry, &h);
+            return hash_mix(h);
+        /* Sum over entries, as equal heaps can lay them out differently */
+        case LVAL_HEAP: {
+            lheap* q = v->data.heap;
+            for (long i = 0; i < q->count; i++) {
+                h += hash_mix(hash_elem(q->items[i].prio) * 31 ^ hash_elem(q->items[i].val));
+            }
+            return hash_mix(h);
+        }
+        case LVAL_DEQUE: {
+            ldeque* d = v->data.deque;
+            h = hash_mix(h + d->count);
+            for (long i = 0; i < d->count; i++) {
+                h = hash_mix(h * 31 + hash_elem(ldeque_get(d, i)));
+            }
+            return h;
+        }
+        case LVAL_RECORD: {
+            lrecord* r = v->data.record;
+            h = hash_mix(h ^ (uint64_t) (uintptr_t) r->shape);
+            for (int i = 0; i < r->shape->count; i++) {
+                h = hash_mix(h * 31 + hash_elem(r->fields[i]));
+            }
+            return h;
+        }
+        /* Trailing zero words are spare capacity, not part of the value */
+        case LVAL_BITS: {
+            lbits* b = v->data.bits;
+            return hash_mix(hash_bytes(b->words, sizeof(uint64_t) * lbits_used(b), h));
+        }
+        case LVAL_ARRAY: {
+            larray* a = v->data.array;
+            h = hash_mix(h + a->count);
+            for (long i = 0; i < a->count; i++) {
+                h = hash_mix(h * 31 + hash_elem(a->items[i]));
+            }
+            return h;
+        }
+        default: return h;
+    }
+}
+
 /* Prints an expression */
 void lval_print_expr(lval* v, char open, char close) {
     putchar(open);
@@ -227,8 +589,160 @@ void lval_print_str(lval* v) {
     free(escaped);
 }
 
-/* Prints an lval */
+void lval_print_vec(lval* v) {
+    lvec* x = v->data.vec;
+    putchar('[');
+    for (long i = 0; i < x->count; i++) {
+        if (x->kind == LVEC_INT) { printf("%li", (long) x->items.ints[i]); }
+        else { printf("%f", x->items.decs[i]); }
+        if (i != (x->count-1)) {
+            putchar(' ');
+        }
+    }
+    putchar(']');
+}
+
+void lval_print_mat(lval* v) {
+    lmat* m = v->data.mat;
+    putchar('[');
+    for (long i = 0; i < m->rows; i++) {
+        putchar('[');
+        for (long j = 0; j < m->cols; j++) {
+            printf("%f", m->items[i * m->cols + j]);
+            if (j != (m->cols-1)) {
+                putchar(' ');
+            }
+        }
+        putchar(']');
+        if (i != (m->rows-1)) {
+            putchar(' ');
+        }
+    }
+    putchar(']');
+}
+
+/* Prints entries in slot order */
+void lval_print_dict(lval* v) {
+    ldict* d = v->data.dict;
+    long printed = 0;
+    printf("#{");
+    for (long i = 0; i < d->capacity; i++) {
+        if (!d->entries[i].key) { continue; }
+        lval_print(d->entries[i].key);
+        putchar(' ');
+        lval_print(d->entries[i].val);
+        if (++printed != d->count) {
+            printf(", ");
+        }
+    }
+    putchar('}');
+}
+
+static bool print_entry(lval* k, lval* v, void* arg) {
+    bool* first = arg;
+    if (!*first) { printf(", "); }
+    *first = false;
+    lval_print(k);
+    putchar(' ');
+    lval_print(v);
+    return true;
+}
+
+/* Prints entries in key order */
+void lval_print_omap(lval* v) {
+    bool first = true;
+    printf("#[");
+    lomap_range(v->data.omap, NULL, NULL, print_entry, &first);
+    putchar(']');
+}
+
+/* Prints {priority value} entries in heap order, least first */
+void lval_print_heap(lval* v) {
+    lheap* h = v->data.heap;
+    printf("#heap<");
+    for (long i = 0; i < h->count; i++) {
+        putchar('{');
+        lval_print(h->items[i].prio);
+        putchar(' ');
+        lval_print(h->items[i].val);
+        putchar('}');
+        if (i != (h->count-1)) {
+            putchar(' ');
+        }
+    }
+    putchar('>');
+}
+
+void lval_print_deque(lval* v) {
+    ldeque* d = v->data.deque;
+    printf("#<");
+    for (long i = 0; i < d->count; i++) {
+        lval_print(ldeque_get(d, i));
+        if (i != (d->count-1)) {
+            putchar(' ');
+        }
+    }
+    putchar('>');
+}
+
+void lval_print_array(lval* v) {
+    larray* a = v->data.array;
+    printf("#array{");
+    for (long i = 0; i < a->count; i++) {
+        lval_print(a->items[i]);
+        if (i != (a->count-1)) {
+            putchar(' ');
+        }
+    }
+    putchar('}');
+}
+
+void lval_print_bits(lval* v) {
+    lbits* b = v->data.bits;
+    bool first = true;
+    printf("#bits{");
+    for (long i = 0; i < b->nwords; i++) {
+        for (uint64_t w = b->words[i]; w; w &= w - 1) {
+            printf(first ? "%li" : " %li", i * 64 + __builtin_ctzll(w));
+            first = false;
+        }
+    }
+    putchar('}');
+}
+
+void lval_print_record(lval* v) {
+    lrecord* r = v->data.record;
+    printf("#%s{", r->shape->name);
+    for (int i = 0; i < r->shape->count; i++) {
+        printf("%s ", r->shape->fields[i]);
+        lval_print(r->fields[i]);
+        if (i != (r->shape->count-1)) {
+            printf(", ");
+        }
+    }
+    putchar('}');
+}
+
+void lval_print_big(lval* v) {
+    char* digits = bignum_to_str(v->data.big);
+    printf("%s", digits);
+    free(digits);
+}
+
+/* Containers being printed, innermost first */
+static lval_walk* printing;
+
+/* Prints an lval. A container met again inside itself prints as ... */
 void lval_print(lval* v) {
+    lval_walk w = { lval_shared(v), NULL, printing };
+    if (w.x) {
+        if (lval_walking(printing, w.x, NULL)) {
+            printf("...");
+            return;
+        }
+        printing = &w;
+    }
+
     switch (v->type) {
         case LVAL_FUN:   
             if (v->builtin) {
@@ -243,6 +757,7 @@ void lval_print(lval* v) {
             }
             break;
         case LVAL_INT:   printf("%li", v->data.integer); break;
+        case LVAL_BIG:   lval_print_big(v); break;
         case LVAL_DEC:   printf("%f", v->data.decimal); break;
         case LVAL_BOOL:  printf("%s", v->data.boolean ? "true" : "false"); break;
         case LVAL_ERR:   printf("Error: %s", v->data.err); break;
@@ -250,7 +765,18 @@ void lval_print(lval* v) {
         case LVAL_STR:   lval_print_str(v); break;
         case LVAL_SEXPR: lval_print_expr(v, '(', ')'); break;
         case LVAL_QEXPR: lval_print_expr(v, '{', '}'); break;
+        case LVAL_VEC:   lval_print_vec(v); break;
+        case LVAL_MAT:   lval_print_mat(v); break;
+        case LVAL_DICT:  lval_print_dict(v); break;
+        case LVAL_OMAP:  lval_print_omap(v); break;
+        case LVAL_HEAP:  lval_print_heap(v); break;
+        case LVAL_DEQUE: lval_print_deque(v); break;
+        case LVAL_ARRAY: lval_print_array(v); break;
+        case LVAL_RECORD: lval_print_record(v); break;
+        case LVAL_BITS:  lval_print_bits(v); break;
     }
+
+    if (w.x) { printing = w.up; }
 }
 
 void lval_println(lval* v) {
@@ -264,6 +790,7 @@ char* ltype_name(int t) {
     switch(t) {
         case LVAL_FUN: return "Function";
         case LVAL_INT: return "Number";
+        case LVAL_BIG: return "Big Number";
         case LVAL_BOOL: return "Boolean";
         case LVAL_DEC: return "Decimal";
         case LVAL_ERR: return "Error";
@@ -271,6 +798,15 @@ char* ltype_name(int t) {
         case LVAL_STR: return "String";
         case LVAL_SEXPR: return "S-Expression";
         case LVAL_QEXPR: return "Q-Expression";
+        case LVAL_VEC: return "Vector";
+        case LVAL_MAT: return "Matrix";
+        case LVAL_DICT: return "Dictionary";
+        case LVAL_OMAP: return "Ordered Map";
+        case LVAL_HEAP: return "Heap";
+        case LVAL_DEQUE: return "Deque";
+        case LVAL_ARRAY: return "Array";
+        case LVAL_RECORD: return "Record";
+        case LVAL_BITS: return "Bitset";
         default: return "Unknown";
     }
 }
@@ -5,8 +5,19 @@
 #include <string.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include "mpc.h"
+#include "bignum.h"
+#include "vec.h"
+#include "matrix.h"
+#include "dict.h"
+#include "omap.h"
+#include "queue.h"
+#include "array.h"
+#include "record.h"
+#include "bits.h"
+#include "memo.h"
 
 struct lval;
 struct lenv;
@@ -16,8 +27,12 @@ typedef lval*(*lbuiltin)(lenv*, lval*);
 
 /* Lisp Value */
 
-enum { LVAL_ERR, LVAL_INT, LVAL_DEC, LVAL_BOOL, LVAL_STR,
-        LVAL_SYM, LVAL_FUN, LVAL_SEXPR, LVAL_QEXPR };
+/* LVAL_PACKED is a Q-Expr of numbers of one type stored unboxed. Only
+ * environments hold it, lookups turn it back into a Q-Expr. */
+enum { LVAL_ERR, LVAL_INT, LVAL_BIG, LVAL_DEC, LVAL_BOOL, LVAL_STR,
+        LVAL_SYM, LVAL_FUN, LVAL_SEXPR, LVAL_QEXPR, LVAL_VEC,
+        LVAL_MAT, LVAL_DICT, LVAL_OMAP, LVAL_HEAP, LVAL_DEQUE, LVAL_ARRAY,
+        LVAL_RECORD, LVAL_BITS, LVAL_PACKED };
 
 
 struct lval {
@@ -26,11 +41,25 @@ struct lval {
     /* Number, Symbol, and Error data */
     union {
         long integer;
+        bignum* big;
         double decimal;
         bool boolean;
         char* str;
         char* sym;
         char* err;
+        lvec* vec;
+        lmat* mat;
+        ldict* dict;
+        lomap* omap;
+        lheap* heap;
+        ldeque* deque;
+        larray* array;
+        lrecord* record;
+        lbits* bits;
+
+        /* Builtins made by defrecord or memo, shape and memo are NULL
+         * for other builtins. index is the field for an accessor. */
+        struct { lshape* shape; int index; lmemo* memo; } field;
     } data;
 
     /* Functions */
@@ -42,6 +71,10 @@ struct lval {
     /* Expressions */
     int count;
     lval** cell;
+
+    /* Cached lval_hash of a string or list, 0 until computed.
+     * Anything that changes the value must reset it. */
+    uint64_t hash;
 };
 
 lenv* lenv_new();
@@ -54,7 +87,19 @@ char* ltype_name(int t);
 lval* lval_str(char* s);
 lval* lval_sym(char* s);
 lval* lval_int(long x);
+lval* lval_big(bignum* x);
 lval* lval_dec(double x);
+lval* lval_vec(lvec* x);
+lval* lval_mat(lmat* x);
+lval* lval_dict(ldict* x);
+lval* lval_omap(lomap* x);
+lval* lval_heap(lheap* x);
+lval* lval_deque(ldeque* x);
+lval* lval_array(larray* x);
+lval* lval_record(lrecord* x);
+lval* lval_bits(lbits* x);
+lval* lval_record_fun(lbuiltin func, lshape* shape, int index);
+lval* lval_memo_fun(lbuiltin func, lmemo* memo);
 lval* lval_bool(bool boolean);
 lval* lval_qexpr(void);
 lval* lval_sexpr(void);
@@ -63,8 +108,26 @@ lval* lval_lambda(lval* formals, lval* body);
 lval* lval_pop(lval* v, int i);
 lval* lval_take(lval* v, int i);
 lval* lval_copy(lval* v);
+lval* lval_pack(lval* v);
+lval* lval_unpack(lval* v);
 lval* lval_add(lval* v, lval* x);
 lval* lval_join(lval* x, lval* y);
+/* Dicts, ordered maps, heaps, deques and arrays are shared and mutable,
+ * so they can come to hold themselves. Printing and comparing keep a
+ * chain of the containers they are inside, on the C stack, and stop on
+ * meeting one again. lval_shared gives the container of v, or NULL. */
+typedef struct lval_walk {
+    void* x;
+    void* y;
+    struct lval_walk* up;
+} lval_walk;
+
+void* lval_shared(lval* v);
+bool lval_walking(lval_walk* w, void* x, void* y);
+
+bool lval_eq(lval* x, lval* y);
+int lval_cmp(lval* x, lval* y);
+uint64_t lval_hash(lval* v);
 void lval_print(lval* v);
 void lval_println(lval* v);
 
@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "matrix.h"
+#include "vec.h"
+
+/* Block sizes for multiplication. A KB x NB panel of B (256KB) stays in
+ * L2 while MB rows of A stream past it, and each axpy works on an NB
+ * element row segment of C that stays in L1. */
+#define MAT_MB 64
+#define MAT_KB 128
+#define MAT_NB 256
+
+/* Tile size for transposition, 32 x 32 doubles per tile */
+#define MAT_TB 32
+
+lmat* lmat_new(long rows, long cols) {
+    long n;
+    if (rows < 0 || cols < 0 || __builtin_mul_overflow(rows, cols, &n) || n > MAT_MAX) {
+        return NULL;
+    }
+    lmat* m = malloc(sizeof(lmat));
+    if (!m) { return NULL; }
+    m->items = calloc(n > 0 ? n : 1, sizeof(double));
+    if (!m->items) {
+        free(m);
+        return NULL;
+    }
+    m->refs = 1;
+    m->rows = rows;
+    m->cols = cols;
+    return m;
+}
+
+lmat* lmat_retain(lmat* m) {
+    m->refs++;
+    return m;
+}
+
+void lmat_release(lmat* m) {
+    if (--m->refs > 0) { return; }
+    free(m->items);
+    free(m);
+}
+
+static long min_l(long a, long b) {
+    return a < b ? a : b;
+}
+
+/* c (n x m) = a (n x k) * b (k x m), c must be zeroed.
+ * Loops are blocked for cache reuse and the innermost loop is a
+ * vectorized axpy over a row segment of c. */
+void mat_mul(double* c, const double* a, const double* b,
+        long n, long k, long m) {
+    for (long jj = 0; jj < m; jj += MAT_NB) {
+        long nb = min_l(MAT_NB, m - jj);
+        for (long kk = 0; kk < k; kk += MAT_KB) {
+            long ke = min_l(kk + MAT_KB, k);
+            for (long ii = 0; ii < n; ii += MAT_MB) {
+                long ie = min_l(ii + MAT_MB, n);
+                for (long i = ii; i < ie; i++) {
+                    double* crow = c + i * m + jj;
+                    for (long p = kk; p < ke; p++) {
+                        vec_axpy_d(crow, a[i * k + p], b + p * m + jj, nb);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* t (cols x rows) = transpose of a (rows x cols), tile by tile */
+void mat_transpose(double* t, const double* a, long rows, long cols) {
+    for (long ii = 0; ii < rows; ii += MAT_TB) {
+        long ie = min_l(ii + MAT_TB, rows);
+        for (long jj = 0; jj < cols; jj += MAT_TB) {
+            long je = min_l(jj + MAT_TB, cols);
+            for (long i = ii; i < ie; i++) {
+                for (long j = jj; j < je; j++) {
+                    t[j * rows + i] = a[i * cols + j];
+                }
+            }
+        }
+    }
+}
+
+/* Solves a x = b in place by LU decomposition with partial pivoting.
+ * a is n x n and is destroyed, b is n x m and is replaced by x.
+ * Returns false if a is singular. */
+bool mat_solve(double* a, double* b, long n, long m) {
+    double* tmp = malloc(sizeof(double) * (n > m ? n : m));
+
+    for (long col = 0; col < n; col++) {
+        /* Pick the largest pivot in this column */
+        long piv = col;
+        for (long i = col + 1; i < n; i++) {
+            if (fabs(a[i * n + col]) > fabs(a[piv * n + col])) { piv = i; }
+        }
+        if (a[piv * n + col] == 0) {
+            free(tmp);
+            return false;
+        }
+        if (piv != col) {
+            memcpy(tmp, a + piv * n, sizeof(double) * n);
+            memcpy(a + piv * n, a + col * n, sizeof(double) * n);
+            memcpy(a + col * n, tmp, sizeof(double) * n);
+            memcpy(tmp, b + piv * m, sizeof(double) * m);
+            memcpy(b + piv * m, b + col * m, sizeof(double) * m);
+            memcpy(b + col * m, tmp, sizeof(double) * m);
+        }
+
+        /* Eliminate below the pivot, row operations are axpys */
+        for (long i = col + 1; i < n; i++) {
+            double f = -a[i * n + col] / a[col * n + col];
+            if (f == 0) { continue; }
+            vec_axpy_d(a + i * n + col, f, a + col * n + col, n - col);
+            vec_axpy_d(b + i * m, f, b + col * m, m);
+        }
+    }
+
+    /* Back substitution */
+    for (long i = n - 1; i >= 0; i--) {
+        for (long j = i + 1; j < n; j++) {
+            vec_axpy_d(b + i * m, -a[i * n + j], b + j * m, m);
+        }
+        double d = a[i * n + i];
+        for (long j = 0; j < m; j++) { b[i * m + j] /= d; }
+    }
+
+    free(tmp);
+    return true;
+}
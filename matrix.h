@@ -0,0 +1,29 @@
+#ifndef matrix_h
+#define matrix_h
+
+#include <stdbool.h>
+
+/* Dense row-major matrix of decimals.
+ * Like vectors, the elements are shared between copies of an lval and
+ * freed when the last reference is released. */
+typedef struct lmat {
+    int refs;
+    long rows;
+    long cols;
+    double* items;
+} lmat;
+
+/* Largest number of elements a matrix may have */
+#define MAT_MAX (1L << 24)
+
+/* Returns NULL if the matrix would be too large or cannot be allocated */
+lmat* lmat_new(long rows, long cols);
+lmat* lmat_retain(lmat* m);
+void lmat_release(lmat* m);
+
+void mat_mul(double* c, const double* a, const double* b,
+        long n, long k, long m);
+void mat_transpose(double* t, const double* a, long rows, long cols);
+bool mat_solve(double* a, double* b, long n, long m);
+
+#endif
@@ -0,0 +1,126 @@
+#include "lval.h"
+
+/* Bucket count stops here, so a huge capacity costs longer chains once
+ * the cache fills rather than a table that can not be allocated */
+#define MEMO_BUCKETS_MAX (1L << 20)
+
+/* Takes ownership of fn */
+lmemo* lmemo_new(lval* fn, long capacity) {
+    lmemo* m = malloc(sizeof(lmemo));
+    m->refs = 1;
+    m->fn = fn;
+    m->capacity = capacity;
+    m->count = 0;
+
+    /* At most one entry per bucket on average, so chains stay short,
+     * up to MEMO_BUCKETS_MAX buckets */
+    long n = 8;
+    while (n < capacity && n < MEMO_BUCKETS_MAX) { n *= 2; }
+    m->mask = n - 1;
+    m->buckets = calloc(n, sizeof(memo_entry*));
+    m->newest = NULL;
+    m->oldest = NULL;
+    m->hits = 0;
+    m->misses = 0;
+    m->disk = NULL;
+    m->id = 0;
+    return m;
+}
+
+lmemo* lmemo_retain(lmemo* m) {
+    m->refs++;
+    return m;
+}
+
+void lmemo_clear(lmemo* m) {
+    memo_entry* x = m->newest;
+    while (x) {
+        memo_entry* next = x->older;
+        lval_del(x->args);
+        lval_del(x->result);
+        free(x);
+        x = next;
+    }
+    memset(m->buckets, 0, sizeof(memo_entry*) * (m->mask + 1));
+    m->newest = NULL;
+    m->oldest = NULL;
+    m->count = 0;
+}
+
+void lmemo_release(lmemo* m) {
+    if (--m->refs > 0) { return; }
+    lmemo_clear(m);
+    lval_del(m->fn);
+    if (m->disk) { memofile_release(m->disk); }
+    free(m->buckets);
+    free(m);
+}
+
+static void lru_unlink(lmemo* m, memo_entry* x) {
+    if (x->newer) { x->newer->older = x->older; } else { m->newest = x->older; }
+    if (x->older) { x->older->newer = x->newer; } else { m->oldest = x->newer; }
+}
+
+static void lru_push(lmemo* m, memo_entry* x) {
+    x->newer = NULL;
+    x->older = m->newest;
+    if (m->newest) { m->newest->newer = x; } else { m->oldest = x; }
+    m->newest = x;
+}
+
+/* Returns the cached result without copying it, or NULL on a miss.
+ * A hit makes the entry the most recently used. */
+lval* lmemo_get(lmemo* m, lval* args, uint64_t hash) {
+    for (memo_entry* x = m->buckets[hash & m->mask]; x; x = x->chain) {
+        if (x->hash == hash && lval_eq(x->args, args)) {
+            m->hits++;
+            lru_unlink(m, x);
+            lru_push(m, x);
+            return x->result;
+        }
+    }
+    m->misses++;
+    return NULL;
+}
+
+/* Drops the least recently used entry */
+static void lmemo_evict(lmemo* m) {
+    memo_entry* x = m->oldest;
+    memo_entry** p = &m->buckets[x->hash & m->mask];
+    while (*p != x) { p = &(*p)->chain; }
+    *p = x->chain;
+    lru_unlink(m, x);
+    lval_del(x->args);
+    lval_del(x->result);
+    free(x);
+    m->count--;
+}
+
+/* Takes ownership of args and result. An existing entry for the same
+ * arguments, from a recursive call, is replaced. */
+void lmemo_put(lmemo* m, lval* args, uint64_t hash, lval* result) {
+    memo_entry** b = &m->buckets[hash & m->mask];
+    for (memo_entry* x = *b; x; x = x->chain) {
+        if (x->hash == hash && lval_eq(x->args, args)) {
+            lval_del(x->result);
+            x->result = result;
+            lval_del(args);
+            lru_unlink(m, x);
+            lru_push(m, x);
+            return;
+        }
+    }
+
+    if (m->count == m->capacity) {
+        lmemo_evict(m);
+        b = &m->buckets[hash & m->mask];
+    }
+    memo_entry* x = malloc(sizeof(memo_entry));
+    x->hash = hash;
+    x->args = args;
+    x->result = result;
+    x->chain = *b;
+    *b = x;
+    lru_push(m, x);
+    m->count++;
+}
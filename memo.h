@@ -0,0 +1,44 @@
+#ifndef memo_h
+#define memo_h
+
+#include <stdint.h>
+#include "memofile.h"
+
+struct lval;
+
+/* Cache of results for a function made by memo or defmemo, keyed on the
+ * Q-Expr of arguments. Keys are hashed with lval_hash and compared with
+ * lval_eq. When full, the least recently used entry is dropped. */
+
+typedef struct memo_entry {
+    uint64_t hash;
+    struct lval* args;
+    struct lval* result;
+    struct memo_entry* chain;   /* Next entry in the same bucket */
+    struct memo_entry* newer;
+    struct memo_entry* older;
+} memo_entry;
+
+typedef struct lmemo {
+    int refs;
+    struct lval* fn;
+    long capacity;
+    long count;
+    long mask;                  /* Buckets - 1, a power of two */
+    memo_entry** buckets;
+    memo_entry* newest;
+    memo_entry* oldest;
+    long hits;
+    long misses;
+    memofile* disk;             /* NULL unless results are kept on disk */
+    uint64_t id;                /* Identifies the function in the file */
+} lmemo;
+
+lmemo* lmemo_new(struct lval* fn, long capacity);
+lmemo* lmemo_retain(lmemo* m);
+void lmemo_release(lmemo* m);
+struct lval* lmemo_get(lmemo* m, struct lval* args, uint64_t hash);
+void lmemo_put(lmemo* m, struct lval* args, uint64_t hash, struct lval* result);
+void lmemo_clear(lmemo* m);
+
+#endif
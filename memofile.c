@@ -0,0 +1,251 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "memofile.h"
+
+#define MEMOFILE_MAGIC "LSPYMEM2"
+#define MEMOFILE_SLOTS 1024
+
+typedef struct memo_header {
+    char magic[8];
+    uint64_t table;             /* Offset of the slot table in use */
+    uint64_t count;
+    uint64_t used;              /* End of the data written so far */
+} memo_header;
+
+/* offset is 0 for an empty slot, data never starts at the beginning */
+typedef struct memo_slot {
+    uint64_t fn;
+    uint64_t hash;
+    uint64_t offset;
+    uint32_t klen;
+    uint32_t vlen;
+} memo_slot;
+
+static memofile* open_files = NULL;
+
+static memo_header* header(memofile* f) {
+    return (memo_header*) f->base;
+}
+
+/* A table is its slot count, always a power of two, then the slots */
+static uint64_t table_slots(memofile* f) {
+    return *(uint64_t*) (f->base + header(f)->table);
+}
+
+static memo_slot* slots(memofile* f) {
+    return (memo_slot*) (f->base + header(f)->table + sizeof(uint64_t));
+}
+
+static uint64_t table_size(uint64_t nslots) {
+    return sizeof(uint64_t) + nslots * sizeof(memo_slot);
+}
+
+/* Whether a slot's key and value lie inside the data written so far */
+static bool slot_valid(memofile* f, memo_slot* s) {
+    uint64_t used = header(f)->used;
+    return s->offset >= sizeof(memo_header) && s->offset <= used &&
+        (uint64_t) s->klen + s->vlen <= used - s->offset;
+}
+
+/* Checks a mapped file before anything in it is trusted */
+static bool check_file(memofile* f) {
+    if (f->size < sizeof(memo_header)) { return false; }
+    memo_header* h = header(f);
+    if (memcmp(h->magic, MEMOFILE_MAGIC, 8) != 0) { return false; }
+    if (h->used > f->size || h->used < sizeof(memo_header) + sizeof(uint64_t)) {
+        return false;
+    }
+    if (h->table % sizeof(uint64_t) || h->table < sizeof(memo_header) ||
+            h->table > h->used - sizeof(uint64_t)) {
+        return false;
+    }
+    uint64_t n = table_slots(f);
+    return n && (n & (n - 1)) == 0 &&
+        n <= (h->used - h->table - sizeof(uint64_t)) / sizeof(memo_slot) &&
+        h->count < n;
+}
+
+/* FNV-1a over the key, seeded with the function id */
+static uint64_t key_hash(uint64_t fn, const uint8_t* key, uint32_t klen) {
+    uint64_t h = 1469598103934665603ULL ^ fn;
+    for (uint32_t i = 0; i < klen; i++) {
+        h ^= key[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/* Resizes the file and maps it again. The old mapping stays in place
+ * if this fails. */
+static bool remap(memofile* f, uint64_t size) {
+    if (ftruncate(f->fd, size) != 0) { return false; }
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, f->fd, 0);
+    if (p == MAP_FAILED) { return false; }
+    if (f->base) { munmap(f->base, f->size); }
+    f->base = p;
+    f->size = size;
+    return true;
+}
+
+memofile* memofile_open(char* path) {
+    for (memofile* f = open_files; f; f = f->next) {
+        if (strcmp(f->path, path) == 0) {
+            f->refs++;
+            return f;
+        }
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) { return NULL; }
+
+    /* Only one process uses a file at a time */
+    struct stat st;
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0 || fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    memofile* f = malloc(sizeof(memofile));
+    f->refs = 1;
+    f->fd = fd;
+    f->base = NULL;
+    f->size = 0;
+
+    bool ok;
+    if (st.st_size == 0) {
+        /* New file, with room for some data after the table */
+        uint64_t start = sizeof(memo_header) + table_size(MEMOFILE_SLOTS);
+        ok = remap(f, start * 2);
+        if (ok) {
+            memset(f->base, 0, start);
+            memcpy(header(f)->magic, MEMOFILE_MAGIC, 8);
+            header(f)->table = sizeof(memo_header);
+            header(f)->used = start;
+            *(uint64_t*) (f->base + header(f)->table) = MEMOFILE_SLOTS;
+        }
+    } else {
+        ok = remap(f, st.st_size) && check_file(f);
+    }
+    if (!ok) {
+        if (f->base) { munmap(f->base, f->size); }
+        close(fd);
+        free(f);
+        return NULL;
+    }
+
+    f->path = malloc(strlen(path) + 1);
+    strcpy(f->path, path);
+    f->next = open_files;
+    open_files = f;
+    return f;
+}
+
+void memofile_release(memofile* f) {
+    if (--f->refs > 0) { return; }
+    memofile** p = &open_files;
+    while (*p != f) { p = &(*p)->next; }
+    *p = f->next;
+
+    /* Drop the spare space at the end */
+    uint64_t used = header(f)->used;
+    munmap(f->base, f->size);
+    if (ftruncate(f->fd, used) != 0) { /* The spare space is harmless */ }
+    close(f->fd);
+    free(f->path);
+    free(f);
+}
+
+/* Index of the slot holding the key, or of the empty slot for it.
+ * Returns the slot count if the table has neither. Slots that point
+ * outside the data are passed over. */
+static uint64_t find(memofile* f, uint64_t fn, uint64_t h,
+        const uint8_t* key, uint32_t klen) {
+    memo_slot* s = slots(f);
+    uint64_t n = table_slots(f);
+    uint64_t i = h & (n - 1);
+    for (uint64_t k = 0; k < n; k++, i = (i + 1) & (n - 1)) {
+        if (!s[i].offset) { return i; }
+        if (s[i].hash == h && s[i].fn == fn && s[i].klen == klen &&
+                slot_valid(f, &s[i]) &&
+                memcmp(f->base + s[i].offset, key, klen) == 0) {
+            return i;
+        }
+    }
+    return n;
+}
+
+bool memofile_get(memofile* f, uint64_t fn, const uint8_t* key, uint32_t klen,
+        const uint8_t** val, uint32_t* vlen) {
+    uint64_t h = key_hash(fn, key, klen);
+    uint64_t i = find(f, fn, h, key, klen);
+    if (i == table_slots(f) || !slots(f)[i].offset) { return false; }
+    memo_slot* s = &slots(f)[i];
+    *val = f->base + s->offset + s->klen;
+    *vlen = s->vlen;
+    return true;
+}
+
+/* Doubles the table by writing a new one after the data and then
+ * switching the header to it with a single store. A run that stops part
+ * way leaves the old table in use and some unreferenced bytes. */
+static bool grow_table(memofile* f) {
+    uint64_t n = table_slots(f);
+    uint64_t at = (header(f)->used + 7) & ~(uint64_t) 7;
+    uint64_t end = at + table_size(2 * n);
+    if (end > f->size && !remap(f, end * 2)) { return false; }
+
+    memset(f->base + at, 0, table_size(2 * n));
+    *(uint64_t*) (f->base + at) = 2 * n;
+    memo_slot* old = slots(f);
+    memo_slot* s = (memo_slot*) (f->base + at + sizeof(uint64_t));
+
+    uint64_t mask = 2 * n - 1;
+    for (uint64_t i = 0; i < n; i++) {
+        if (!old[i].offset || !slot_valid(f, &old[i])) { continue; }
+        uint64_t j = old[i].hash & mask;
+        while (s[j].offset) { j = (j + 1) & mask; }
+        s[j] = old[i];
+    }
+
+    header(f)->used = end;
+    __atomic_store_n(&header(f)->table, at, __ATOMIC_RELEASE);
+    return true;
+}
+
+/* Adds an entry, keeping any existing one for the same key. The data is
+ * written and claimed before the slot, whose offset is stored last, so
+ * a run that stops part way leaves at worst some unreferenced bytes. */
+bool memofile_put(memofile* f, uint64_t fn, const uint8_t* key, uint32_t klen,
+        const uint8_t* val, uint32_t vlen) {
+    if ((header(f)->count + 1) * 2 > table_slots(f) && !grow_table(f)) {
+        return false;
+    }
+    uint64_t h = key_hash(fn, key, klen);
+    uint64_t i = find(f, fn, h, key, klen);
+    if (i == table_slots(f)) { return false; }
+    if (slots(f)[i].offset) { return true; }
+
+    uint64_t used = header(f)->used;
+    uint64_t need = used + klen + vlen;
+    if (need > f->size && !remap(f, need * 2)) { return false; }
+    memcpy(f->base + used, key, klen);
+    memcpy(f->base + used + klen, val, vlen);
+    header(f)->used = need;
+
+    memo_slot* s = &slots(f)[i];
+    s->fn = fn;
+    s->hash = h;
+    s->klen = klen;
+    s->vlen = vlen;
+    __atomic_store_n(&s->offset, used, __ATOMIC_RELEASE);
+    header(f)->count++;
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef memofile_h
+#define memofile_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Results of memoised functions kept on disk between runs.
+ *
+ * The file is mapped into memory. It starts with a header, then the
+ * encoded arguments and results, with open addressing tables of slots
+ * pointing into them. Entries are keyed by an id for the function and
+ * the encoded arguments, and are only ever added. Files are shared by
+ * every memo that names the same path. A process holds a lock on each
+ * file it has open, so another running at the same time can not open
+ * it. */
+
+typedef struct memofile {
+    int refs;
+    char* path;
+    int fd;
+    uint8_t* base;
+    uint64_t size;
+    struct memofile* next;      /* Other open files */
+} memofile;
+
+/* Opens or creates a file, returning NULL if it cannot be locked or
+ * mapped, or is not a valid memo file */
+memofile* memofile_open(char* path);
+void memofile_release(memofile* f);
+
+/* Points at the encoded result for a key inside the mapping. The bytes
+ * are only valid until the next put. */
+bool memofile_get(memofile* f, uint64_t fn, const uint8_t* key, uint32_t klen,
+        const uint8_t** val, uint32_t* vlen);
+bool memofile_put(memofile* f, uint64_t fn, const uint8_t* key, uint32_t klen,
+        const uint8_t* val, uint32_t vlen);
+
+#endif
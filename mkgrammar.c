@@ -0,0 +1,35 @@
+#include <stdio.h>
+#include "grammar.h"
+
+/* Build step that compiles grammar_src with mpca_lang and writes the
+ * resulting parsers to stdout as C tables, which the Makefile saves as
+ * grammar_table.c */
+int main(void) {
+    mpc_parser_t* Number = mpc_new("number");
+    mpc_parser_t* Symbol = mpc_new("symbol");
+    mpc_parser_t* String = mpc_new("string");
+    mpc_parser_t* Comment = mpc_new("comment");
+    mpc_parser_t* Sexpr  = mpc_new("sexpr");
+    mpc_parser_t* Qexpr  = mpc_new("qexpr");
+    mpc_parser_t* Expr   = mpc_new("expr");
+    mpc_parser_t* Lispy  = mpc_new("lispy");
+
+    int ok = 1;
+    mpc_err_t* err = mpca_lang(MPCA_LANG_DEFAULT, grammar_src,
+        Number, Symbol, String, Comment, Sexpr, Qexpr, Expr, Lispy);
+    if (err) {
+        mpc_err_print_to(err, stderr);
+        mpc_err_delete(err);
+        ok = 0;
+    } else if (!mpc_dump(stdout, "grammar_table", 8,
+            Number, Symbol, String, Comment, Sexpr, Qexpr, Expr, Lispy)) {
+        fputs("mkgrammar: grammar uses callbacks mpc_dump can not write\n", stderr);
+        ok = 0;
+    }
+
+    mpc_cleanup(8,
+            Number, Symbol, String, Comment,
+            Sexpr, Qexpr, Expr, Lispy);
+
+    return ok ? 0 : 1;
+}
@@ -1,3 +1,12 @@
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200809L
+#define MPC_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "mpc.h"
 
 /*
@@ -22,6 +31,89 @@ static mpc_state_t mpc_state_new(void) {
   return s;
 }
 
+/*
+** Arena Type
+**
+** An arena hands out memory from a list of large
+** chunks and frees it all in one go. Chunks grow
+** up to a limit, and anything larger than a chunk
+** gets a chunk of its own.
+*/
+
+enum {
+  MPC_ARENA_ALIGN = 8,
+  MPC_ARENA_CHUNK_MIN = 4096,
+  MPC_ARENA_CHUNK_MAX = 1 << 20
+};
+
+typedef struct mpc_chunk_t {
+  struct mpc_chunk_t *next;
+  size_t size;
+  size_t used;
+} mpc_chunk_t;
+
+#define MPC_CHUNK_HEAD \
+  ((sizeof(mpc_chunk_t) + MPC_ARENA_ALIGN - 1) & ~(size_t)(MPC_ARENA_ALIGN - 1))
+
+typedef struct mpc_arena_t {
+  mpc_chunk_t *chunks;
+  size_t next_size;
+} mpc_arena_t;
+
+static mpc_arena_t *mpc_arena_new(void) {
+  mpc_arena_t *a = malloc(sizeof(mpc_arena_t));
+  a->chunks = NULL;
+  a->next_size = MPC_ARENA_CHUNK_MIN;
+  return a;
+}
+
+static void mpc_arena_delete(mpc_arena_t *a) {
+  mpc_chunk_t *c, *n;
+  for (c = a->chunks; c; c = n) { n = c->next; free(c); }
+  free(a);
+}
+
+static void *mpc_arena_alloc(mpc_arena_t *a, size_t n) {
+
+  mpc_chunk_t *c = a->chunks;
+  size_t size;
+
+  n = (n + MPC_ARENA_ALIGN - 1) & ~(size_t)(MPC_ARENA_ALIGN - 1);
+
+  if (c == NULL || c->size - c->used < n) {
+    size = n > a->next_size ? n : a->next_size;
+    c = malloc(MPC_CHUNK_HEAD + size);
+    c->size = size;
+    c->used = 0;
+    /* Oversized chunks go behind the current one so it stays in use */
+    if (size > a->next_size && a->chunks) {
+      c->next = a->chunks->next;
+      a->chunks->next = c;
+    } else {
+      c->next = a->chunks;
+      a->chunks = c;
+      if (a->next_size < MPC_ARENA_CHUNK_MAX) { a->next_size *= 2; }
+    }
+  }
+
+  c->used += n;
+  return (char*)c + MPC_CHUNK_HEAD + c->used - n;
+}
+
+static int mpc_arena_has(mpc_arena_t *a, void *p) {
+  mpc_chunk_t *c;
+  for (c = a->chunks; c; c = c->next) {
+    if ((char*)p >= (char*)c + MPC_CHUNK_HEAD &&
+        (char*)p <  (char*)c + MPC_CHUNK_HEAD + c->size) { return 1; }
+  }
+  return 0;
+}
+
+static char *mpc_arena_str(mpc_arena_t *a, const char *s) {
+  size_t n = strlen(s) + 1;
+  return memcpy(mpc_arena_alloc(a, n), s, n);
+}
+
 /*
 ** Input Type
 */
@@ -68,13 +160,46 @@ enum {
 };
 
 enum {
-  MPC_INPUT_MEM_NUM = 512
+  MPC_INPUT_MEM_NUM = 512,
+  MPC_INPUT_MEM_MORE_MAX = 16
 };
 
 typedef struct {
   char mem[64];
 } mpc_mem_t;
 
+/*
+** In arena mode the block pool grows once it fills,
+** taking batches of blocks from the arena, each twice
+** the size of the last. Free blocks in the batches are
+** kept on a list threaded through the blocks.
+*/
+
+/*
+** In packrat mode each named parser run is recorded
+** against the position it started at, along with
+** where it finished and any errors it produced.
+** Successful outputs are only kept (as copies) once
+** a rule is parsed a second time at a position, so
+** parses that never backtrack pay no copying.
+*/
+
+enum {
+  MPC_INPUT_MEMO_MIN = 256
+};
+
+typedef struct {
+  mpc_parser_t *p;
+  long pos;
+  int mode;
+  int success;
+  mpc_state_t state;
+  char last;
+  mpc_val_t *output;
+  mpc_err_t *error;
+  mpc_err_t *trail;
+} mpc_memo_t;
+
 typedef struct {
 
   int type;
@@ -95,8 +220,22 @@ typedef struct {
   char last;
 
   size_t mem_index;
+  size_t mem_used;
   char mem_full[MPC_INPUT_MEM_NUM];
   mpc_mem_t mem[MPC_INPUT_MEM_NUM];
+  int mem_more_num;
+  mpc_mem_t *mem_more[MPC_INPUT_MEM_MORE_MAX];
+  mpc_mem_t *mem_free;
+  mpc_arena_t *arena;
+
+  int flags;
+  int memo_num;
+  int memo_slots;
+  mpc_memo_t *memo;
+
+  int lazy;
+  int prune;
+  long furthest;
 
 } mpc_input_t;
 
@@ -124,7 +263,20 @@ static mpc_input_t *mpc_input_new_string(const char *filename, const char *strin
   i->last = '\0';
 
   i->mem_index = 0;
+  i->mem_used = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
+  i->mem_more_num = 0;
+  i->mem_free = NULL;
+  i->arena = NULL;
+
+  i->flags = MPC_PARSE_DEFAULT;
+  i->memo_num = 0;
+  i->memo_slots = 0;
+  i->memo = NULL;
+
+  i->lazy = 0;
+  i->prune = 0;
+  i->furthest = -1;
 
   return i;
 }
@@ -154,7 +306,20 @@ static mpc_input_t *mpc_input_new_nstring(const char *filename, const char *stri
   i->last = '\0';
 
   i->mem_index = 0;
+  i->mem_used = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
+  i->mem_more_num = 0;
+  i->mem_free = NULL;
+  i->arena = NULL;
+
+  i->flags = MPC_PARSE_DEFAULT;
+  i->memo_num = 0;
+  i->memo_slots = 0;
+  i->memo = NULL;
+
+  i->lazy = 0;
+  i->prune = 0;
+  i->furthest = -1;
 
   return i;
 
@@ -183,7 +348,20 @@ static mpc_input_t *mpc_input_new_pipe(const char *filename, FILE *pipe) {
   i->last = '\0';
 
   i->mem_index = 0;
+  i->mem_used = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
+  i->mem_more_num = 0;
+  i->mem_free = NULL;
+  i->arena = NULL;
+
+  i->flags = MPC_PARSE_DEFAULT;
+  i->memo_num = 0;
+  i->memo_slots = 0;
+  i->memo = NULL;
+
+  i->lazy = 0;
+  i->prune = 0;
+  i->furthest = -1;
 
   return i;
 
@@ -211,13 +389,38 @@ static mpc_input_t *mpc_input_new_file(const char *filename, FILE *file) {
   i->last = '\0';
 
   i->mem_index = 0;
+  i->mem_used = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
+  i->mem_more_num = 0;
+  i->mem_free = NULL;
+  i->arena = NULL;
+
+  i->flags = MPC_PARSE_DEFAULT;
+  i->memo_num = 0;
+  i->memo_slots = 0;
+  i->memo = NULL;
+
+  i->lazy = 0;
+  i->prune = 0;
+  i->furthest = -1;
 
   return i;
 }
 
 static void mpc_input_delete(mpc_input_t *i) {
 
+  int j;
+
+  for (j = 0; j < i->memo_slots; j++) {
+    if (i->memo[j].p == NULL) { continue; }
+    if (i->memo[j].error) { mpc_err_delete(i->memo[j].error); }
+    if (i->memo[j].trail) { mpc_err_delete(i->memo[j].trail); }
+    if (!(i->flags & MPC_PARSE_ARENA)) { mpc_ast_delete(i->memo[j].output); }
+  }
+  free(i->memo);
+
+  if (i->arena) { mpc_arena_delete(i->arena); }
+
   free(i->filename);
 
   if (i->type == MPC_INPUT_STRING) { free(i->string); }
@@ -228,28 +431,65 @@ static void mpc_input_delete(mpc_input_t *i) {
   free(i);
 }
 
+static mpc_arena_t *mpc_input_arena(mpc_input_t *i) {
+  if (i->arena == NULL) { i->arena = mpc_arena_new(); }
+  return i->arena;
+}
+
+static int mpc_mem_more_ptr(mpc_input_t *i, void *p) {
+  int j;
+  for (j = 0; j < i->mem_more_num; j++) {
+    if ((char*)p >= (char*)(i->mem_more[j]) &&
+        (char*)p <  (char*)(i->mem_more[j]) + ((size_t)MPC_INPUT_MEM_NUM << j) * sizeof(mpc_mem_t)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
 static int mpc_mem_ptr(mpc_input_t *i, void *p) {
   return
-    (char*)p >= (char*)(i->mem) &&
-    (char*)p <  (char*)(i->mem) + (MPC_INPUT_MEM_NUM * sizeof(mpc_mem_t));
+    ((char*)p >= (char*)(i->mem) &&
+     (char*)p <  (char*)(i->mem) + (MPC_INPUT_MEM_NUM * sizeof(mpc_mem_t))) ||
+    mpc_mem_more_ptr(i, p);
+}
+
+static void mpc_mem_grow(mpc_input_t *i) {
+  size_t j, n = (size_t)MPC_INPUT_MEM_NUM << i->mem_more_num;
+  mpc_mem_t *m = mpc_arena_alloc(mpc_input_arena(i), n * sizeof(mpc_mem_t));
+  i->mem_more[i->mem_more_num++] = m;
+  for (j = 0; j < n; j++) {
+    *(mpc_mem_t**)(m + j) = i->mem_free;
+    i->mem_free = m + j;
+  }
 }
 
 static void *mpc_malloc(mpc_input_t *i, size_t n) {
-  size_t j;
   char *p;
 
   if (n > sizeof(mpc_mem_t)) { return malloc(n); }
 
-  j = i->mem_index;
-  do {
-    if (!i->mem_full[i->mem_index]) {
-      p = (void*)(i->mem + i->mem_index);
-      i->mem_full[i->mem_index] = 1;
+  if (i->mem_used < MPC_INPUT_MEM_NUM) {
+    while (i->mem_full[i->mem_index]) {
       i->mem_index = (i->mem_index+1) % MPC_INPUT_MEM_NUM;
-      return p;
     }
+    p = (void*)(i->mem + i->mem_index);
+    i->mem_full[i->mem_index] = 1;
     i->mem_index = (i->mem_index+1) % MPC_INPUT_MEM_NUM;
-  } while (j != i->mem_index);
+    i->mem_used++;
+    return p;
+  }
+
+  if ((i->flags & MPC_PARSE_ARENA) && i->mem_free == NULL &&
+      i->mem_more_num < MPC_INPUT_MEM_MORE_MAX) {
+    mpc_mem_grow(i);
+  }
+
+  if (i->mem_free) {
+    p = (void*)i->mem_free;
+    i->mem_free = *(mpc_mem_t**)p;
+    return p;
+  }
 
   return malloc(n);
 }
@@ -262,9 +502,19 @@ static void *mpc_calloc(mpc_input_t *i, size_t n, size_t m) {
 
 static void mpc_free(mpc_input_t *i, void *p) {
   size_t j;
-  if (!mpc_mem_ptr(i, p)) { free(p); return; }
-  j = ((size_t)(((char*)p) - ((char*)i->mem))) / sizeof(mpc_mem_t);
-  i->mem_full[j] = 0;
+  if ((char*)p >= (char*)(i->mem) &&
+      (char*)p <  (char*)(i->mem) + (MPC_INPUT_MEM_NUM * sizeof(mpc_mem_t))) {
+    j = ((size_t)(((char*)p) - ((char*)i->mem))) / sizeof(mpc_mem_t);
+    i->mem_full[j] = 0;
+    i->mem_used--;
+    return;
+  }
+  if (i->mem_more_num && mpc_mem_more_ptr(i, p)) {
+    *(mpc_mem_t**)p = i->mem_free;
+    i->mem_free = p;
+    return;
+  }
+  free(p);
 }
 
 static void *mpc_realloc(mpc_input_t *i, void *p, size_t n) {
@@ -663,9 +913,31 @@ char *mpc_err_string(mpc_err_t *x) {
   return realloc(buffer, strlen(buffer) + 1);
 }
 
+/*
+** Errors are often made and then dropped, as most
+** failures are just backtracked over. A parse can
+** instead be run lazily, where no errors are made
+** and only the furthest failure position is noted.
+** If it fails, it is run again to make the errors,
+** and errors before that position are skipped, as
+** merging would drop them anyway.
+*/
+
+static void mpc_err_note(mpc_input_t *i) {
+  if (i->lazy && !i->suppress && i->state.pos > i->furthest) {
+    i->furthest = i->state.pos;
+  }
+}
+
+static int mpc_err_skip(mpc_input_t *i) {
+  if (i->suppress) { return 1; }
+  if (i->lazy) { mpc_err_note(i); return 1; }
+  return i->prune && i->state.pos < i->furthest;
+}
+
 static mpc_err_t *mpc_err_new(mpc_input_t *i, const char *expected) {
   mpc_err_t *x;
-  if (i->suppress) { return NULL; }
+  if (mpc_err_skip(i)) { return NULL; }
   x = mpc_malloc(i, sizeof(mpc_err_t));
   x->filename = mpc_malloc(i, strlen(i->filename) + 1);
   strcpy(x->filename, i->filename);
@@ -681,7 +953,7 @@ static mpc_err_t *mpc_err_new(mpc_input_t *i, const char *expected) {
 
 static mpc_err_t *mpc_err_fail(mpc_input_t *i, const char *failure) {
   mpc_err_t *x;
-  if (i->suppress) { return NULL; }
+  if (mpc_err_skip(i)) { return NULL; }
   x = mpc_malloc(i, sizeof(mpc_err_t));
   x->filename = mpc_malloc(i, strlen(i->filename) + 1);
   strcpy(x->filename, i->filename);
@@ -729,6 +1001,29 @@ static mpc_err_t *mpc_err_export(mpc_input_t *i, mpc_err_t *x) {
   return mpc_export(i, x);
 }
 
+static mpc_err_t *mpc_err_copy(mpc_input_t *i, mpc_err_t *x) {
+  int j;
+  mpc_err_t *y;
+  if (x == NULL) { return NULL; }
+  y = mpc_malloc(i, sizeof(mpc_err_t));
+  y->state = x->state;
+  y->expected_num = x->expected_num;
+  y->expected = x->expected_num ? mpc_malloc(i, sizeof(char*) * x->expected_num) : NULL;
+  for (j = 0; j < x->expected_num; j++) {
+    y->expected[j] = mpc_malloc(i, strlen(x->expected[j]) + 1);
+    strcpy(y->expected[j], x->expected[j]);
+  }
+  y->filename = mpc_malloc(i, strlen(x->filename) + 1);
+  strcpy(y->filename, x->filename);
+  y->failure = NULL;
+  if (x->failure) {
+    y->failure = mpc_malloc(i, strlen(x->failure) + 1);
+    strcpy(y->failure, x->failure);
+  }
+  y->received = x->received;
+  return y;
+}
+
 static int mpc_err_contains_expected(mpc_input_t *i, mpc_err_t *x, char *expected) {
   int j;
   (void)i;
@@ -914,9 +1209,20 @@ enum {
   MPC_TYPE_CHECK_WITH = 26,
 
   MPC_TYPE_SOI        = 27,
-  MPC_TYPE_EOI        = 28
+  MPC_TYPE_EOI        = 28,
+
+  MPC_TYPE_DFA        = 29
 };
 
+typedef struct mpc_dfa_t mpc_dfa_t;
+
+static int mpc_dfa_match(mpc_input_t *i, mpc_dfa_t *d, char **o);
+static mpc_dfa_t *mpc_dfa_copy(mpc_dfa_t *d);
+static void mpc_dfa_delete(mpc_dfa_t *d);
+
+/* Bytes each alternative of an `or` can start with, one bit per byte */
+enum { MPC_FIRST_BYTES = 32 };
+
 typedef struct { char *m; } mpc_pdata_fail_t;
 typedef struct { mpc_ctor_t lf; void *x; } mpc_pdata_lift_t;
 typedef struct { mpc_parser_t *x; char *m; } mpc_pdata_expect_t;
@@ -932,8 +1238,9 @@ typedef struct { mpc_parser_t *x; mpc_dtor_t dx; mpc_check_with_t f; void *d; ch
 typedef struct { mpc_parser_t *x; } mpc_pdata_predict_t;
 typedef struct { mpc_parser_t *x; mpc_dtor_t dx; mpc_ctor_t lf; } mpc_pdata_not_t;
 typedef struct { int n; mpc_fold_t f; mpc_parser_t *x; mpc_dtor_t dx; } mpc_pdata_repeat_t;
-typedef struct { int n; mpc_parser_t **xs; } mpc_pdata_or_t;
+typedef struct { int n; mpc_parser_t **xs; unsigned char *first; } mpc_pdata_or_t;
 typedef struct { int n; mpc_fold_t f; mpc_parser_t **xs; mpc_dtor_t *dxs;  } mpc_pdata_and_t;
+typedef struct { mpc_parser_t *x; mpc_dfa_t *d; } mpc_pdata_dfa_t;
 
 typedef union {
   mpc_pdata_fail_t fail;
@@ -953,10 +1260,12 @@ typedef union {
   mpc_pdata_repeat_t repeat;
   mpc_pdata_and_t and;
   mpc_pdata_or_t or;
+  mpc_pdata_dfa_t dfa;
 } mpc_pdata_t;
 
 struct mpc_parser_t {
   char *name;
+  int id;
   mpc_pdata_t data;
   char type;
   char retained;
@@ -991,6 +1300,60 @@ static mpc_val_t *mpcf_input_state_ast(mpc_input_t *i, int n, mpc_val_t **xs) {
   return a;
 }
 
+static mpc_ast_t *mpc_ast_new_arena(mpc_arena_t *m, const char *tag, const char *contents);
+static mpc_ast_t *mpc_ast_copy_arena(mpc_arena_t *m, mpc_ast_t *a);
+static mpc_ast_t *mpc_ast_adopt(mpc_arena_t *m, mpc_ast_t *a);
+static mpc_ast_t *mpc_ast_lift(mpc_ast_t *a);
+
+/*
+** In arena mode ASTs are built in the input's arena.
+** Only folds and mpcf_str_ast need to check for it,
+** as the other AST functions work in the arena of
+** the node they are given.
+*/
+
+static mpc_val_t *mpcf_input_fold_ast(mpc_input_t *i, int n, mpc_val_t **xs) {
+
+  int j, k, m = 0;
+  mpc_ast_t **as = (mpc_ast_t**)xs;
+  mpc_arena_t *arena;
+  mpc_ast_t *r;
+
+  if (n == 0) { return NULL; }
+  if (n == 1) { return xs[0]; }
+  if (n == 2 && xs[1] == NULL) { return xs[0]; }
+  if (n == 2 && xs[0] == NULL) { return xs[1]; }
+
+  arena = mpc_input_arena(i);
+  for (j = 0; j < n; j++) {
+    if (as[j] == NULL) { continue; }
+    as[j] = mpc_ast_adopt(arena, as[j]);
+    m += as[j]->children_num >= 2 ? as[j]->children_num : 1;
+  }
+
+  r = mpc_ast_new_arena(arena, ">", "");
+  r->children = m ? mpc_arena_alloc(arena, sizeof(mpc_ast_t*) * m) : NULL;
+
+  for (j = 0; j < n; j++) {
+    if (as[j] == NULL) { continue; }
+    if (as[j]->children_num == 0) {
+      r->children[r->children_num++] = as[j];
+    } else if (as[j]->children_num == 1) {
+      r->children[r->children_num++] = mpc_ast_lift(as[j]);
+    } else {
+      for (k = 0; k < as[j]->children_num; k++) {
+        r->children[r->children_num++] = as[j]->children[k];
+      }
+    }
+  }
+
+  if (r->children_num) {
+    r->state = r->children[0]->state;
+  }
+
+  return r;
+}
+
 static mpc_val_t *mpc_parse_fold(mpc_input_t *i, mpc_fold_t f, int n, mpc_val_t **xs) {
   int j;
   if (f == mpcf_null)      { return mpcf_null(n, xs); }
@@ -1002,6 +1365,7 @@ static mpc_val_t *mpc_parse_fold(mpc_input_t *i, mpc_fold_t f, int n, mpc_val_t
   if (f == mpcf_trd_free)  { return mpcf_input_trd_free(i, n, xs); }
   if (f == mpcf_strfold)   { return mpcf_input_strfold(i, n, xs); }
   if (f == mpcf_state_ast) { return mpcf_input_state_ast(i, n, xs); }
+  if (f == mpcf_fold_ast && (i->flags & MPC_PARSE_ARENA)) { return mpcf_input_fold_ast(i, n, xs); }
   for (j = 0; j < n; j++) { xs[j] = mpc_export(i, xs[j]); }
   return f(j, xs);
 }
@@ -1012,7 +1376,9 @@ static mpc_val_t *mpcf_input_free(mpc_input_t *i, mpc_val_t *x) {
 }
 
 static mpc_val_t *mpcf_input_str_ast(mpc_input_t *i, mpc_val_t *c) {
-  mpc_ast_t *a = mpc_ast_new("", c);
+  mpc_ast_t *a = (i->flags & MPC_PARSE_ARENA)
+    ? mpc_ast_new_arena(mpc_input_arena(i), "", c)
+    : mpc_ast_new("", c);
   mpc_free(i, c);
   return a;
 }
@@ -1029,6 +1395,8 @@ static mpc_val_t *mpc_parse_apply_to(mpc_input_t *i, mpc_apply_to_t f, mpc_val_t
 
 static void mpc_parse_dtor(mpc_input_t *i, mpc_dtor_t d, mpc_val_t *x) {
   if (d == free) { mpc_free(i, x); return; }
+  /* Arena nodes are released along with the arena */
+  if (d == (mpc_dtor_t)mpc_ast_delete && x && ((mpc_ast_t*)x)->arena) { return; }
   d(mpc_export(i, x));
 }
 
@@ -1044,9 +1412,134 @@ enum {
 
 #define MPC_MAX_RECURSION_DEPTH 1000
 
+/*
+** Memo Table
+**
+** Entries are keyed on the parser, the position and
+** whether errors are suppressed or backtracking is
+** off, since both change what a parser returns.
+*/
+
+static int mpc_memo_mode(mpc_input_t *i) {
+  return (i->suppress || i->lazy ? 1 : 0) | (i->backtrack < 1 ? 2 : 0);
+}
+
+static size_t mpc_memo_hash(mpc_parser_t *p, long pos, int mode) {
+  size_t h = (size_t)p / sizeof(mpc_parser_t);
+  h = h * 31 + (size_t)pos;
+  h = h * 31 + (size_t)mode;
+  return h * 2654435761u;
+}
+
+static int mpc_memo_find(mpc_input_t *i, mpc_parser_t *p, long pos, int mode) {
+  int j = mpc_memo_hash(p, pos, mode) & (i->memo_slots - 1);
+  while (i->memo[j].p != NULL) {
+    if (i->memo[j].p == p && i->memo[j].pos == pos && i->memo[j].mode == mode) {
+      return j;
+    }
+    j = (j + 1) & (i->memo_slots - 1);
+  }
+  return j;
+}
+
+static void mpc_memo_grow(mpc_input_t *i) {
+  int j, n = i->memo_slots;
+  mpc_memo_t *old = i->memo;
+  i->memo_slots = n ? n * 2 : MPC_INPUT_MEMO_MIN;
+  i->memo = calloc(i->memo_slots, sizeof(mpc_memo_t));
+  for (j = 0; j < n; j++) {
+    if (old[j].p == NULL) { continue; }
+    i->memo[mpc_memo_find(i, old[j].p, old[j].pos, old[j].mode)] = old[j];
+  }
+  free(old);
+}
+
+static int mpc_parse_body(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_err_t **e, int depth);
+
+static int mpc_parse_memo(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_err_t **e, int depth) {
+
+  int j, x;
+  long pos = i->state.pos;
+  int mode = mpc_memo_mode(i);
+  mpc_memo_t *m;
+  mpc_err_t *outer, *trail;
+
+  if ((i->memo_num + 1) * 4 > i->memo_slots * 3) { mpc_memo_grow(i); }
+
+  j = mpc_memo_find(i, p, pos, mode);
+  m = &i->memo[j];
+
+  if (m->p && (!m->success || m->output)) {
+    i->state = m->state;
+    i->last = m->last;
+    if (i->type == MPC_INPUT_FILE) { fseek(i->file, i->state.pos, SEEK_SET); }
+    if (m->trail) { *e = mpc_err_merge(i, *e, mpc_err_copy(i, m->trail)); }
+    if (m->success) {
+      r->output = (i->flags & MPC_PARSE_ARENA)
+        ? mpc_ast_copy_arena(mpc_input_arena(i), m->output)
+        : mpc_ast_copy(m->output);
+    } else {
+      r->error = mpc_err_copy(i, m->error);
+    }
+    return m->success;
+  }
+
+  /* Errors merged while the rule runs are collected
+  ** apart from the rest so they can be replayed */
+  outer = *e;
+  *e = NULL;
+  x = mpc_parse_body(i, p, r, e, depth);
+  trail = *e;
+  *e = trail ? mpc_err_merge(i, outer, mpc_err_copy(i, trail)) : outer;
+
+  /* The table may have grown during the parse */
+  j = mpc_memo_find(i, p, pos, mode);
+  m = &i->memo[j];
+
+  if (m->p) {
+    if (x) {
+      m->output = (i->flags & MPC_PARSE_ARENA)
+        ? mpc_ast_copy_arena(mpc_input_arena(i), r->output)
+        : mpc_ast_copy(r->output);
+    }
+    mpc_err_delete_internal(i, trail);
+    return x;
+  }
+
+  m->p = p;
+  m->pos = pos;
+  m->mode = mode;
+  m->success = x;
+  m->state = i->state;
+  m->last = i->last;
+  m->output = NULL;
+  m->error = (!x && r->error) ? mpc_err_export(i, mpc_err_copy(i, r->error)) : NULL;
+  m->trail = trail ? mpc_err_export(i, trail) : NULL;
+  i->memo_num++;
+  return x;
+}
+
 static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_err_t **e, int depth) {
+  if ((i->flags & MPC_PARSE_PACKRAT) && p->name && i->type != MPC_INPUT_PIPE) {
+    return mpc_parse_memo(i, p, r, e, depth);
+  }
+  return mpc_parse_body(i, p, r, e, depth);
+}
+
+static int mpc_first_has(const unsigned char *first, int c) {
+  return first[c >> 3] & (1 << (c & 7));
+}
+
+/* Alternatives that can't start with the next byte
+** are skipped when their errors would be dropped */
+static int mpc_parse_dispatch(mpc_input_t *i, mpc_parser_t *p) {
+  if (!(i->suppress || i->lazy) || !p->data.or.first || i->type != MPC_INPUT_STRING) { return -1; }
+  return (unsigned char)i->string[i->state.pos];
+}
+
+static int mpc_parse_body(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_err_t **e, int depth) {
 
-  int j = 0, k = 0;
+  int j = 0, k = 0, c;
   mpc_result_t results_stk[MPC_PARSE_STACK_MIN];
   mpc_result_t *results;
   int results_slots = MPC_PARSE_STACK_MIN;
@@ -1108,6 +1601,18 @@ static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_e
         MPC_FAILURE(r->error);
       }
 
+    case MPC_TYPE_DFA:
+      if ((i->suppress || i->lazy) && i->backtrack > 0 && i->type == MPC_INPUT_STRING) {
+        if (mpc_dfa_match(i, p->data.dfa.d, (char**)&r->output)) { MPC_SUCCESS(r->output); }
+        mpc_err_note(i);
+        MPC_FAILURE(NULL);
+      }
+      if (mpc_parse_run(i, p->data.dfa.x, r, e, depth)) {
+        MPC_SUCCESS(r->output);
+      } else {
+        MPC_FAILURE(r->error);
+      }
+
     case MPC_TYPE_CHECK_WITH:
       if (mpc_parse_run(i, p->data.check_with.x, r, e, depth+1)) {
         if (p->data.check_with.f(&r->output, p->data.check_with.d)) {
@@ -1253,7 +1758,13 @@ static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_e
         ? mpc_malloc(i, sizeof(mpc_result_t) * p->data.or.n)
         : results_stk;
 
+      c = mpc_parse_dispatch(i, p);
+
       for (j = 0; j < p->data.or.n; j++) {
+        if (c >= 0 && !mpc_first_has(p->data.or.first + j * MPC_FIRST_BYTES, c)) {
+          mpc_err_note(i);
+          continue;
+        }
         if (mpc_parse_run(i, p->data.or.xs[j], &results[j], e, depth+1)) {
           MPC_SUCCESS(results[j].output;
             if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
@@ -1304,14 +1815,42 @@ static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_e
 #undef MPC_FAILURE
 #undef MPC_PRIMITIVE
 
+/* An AST built in the arena takes the arena with it */
+static mpc_val_t *mpc_parse_output(mpc_input_t *i, mpc_val_t *x) {
+  x = mpc_export(i, x);
+  if (i->arena && x && mpc_arena_has(i->arena, x)) { i->arena = NULL; }
+  return x;
+}
+
 int mpc_parse_input(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r) {
   int x;
-  mpc_err_t *e = mpc_err_fail(i, "Unknown Error");
+  mpc_err_t *e = NULL;
+  mpc_state_t start = i->state;
+  char last = i->last;
+
+  /* Strings are parsed lazily first, and only
+  ** parsed again for errors if that fails */
+  i->furthest = -1;
+  if (i->type == MPC_INPUT_STRING) {
+    i->lazy = 1;
+    x = mpc_parse_run(i, p, r, &e, 0);
+    i->lazy = 0;
+    if (x) {
+      r->output = mpc_parse_output(i, r->output);
+      return x;
+    }
+    i->state = start;
+    i->last = last;
+  }
+
+  e = mpc_err_fail(i, "Unknown Error");
   e->state = mpc_state_invalid();
+  i->prune = 1;
   x = mpc_parse_run(i, p, r, &e, 0);
+  i->prune = 0;
   if (x) {
     mpc_err_delete_internal(i, e);
-    r->output = mpc_export(i, r->output);
+    r->output = mpc_parse_output(i, r->output);
   } else {
     r->error = mpc_err_export(i, mpc_err_merge(i, e, r->error));
   }
@@ -1319,16 +1858,26 @@ int mpc_parse_input(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r) {
 }
 
 int mpc_parse(const char *filename, const char *string, mpc_parser_t *p, mpc_result_t *r) {
+  return mpc_parse_with(filename, string, p, r, MPC_PARSE_DEFAULT);
+}
+
+int mpc_parse_with(const char *filename, const char *string, mpc_parser_t *p, mpc_result_t *r, int flags) {
   int x;
   mpc_input_t *i = mpc_input_new_string(filename, string);
+  i->flags = flags;
   x = mpc_parse_input(i, p, r);
   mpc_input_delete(i);
   return x;
 }
 
 int mpc_nparse(const char *filename, const char *string, size_t length, mpc_parser_t *p, mpc_result_t *r) {
+  return mpc_nparse_with(filename, string, length, p, r, MPC_PARSE_DEFAULT);
+}
+
+int mpc_nparse_with(const char *filename, const char *string, size_t length, mpc_parser_t *p, mpc_result_t *r, int flags) {
   int x;
   mpc_input_t *i = mpc_input_new_nstring(filename, string, length);
+  i->flags = flags;
   x = mpc_parse_input(i, p, r);
   mpc_input_delete(i);
   return x;
@@ -1351,9 +1900,33 @@ int mpc_parse_pipe(const char *filename, FILE *pipe, mpc_parser_t *p, mpc_result
 }
 
 int mpc_parse_contents(const char *filename, mpc_parser_t *p, mpc_result_t *r) {
+  return mpc_parse_contents_with(filename, p, r, MPC_PARSE_DEFAULT);
+}
 
-  FILE *f = fopen(filename, "rb");
+int mpc_parse_contents_with(const char *filename, mpc_parser_t *p, mpc_result_t *r, int flags) {
+
+  FILE *f;
   int res;
+  mpc_input_t *i;
+
+#ifdef MPC_MMAP
+  /* Map regular files and parse them as a string, rather than reading
+  ** them a character at a time with seeks to backtrack */
+  int fd = open(filename, O_RDONLY);
+  struct stat st;
+  if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void *m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (m != MAP_FAILED) {
+      close(fd);
+      res = mpc_nparse_with(filename, m, st.st_size, p, r, flags);
+      munmap(m, st.st_size);
+      return res;
+    }
+  }
+  if (fd >= 0) { close(fd); }
+#endif
+
+  f = fopen(filename, "rb");
 
   if (f == NULL) {
     r->output = NULL;
@@ -1361,7 +1934,10 @@ int mpc_parse_contents(const char *filename, mpc_parser_t *p, mpc_result_t *r) {
     return 0;
   }
 
-  res = mpc_parse_file(filename, f, p, r);
+  i = mpc_input_new_file(filename, f);
+  i->flags = flags;
+  res = mpc_parse_input(i, p, r);
+  mpc_input_delete(i);
   fclose(f);
   return res;
 }
@@ -1379,6 +1955,7 @@ static void mpc_undefine_or(mpc_parser_t *p) {
     mpc_undefine_unretained(p->data.or.xs[i], 0);
   }
   free(p->data.or.xs);
+  free(p->data.or.first);
 
 }
 
@@ -1440,6 +2017,11 @@ static void mpc_undefine_unretained(mpc_parser_t *p, int force) {
       free(p->data.check_with.e);
       break;
 
+    case MPC_TYPE_DFA:
+      mpc_undefine_unretained(p->data.dfa.x, 0);
+      mpc_dfa_delete(p->data.dfa.d);
+      break;
+
     default: break;
   }
 
@@ -1493,6 +2075,7 @@ mpc_parser_t *mpc_copy(mpc_parser_t *a) {
 
   p = mpc_undefined();
   p->retained = a->retained;
+  p->id = a->id;
   p->type = a->type;
   p->data = a->data;
 
@@ -1541,6 +2124,10 @@ mpc_parser_t *mpc_copy(mpc_parser_t *a) {
       for (i = 0; i < a->data.or.n; i++) {
         p->data.or.xs[i] = mpc_copy(a->data.or.xs[i]);
       }
+      if (a->data.or.first) {
+        p->data.or.first = malloc(a->data.or.n * MPC_FIRST_BYTES);
+        memcpy(p->data.or.first, a->data.or.first, a->data.or.n * MPC_FIRST_BYTES);
+      }
     break;
     case MPC_TYPE_AND:
       p->data.and.xs = malloc(a->data.and.n * sizeof(mpc_parser_t*));
@@ -1564,6 +2151,11 @@ mpc_parser_t *mpc_copy(mpc_parser_t *a) {
       strcpy(p->data.check_with.e, a->data.check_with.e);
       break;
 
+    case MPC_TYPE_DFA:
+      p->data.dfa.x = mpc_copy(a->data.dfa.x);
+      p->data.dfa.d = mpc_dfa_copy(a->data.dfa.d);
+      break;
+
     default: break;
   }
 
@@ -1935,6 +2527,7 @@ mpc_parser_t *mpc_or(int n, ...) {
   p->type = MPC_TYPE_OR;
   p->data.or.n = n;
   p->data.or.xs = malloc(sizeof(mpc_parser_t*) * n);
+  p->data.or.first = NULL;
 
   va_start(va, n);
   for (i = 0; i < n; i++) {
@@ -2350,42 +2943,589 @@ static mpc_val_t *mpcf_re_range(mpc_val_t *x) {
   return out;
 }
 
-mpc_parser_t *mpc_re(const char *re) {
-  return mpc_re_mode(re, MPC_RE_DEFAULT);
-}
+/*
+** Regex DFA
+**
+** Regexes made only of characters, ranges and the
+** `*`, `+`, `?` and `|` operators are also compiled
+** to a table-driven DFA, so a token can be matched
+** with one table lookup per character.
+**
+** Regexes here are PEGs: choice is ordered and the
+** repetitions are greedy and never give characters
+** back. To keep those semantics the regex is first
+** compiled to a small backtracking program, where a
+** choice pushes an alternative that a commit later
+** pops. A DFA state is a state of this program with
+** every alternative on its stack replaced by the
+** state it would now be in had it been taken where
+** it was pushed. Such an alternative has its own
+** copy of the stack below it, so states are trees,
+** and failing is just carrying on with the top one.
+**
+** An alternative that reaches the end of the program
+** keeps the position it matched up to in a register,
+** which is used if the alternative is ever taken.
+**
+** The DFA only runs while errors are suppressed or
+** the parse is lazy, as the errors of the original
+** parsers are not kept, and regexes that are too
+** complex to compile keep using their parsers alone.
+*/
 
-mpc_parser_t *mpc_re_mode(const char *re, int mode) {
+enum {
+  MPC_RE_OP_CLASS  = 0,
+  MPC_RE_OP_CHOICE = 1,
+  MPC_RE_OP_COMMIT = 2,
+  MPC_RE_OP_JUMP   = 3,
+  MPC_RE_OP_MATCH  = 4
+};
 
-  char *err_msg;
-  mpc_parser_t *err_out;
-  mpc_result_t r;
-  mpc_parser_t *Regex, *Term, *Factor, *Base, *Range, *RegexEnclose;
+enum {
+  MPC_DFA_PROG_MAX   = 512,
+  MPC_DFA_SETS_MAX   = 64,
+  MPC_DFA_STATES_MAX = 256,
+  MPC_DFA_NODES_MAX  = 64,
+  MPC_DFA_KEY_MAX    = 128,
+  MPC_DFA_STACK_MAX  = 16,
+  MPC_DFA_STEPS_MAX  = 4096,
+  MPC_DFA_REGS_MAX   = 4,
+  MPC_DFA_ACTS_MAX   = 256
+};
 
-  Regex  = mpc_new("regex");
-  Term   = mpc_new("term");
-  Factor = mpc_new("factor");
-  Base   = mpc_new("base");
-  Range  = mpc_new("range");
+/* Special states, normal states follow */
+enum {
+  MPC_DFA_FAIL  = 0,
+  MPC_DFA_DONE  = 1,
+  MPC_DFA_FIRST = 2
+};
 
-  mpc_define(Regex, mpc_and(2, mpcf_re_or,
-    Term,
-    mpc_maybe(mpc_and(2, mpcf_snd_free, mpc_char('|'), Regex, free)),
-    (mpc_dtor_t)mpc_delete
-  ));
+/* Nodes that have stopped running */
+enum {
+  MPC_DFA_NODE_DEAD = -1,
+  MPC_DFA_NODE_DONE = -2
+};
 
-  mpc_define(Term, mpc_many(mpcf_re_and, Factor));
+/* Register source meaning the current position */
+enum { MPC_DFA_REG_NOW = -1 };
 
-  mpc_define(Factor, mpc_and(2, mpcf_re_repeat,
-    Base,
-    mpc_or(5,
-      mpc_char('*'), mpc_char('+'), mpc_char('?'),
-      mpc_brackets(mpc_int(), free),
-      mpc_pass()),
-    (mpc_dtor_t)mpc_delete
-  ));
+typedef struct {
+  int num;
+  int op[MPC_DFA_PROG_MAX];
+  int arg[MPC_DFA_PROG_MAX];
+  int sets_num;
+  char sets[MPC_DFA_SETS_MAX][256];
+  int nodes;
+  int steps;
+  int failed;
+} mpc_re_prog_t;
+
+typedef struct mpc_dfa_node_t {
+  int pc;
+  int reg;
+  int stack_num;
+  struct mpc_dfa_node_t *stack[MPC_DFA_STACK_MAX];
+} mpc_dfa_node_t;
 
-  mpc_define(Base, mpc_or(4,
-    mpc_parens(Regex, (mpc_dtor_t)mpc_delete),
+typedef struct {
+  int num;
+  int xs[MPC_DFA_KEY_MAX];
+} mpc_dfa_key_t;
+
+struct mpc_dfa_t {
+  int start;
+  int start_act;
+  int states_num;
+  int classes_num;
+  int acts_num;
+  unsigned char classes[256];
+  short *next;
+  unsigned char *act;
+  signed char *acts;
+};
+
+static int mpc_re_prog_emit(mpc_re_prog_t *g, int op, int arg) {
+  if (g->num == MPC_DFA_PROG_MAX) { return -1; }
+  g->op[g->num] = op;
+  g->arg[g->num] = arg;
+  return g->num++;
+}
+
+/* Whether a single character parser accepts x */
+static int mpc_class_has(mpc_parser_t *p, char x) {
+  switch (p->type) {
+    case MPC_TYPE_ANY:     return 1;
+    case MPC_TYPE_SINGLE:  return x == p->data.single.x;
+    case MPC_TYPE_RANGE:   return x >= p->data.range.x && x <= p->data.range.y;
+    case MPC_TYPE_ONEOF:   return strchr(p->data.string.x, x) != 0;
+    case MPC_TYPE_NONEOF:  return strchr(p->data.string.x, x) == 0;
+    case MPC_TYPE_SATISFY: return p->data.satisfy.f(x) != 0;
+    default: return 0;
+  }
+}
+
+/* Byte 0 is never in a set as it ends the input */
+static int mpc_re_prog_class(mpc_re_prog_t *g, mpc_parser_t *p) {
+  int j;
+  char *s;
+
+  if (g->sets_num == MPC_DFA_SETS_MAX) { return 0; }
+  s = g->sets[g->sets_num];
+  s[0] = 0;
+
+  for (j = 1; j < 256; j++) { s[j] = mpc_class_has(p, (char)j); }
+
+  return mpc_re_prog_emit(g, MPC_RE_OP_CLASS, g->sets_num++) >= 0;
+}
+
+/* Returns 0 for parsers the DFA can't reproduce */
+static int mpc_re_prog_compile(mpc_re_prog_t *g, mpc_parser_t *p) {
+
+  int j, c, l, next, last = -1;
+
+  switch (p->type) {
+
+    case MPC_TYPE_ANY:
+    case MPC_TYPE_SINGLE:
+    case MPC_TYPE_RANGE:
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+    case MPC_TYPE_SATISFY:
+      return mpc_re_prog_class(g, p);
+
+    case MPC_TYPE_EXPECT: return mpc_re_prog_compile(g, p->data.expect.x);
+    case MPC_TYPE_LIFT: return p->data.lift.lf == mpcf_ctor_str;
+
+    case MPC_TYPE_AND:
+      if (p->data.and.n == 0 || p->data.and.f != mpcf_strfold) { return 0; }
+      for (j = 0; j < p->data.and.n; j++) {
+        if (!mpc_re_prog_compile(g, p->data.and.xs[j])) { return 0; }
+      }
+      return 1;
+
+    /* Commits to the end are chained through their
+    ** targets and patched once the end is known */
+    case MPC_TYPE_OR:
+      if (p->data.or.n == 0) { return 0; }
+      for (j = 0; j < p->data.or.n-1; j++) {
+        if ((c = mpc_re_prog_emit(g, MPC_RE_OP_CHOICE, 0)) < 0) { return 0; }
+        if (!mpc_re_prog_compile(g, p->data.or.xs[j])) { return 0; }
+        if ((last = mpc_re_prog_emit(g, MPC_RE_OP_COMMIT, last)) < 0) { return 0; }
+        g->arg[c] = g->num;
+      }
+      if (!mpc_re_prog_compile(g, p->data.or.xs[j])) { return 0; }
+      while (last >= 0) {
+        next = g->arg[last];
+        g->arg[last] = g->num;
+        last = next;
+      }
+      return 1;
+
+    case MPC_TYPE_MAYBE:
+      if (p->data.not.lf != mpcf_ctor_str) { return 0; }
+      if ((c = mpc_re_prog_emit(g, MPC_RE_OP_CHOICE, 0)) < 0) { return 0; }
+      if (!mpc_re_prog_compile(g, p->data.not.x)) { return 0; }
+      if (mpc_re_prog_emit(g, MPC_RE_OP_COMMIT, g->num+1) < 0) { return 0; }
+      g->arg[c] = g->num;
+      return 1;
+
+    case MPC_TYPE_MANY1:
+      if (!mpc_re_prog_compile(g, p->data.repeat.x)) { return 0; }
+      /* Fallthrough */
+    case MPC_TYPE_MANY:
+      if (p->data.repeat.f != mpcf_strfold) { return 0; }
+      l = g->num;
+      if ((c = mpc_re_prog_emit(g, MPC_RE_OP_CHOICE, 0)) < 0) { return 0; }
+      if (!mpc_re_prog_compile(g, p->data.repeat.x)) { return 0; }
+      if (mpc_re_prog_emit(g, MPC_RE_OP_COMMIT, l) < 0) { return 0; }
+      g->arg[c] = g->num;
+      return 1;
+
+    default: return 0;
+  }
+
+}
+
+/* Building gives up once states grow too large */
+static mpc_dfa_node_t *mpc_dfa_node_new(mpc_re_prog_t *g, int pc) {
+  mpc_dfa_node_t *n = malloc(sizeof(mpc_dfa_node_t));
+  n->pc = pc;
+  n->reg = 0;
+  n->stack_num = 0;
+  if (++g->nodes > MPC_DFA_NODES_MAX * 2) { g->failed = 1; }
+  return n;
+}
+
+static void mpc_dfa_node_delete(mpc_re_prog_t *g, mpc_dfa_node_t *n) {
+  int j;
+  for (j = 0; j < n->stack_num; j++) { mpc_dfa_node_delete(g, n->stack[j]); }
+  g->nodes--;
+  free(n);
+}
+
+static mpc_dfa_node_t *mpc_dfa_node_copy(mpc_re_prog_t *g, mpc_dfa_node_t *n) {
+  int j;
+  mpc_dfa_node_t *c = mpc_dfa_node_new(g, n->pc);
+  c->reg = n->reg;
+  c->stack_num = n->stack_num;
+  for (j = 0; j < n->stack_num; j++) { c->stack[j] = mpc_dfa_node_copy(g, n->stack[j]); }
+  return c;
+}
+
+/* Runs a node up to its next character class */
+static mpc_dfa_node_t *mpc_dfa_closure(mpc_re_prog_t *g, mpc_dfa_node_t *n) {
+
+  int j;
+  mpc_dfa_node_t *a;
+
+  while (n->pc >= 0 && !g->failed) {
+
+    if (++g->steps > MPC_DFA_STEPS_MAX) { g->failed = 1; break; }
+
+    switch (g->op[n->pc]) {
+
+      case MPC_RE_OP_CLASS: return n;
+      case MPC_RE_OP_JUMP: n->pc = g->arg[n->pc]; break;
+
+      case MPC_RE_OP_MATCH:
+        for (j = 0; j < n->stack_num; j++) { mpc_dfa_node_delete(g, n->stack[j]); }
+        n->stack_num = 0;
+        n->pc = MPC_DFA_NODE_DONE;
+        n->reg = MPC_DFA_REG_NOW;
+        break;
+
+      case MPC_RE_OP_CHOICE:
+        if (n->stack_num == MPC_DFA_STACK_MAX) { g->failed = 1; break; }
+        a = mpc_dfa_node_new(g, g->arg[n->pc]);
+        a->stack_num = n->stack_num;
+        for (j = 0; j < n->stack_num; j++) { a->stack[j] = mpc_dfa_node_copy(g, n->stack[j]); }
+        n->stack[n->stack_num++] = mpc_dfa_closure(g, a);
+        n->pc++;
+        break;
+
+      case MPC_RE_OP_COMMIT:
+        if (n->stack_num == 0) { g->failed = 1; break; }
+        mpc_dfa_node_delete(g, n->stack[--n->stack_num]);
+        n->pc = g->arg[n->pc];
+        break;
+
+      default: g->failed = 1; break;
+    }
+  }
+
+  return n;
+}
+
+/* Moves a node and all its alternatives over one character */
+static mpc_dfa_node_t *mpc_dfa_step(mpc_re_prog_t *g, mpc_dfa_node_t *n, int c) {
+
+  int j;
+  mpc_dfa_node_t *a;
+
+  if (n->pc < 0) { return n; }
+
+  for (j = 0; j < n->stack_num; j++) { n->stack[j] = mpc_dfa_step(g, n->stack[j], c); }
+
+  if (g->sets[g->arg[n->pc]][c]) {
+    n->pc++;
+    return mpc_dfa_closure(g, n);
+  }
+
+  if (n->stack_num == 0) {
+    n->pc = MPC_DFA_NODE_DEAD;
+    return n;
+  }
+
+  a = n->stack[--n->stack_num];
+  mpc_dfa_node_delete(g, n);
+  return a;
+}
+
+/* Writes a node in preorder. Registers are renumbered in
+** order of first use and `srcs` records where each one
+** takes its value from, so equal states get equal keys. */
+static void mpc_dfa_key(mpc_re_prog_t *g, mpc_dfa_node_t *n, mpc_dfa_key_t *k, int *srcs, int *srcs_num) {
+
+  int j;
+
+  if (k->num + 2 > MPC_DFA_KEY_MAX) { g->failed = 1; return; }
+  k->xs[k->num++] = n->pc;
+
+  if (n->pc == MPC_DFA_NODE_DONE) {
+    for (j = 0; j < *srcs_num; j++) { if (srcs[j] == n->reg) { break; } }
+    if (j == *srcs_num) {
+      if (j == MPC_DFA_REGS_MAX) { g->failed = 1; return; }
+      srcs[(*srcs_num)++] = n->reg;
+    }
+    k->xs[k->num++] = j;
+    return;
+  }
+
+  if (n->pc == MPC_DFA_NODE_DEAD) { return; }
+
+  k->xs[k->num++] = n->stack_num;
+  for (j = 0; j < n->stack_num; j++) { mpc_dfa_key(g, n->stack[j], k, srcs, srcs_num); }
+}
+
+static mpc_dfa_node_t *mpc_dfa_unkey(mpc_re_prog_t *g, mpc_dfa_key_t *k, int *pos) {
+  int j;
+  mpc_dfa_node_t *n = mpc_dfa_node_new(g, k->xs[(*pos)++]);
+  if (n->pc == MPC_DFA_NODE_DONE) { n->reg = k->xs[(*pos)++]; }
+  if (n->pc >= 0) {
+    n->stack_num = k->xs[(*pos)++];
+    for (j = 0; j < n->stack_num; j++) { n->stack[j] = mpc_dfa_unkey(g, k, pos); }
+  }
+  return n;
+}
+
+static unsigned long mpc_dfa_key_hash(mpc_dfa_key_t *k) {
+  int j;
+  unsigned long h = 5381;
+  for (j = 0; j < k->num; j++) { h = h * 33 + (unsigned long)k->xs[j]; }
+  return h;
+}
+
+/* Returns the index of the register moves, adding them if new */
+static int mpc_dfa_act(mpc_dfa_t *d, int *srcs, int srcs_num) {
+
+  int j, k;
+  signed char a[MPC_DFA_REGS_MAX];
+
+  for (j = 0; j < MPC_DFA_REGS_MAX; j++) { a[j] = j < srcs_num ? srcs[j] : j; }
+
+  for (k = 0; k < d->acts_num; k++) {
+    if (memcmp(d->acts + k * MPC_DFA_REGS_MAX, a, MPC_DFA_REGS_MAX) == 0) { return k; }
+  }
+  if (d->acts_num == MPC_DFA_ACTS_MAX) { return -1; }
+  memcpy(d->acts + d->acts_num * MPC_DFA_REGS_MAX, a, MPC_DFA_REGS_MAX);
+  return d->acts_num++;
+}
+
+/* Finds or adds the state for a node, or returns -1 */
+static int mpc_dfa_state(mpc_re_prog_t *g, mpc_dfa_t *d, mpc_dfa_node_t *n,
+  mpc_dfa_key_t *keys, unsigned long *hashes, int *act) {
+
+  int j, srcs_num = 0, srcs[MPC_DFA_REGS_MAX];
+  unsigned long h;
+  mpc_dfa_key_t k;
+
+  k.num = 0;
+  mpc_dfa_key(g, n, &k, srcs, &srcs_num);
+  if (g->failed || (*act = mpc_dfa_act(d, srcs, srcs_num)) < 0) { return -1; }
+
+  if (n->pc == MPC_DFA_NODE_DEAD) { return MPC_DFA_FAIL; }
+  if (n->pc == MPC_DFA_NODE_DONE) { return MPC_DFA_DONE; }
+
+  h = mpc_dfa_key_hash(&k);
+  for (j = 0; j < d->states_num; j++) {
+    if (hashes[j] == h && keys[j].num == k.num
+    &&  memcmp(keys[j].xs, k.xs, sizeof(int) * k.num) == 0) { return MPC_DFA_FIRST + j; }
+  }
+
+  if (d->states_num == MPC_DFA_STATES_MAX) { return -1; }
+  keys[d->states_num] = k;
+  hashes[d->states_num] = h;
+  return MPC_DFA_FIRST + d->states_num++;
+}
+
+/* Bytes in exactly the same sets share a column of the table */
+static int mpc_dfa_classes(mpc_re_prog_t *g, unsigned char *classes, int *reps) {
+  int j, k, m, n = 0;
+  for (j = 0; j < 256; j++) {
+    for (k = 0; k < n; k++) {
+      for (m = 0; m < g->sets_num; m++) {
+        if (g->sets[m][j] != g->sets[m][reps[k]]) { break; }
+      }
+      if (m == g->sets_num) { break; }
+    }
+    if (k == n) { reps[n++] = j; }
+    classes[j] = k;
+  }
+  return n;
+}
+
+static void mpc_dfa_delete(mpc_dfa_t *d) {
+  free(d->next);
+  free(d->act);
+  free(d->acts);
+  free(d);
+}
+
+static mpc_dfa_t *mpc_dfa_build(mpc_re_prog_t *g) {
+
+  int j, s, t, a, pos, slots = 0;
+  int reps[256], ident[MPC_DFA_REGS_MAX];
+  mpc_dfa_node_t *n;
+  mpc_dfa_key_t *keys = malloc(sizeof(mpc_dfa_key_t) * MPC_DFA_STATES_MAX);
+  unsigned long *hashes = malloc(sizeof(unsigned long) * MPC_DFA_STATES_MAX);
+  mpc_dfa_t *d = malloc(sizeof(mpc_dfa_t));
+
+  d->states_num = 0;
+  d->classes_num = mpc_dfa_classes(g, d->classes, reps);
+  d->next = NULL;
+  d->act = NULL;
+  d->acts_num = 0;
+  d->acts = malloc(MPC_DFA_ACTS_MAX * MPC_DFA_REGS_MAX);
+
+  /* Moves 0 leave every register as it is */
+  for (j = 0; j < MPC_DFA_REGS_MAX; j++) { ident[j] = j; }
+  mpc_dfa_act(d, ident, MPC_DFA_REGS_MAX);
+
+  g->nodes = 0;
+  g->steps = 0;
+  g->failed = 0;
+
+  n = mpc_dfa_closure(g, mpc_dfa_node_new(g, 0));
+  d->start = mpc_dfa_state(g, d, n, keys, hashes, &d->start_act);
+  mpc_dfa_node_delete(g, n);
+  if (d->start < 0) { goto fail; }
+
+  for (s = 0; s < d->states_num; s++) {
+
+    if (d->states_num > slots) {
+      slots = d->states_num * 2;
+      d->next = realloc(d->next, sizeof(short) * slots * d->classes_num);
+      d->act = realloc(d->act, slots * d->classes_num);
+    }
+
+    for (j = 0; j < d->classes_num; j++) {
+      g->steps = 0;
+      pos = 0;
+      n = mpc_dfa_step(g, mpc_dfa_unkey(g, &keys[s], &pos), reps[j]);
+      t = mpc_dfa_state(g, d, n, keys, hashes, &a);
+      mpc_dfa_node_delete(g, n);
+      if (t < 0) { goto fail; }
+      d->next[s * d->classes_num + j] = t;
+      d->act[s * d->classes_num + j] = a;
+    }
+  }
+
+  free(keys);
+  free(hashes);
+  return d;
+
+fail:
+  free(keys);
+  free(hashes);
+  mpc_dfa_delete(d);
+  return NULL;
+}
+
+/* Wraps a regex parser with its DFA if one can be built */
+static mpc_parser_t *mpc_re_dfa(mpc_parser_t *a) {
+
+  mpc_parser_t *p;
+  mpc_dfa_t *d;
+  mpc_re_prog_t *g = malloc(sizeof(mpc_re_prog_t));
+  g->num = 0;
+  g->sets_num = 0;
+
+  d = mpc_re_prog_compile(g, a) && mpc_re_prog_emit(g, MPC_RE_OP_MATCH, 0) >= 0
+    ? mpc_dfa_build(g) : NULL;
+  free(g);
+
+  if (d == NULL) { return a; }
+
+  p = mpc_undefined();
+  p->type = MPC_TYPE_DFA;
+  p->data.dfa.x = a;
+  p->data.dfa.d = d;
+  return p;
+}
+
+static void mpc_dfa_apply(mpc_dfa_t *d, int a, long *regs, long n) {
+  int j;
+  long old[MPC_DFA_REGS_MAX];
+  signed char *srcs = d->acts + a * MPC_DFA_REGS_MAX;
+  memcpy(old, regs, sizeof(old));
+  for (j = 0; j < MPC_DFA_REGS_MAX; j++) {
+    regs[j] = srcs[j] == MPC_DFA_REG_NOW ? n : old[(int)srcs[j]];
+  }
+}
+
+static int mpc_dfa_match(mpc_input_t *i, mpc_dfa_t *d, char **o) {
+
+  const char *s = i->string + i->state.pos;
+  long j, n = 0, regs[MPC_DFA_REGS_MAX] = {0};
+  int st = d->start, t;
+
+  mpc_dfa_apply(d, d->start_act, regs, 0);
+
+  while (st >= MPC_DFA_FIRST) {
+    t = (st - MPC_DFA_FIRST) * d->classes_num + d->classes[(unsigned char)s[n]];
+    n++;
+    if (d->act[t]) { mpc_dfa_apply(d, d->act[t], regs, n); }
+    st = d->next[t];
+  }
+
+  if (st == MPC_DFA_FAIL) { return 0; }
+  n = regs[0];
+
+  for (j = 0; j < n; j++) {
+    i->state.col++;
+    if (s[j] == '\n') {
+      i->state.col = 0;
+      i->state.row++;
+    }
+  }
+  if (n > 0) { i->last = s[n-1]; }
+  i->state.pos += n;
+
+  *o = mpc_malloc(i, n + 1);
+  memcpy(*o, s, n);
+  (*o)[n] = '\0';
+  return 1;
+}
+
+static mpc_dfa_t *mpc_dfa_copy(mpc_dfa_t *d) {
+  size_t cells = (size_t)d->states_num * d->classes_num;
+  mpc_dfa_t *c = malloc(sizeof(mpc_dfa_t));
+  memcpy(c, d, sizeof(mpc_dfa_t));
+  c->next = malloc(sizeof(short) * cells + 1);
+  c->act = malloc(cells + 1);
+  c->acts = malloc(MPC_DFA_ACTS_MAX * MPC_DFA_REGS_MAX);
+  memcpy(c->next, d->next, sizeof(short) * cells);
+  memcpy(c->act, d->act, cells);
+  memcpy(c->acts, d->acts, MPC_DFA_ACTS_MAX * MPC_DFA_REGS_MAX);
+  return c;
+}
+
+mpc_parser_t *mpc_re(const char *re) {
+  return mpc_re_mode(re, MPC_RE_DEFAULT);
+}
+
+mpc_parser_t *mpc_re_mode(const char *re, int mode) {
+
+  char *err_msg;
+  mpc_parser_t *err_out;
+  mpc_result_t r;
+  mpc_parser_t *Regex, *Term, *Factor, *Base, *Range, *RegexEnclose;
+
+  Regex  = mpc_new("regex");
+  Term   = mpc_new("term");
+  Factor = mpc_new("factor");
+  Base   = mpc_new("base");
+  Range  = mpc_new("range");
+
+  mpc_define(Regex, mpc_and(2, mpcf_re_or,
+    Term,
+    mpc_maybe(mpc_and(2, mpcf_snd_free, mpc_char('|'), Regex, free)),
+    (mpc_dtor_t)mpc_delete
+  ));
+
+  mpc_define(Term, mpc_many(mpcf_re_and, Factor));
+
+  mpc_define(Factor, mpc_and(2, mpcf_re_repeat,
+    Base,
+    mpc_or(5,
+      mpc_char('*'), mpc_char('+'), mpc_char('?'),
+      mpc_brackets(mpc_int(), free),
+      mpc_pass()),
+    (mpc_dtor_t)mpc_delete
+  ));
+
+  mpc_define(Base, mpc_or(4,
+    mpc_parens(Regex, (mpc_dtor_t)mpc_delete),
     mpc_squares(Range, (mpc_dtor_t)mpc_delete),
     mpc_apply_to(mpc_escape(), mpcf_re_escape, &mode),
     mpc_apply_to(mpc_noneof(")|"), mpcf_re_escape, &mode)
@@ -2417,7 +3557,7 @@ mpc_parser_t *mpc_re_mode(const char *re, int mode) {
 
   mpc_optimise(r.output);
 
-  return r.output;
+  return mpc_re_dfa(r.output);
 
 }
 
@@ -2770,6 +3910,7 @@ static void mpc_print_unretained(mpc_parser_t *p, int force) {
   if (p->type == MPC_TYPE_APPLY)    { mpc_print_unretained(p->data.apply.x, 0); }
   if (p->type == MPC_TYPE_APPLY_TO) { mpc_print_unretained(p->data.apply_to.x, 0); }
   if (p->type == MPC_TYPE_PREDICT)  { mpc_print_unretained(p->data.predict.x, 0); }
+  if (p->type == MPC_TYPE_DFA)      { mpc_print_unretained(p->data.dfa.x, 0); }
 
   if (p->type == MPC_TYPE_NOT)   { mpc_print_unretained(p->data.not.x, 0); printf("!"); }
   if (p->type == MPC_TYPE_MAYBE) { mpc_print_unretained(p->data.not.x, 0); printf("?"); }
@@ -2889,6 +4030,7 @@ void mpc_ast_delete(mpc_ast_t *a) {
   int i;
 
   if (a == NULL) { return; }
+  if (a->arena) { mpc_arena_delete(a->arena); return; }
 
   for (i = 0; i < a->children_num; i++) {
     mpc_ast_delete(a->children[i]);
@@ -2902,6 +4044,7 @@ void mpc_ast_delete(mpc_ast_t *a) {
 }
 
 static void mpc_ast_delete_no_children(mpc_ast_t *a) {
+  if (a->arena) { return; }
   free(a->children);
   free(a->tag);
   free(a->contents);
@@ -2922,10 +4065,86 @@ mpc_ast_t *mpc_ast_new(const char *tag, const char *contents) {
 
   a->children_num = 0;
   a->children = NULL;
+  a->arena = NULL;
+  a->rule = 0;
+  a->rules = 0;
+  return a;
+
+}
+
+/*
+** Arena nodes are allocated together with their tag
+** and contents. Tags changed later are copied into
+** the arena too, and the old ones are left unused.
+*/
+
+static mpc_ast_t *mpc_ast_new_arena(mpc_arena_t *m, const char *tag, const char *contents) {
+
+  size_t t = strlen(tag) + 1;
+  size_t c = strlen(contents) + 1;
+  mpc_ast_t *a = mpc_arena_alloc(m, sizeof(mpc_ast_t) + t + c);
+
+  a->tag = memcpy((char*)(a + 1), tag, t);
+  a->contents = memcpy(a->tag + t, contents, c);
+  a->state = mpc_state_new();
+  a->children_num = 0;
+  a->children = NULL;
+  a->arena = m;
+  a->rule = 0;
+  a->rules = 0;
   return a;
 
 }
 
+static mpc_ast_t *mpc_ast_copy_arena(mpc_arena_t *m, mpc_ast_t *a) {
+
+  int i;
+  mpc_ast_t *c;
+
+  if (a == NULL) { return a; }
+
+  c = mpc_ast_new_arena(m, a->tag, a->contents);
+  c->state = a->state;
+  c->rule = a->rule;
+  c->rules = a->rules;
+  c->children_num = a->children_num;
+  c->children = a->children_num ? mpc_arena_alloc(m, sizeof(mpc_ast_t*) * a->children_num) : NULL;
+  for (i = 0; i < a->children_num; i++) {
+    c->children[i] = mpc_ast_copy_arena(m, a->children[i]);
+  }
+  return c;
+
+}
+
+/* Moves a malloced tree into an arena */
+static mpc_ast_t *mpc_ast_adopt(mpc_arena_t *m, mpc_ast_t *a) {
+  mpc_ast_t *c;
+  if (a == NULL || a->arena) { return a; }
+  c = mpc_ast_copy_arena(m, a);
+  mpc_ast_delete(a);
+  return c;
+}
+
+mpc_ast_t *mpc_ast_copy(mpc_ast_t *a) {
+
+  int i;
+  mpc_ast_t *c;
+
+  if (a == NULL) { return a; }
+
+  c = mpc_ast_new(a->tag, a->contents);
+  c->state = a->state;
+  c->rule = a->rule;
+  c->rules = a->rules;
+  c->children_num = a->children_num;
+  c->children = a->children_num ? malloc(sizeof(mpc_ast_t*) * a->children_num) : NULL;
+  for (i = 0; i < a->children_num; i++) {
+    c->children[i] = mpc_ast_copy(a->children[i]);
+  }
+  return c;
+
+}
+
 mpc_ast_t *mpc_ast_build(int n, const char *tag, ...) {
 
   mpc_ast_t *a = mpc_ast_new(tag, "");
@@ -2952,7 +4171,7 @@ mpc_ast_t *mpc_ast_add_root(mpc_ast_t *a) {
   if (a->children_num == 0) { return a; }
   if (a->children_num == 1) { return a; }
 
-  r = mpc_ast_new(">", "");
+  r = a->arena ? mpc_ast_new_arena(a->arena, ">", "") : mpc_ast_new(">", "");
   mpc_ast_add_child(r, a);
   return r;
 }
@@ -2973,6 +4192,14 @@ int mpc_ast_eq(mpc_ast_t *a, mpc_ast_t *b) {
 }
 
 mpc_ast_t *mpc_ast_add_child(mpc_ast_t *r, mpc_ast_t *a) {
+  mpc_ast_t **cs;
+  if (r->arena) {
+    cs = mpc_arena_alloc(r->arena, sizeof(mpc_ast_t*) * (r->children_num + 1));
+    if (r->children_num) { memcpy(cs, r->children, sizeof(mpc_ast_t*) * r->children_num); }
+    r->children = cs;
+    r->children[r->children_num++] = mpc_ast_adopt(r->arena, a);
+    return r;
+  }
   r->children_num++;
   r->children = realloc(r->children, sizeof(mpc_ast_t*) * r->children_num);
   r->children[r->children_num-1] = a;
@@ -2980,7 +4207,16 @@ mpc_ast_t *mpc_ast_add_child(mpc_ast_t *r, mpc_ast_t *a) {
 }
 
 mpc_ast_t *mpc_ast_add_tag(mpc_ast_t *a, const char *t) {
+  char *tag;
   if (a == NULL) { return a; }
+  if (a->arena) {
+    tag = mpc_arena_alloc(a->arena, strlen(t) + 1 + strlen(a->tag) + 1);
+    strcpy(tag, t);
+    strcat(tag, "|");
+    strcat(tag, a->tag);
+    a->tag = tag;
+    return a;
+  }
   a->tag = realloc(a->tag, strlen(t) + 1 + strlen(a->tag) + 1);
   memmove(a->tag + strlen(t) + 1, a->tag, strlen(a->tag)+1);
   memmove(a->tag, t, strlen(t));
@@ -2989,14 +4225,33 @@ mpc_ast_t *mpc_ast_add_tag(mpc_ast_t *a, const char *t) {
 }
 
 mpc_ast_t *mpc_ast_add_root_tag(mpc_ast_t *a, const char *t) {
+  char *tag;
   if (a == NULL) { return a; }
+  if (a->arena) {
+    tag = mpc_arena_alloc(a->arena, (strlen(t)-1) + strlen(a->tag) + 1);
+    memcpy(tag, t, strlen(t)-1);
+    strcpy(tag + (strlen(t)-1), a->tag);
+    a->tag = tag;
+    return a;
+  }
   a->tag = realloc(a->tag, (strlen(t)-1) + strlen(a->tag) + 1);
   memmove(a->tag + (strlen(t)-1), a->tag, strlen(a->tag)+1);
   memmove(a->tag, t, (strlen(t)-1));
   return a;
 }
 
+/* The only child of a node, taking on its tags and rules */
+static mpc_ast_t *mpc_ast_lift(mpc_ast_t *a) {
+  mpc_ast_t *c = mpc_ast_add_root_tag(a->children[0], a->tag);
+  c->rules |= a->rules;
+  if (c->rule == 0) { c->rule = a->rule; }
+  return c;
+}
+
 mpc_ast_t *mpc_ast_tag(mpc_ast_t *a, const char *t) {
+  a->rule = 0;
+  a->rules = 0;
+  if (a->arena) { a->tag = mpc_arena_str(a->arena, t); return a; }
   a->tag = realloc(a->tag, strlen(t) + 1);
   strcpy(a->tag, t);
   return a;
@@ -3230,7 +4485,7 @@ mpc_val_t *mpcf_fold_ast(int n, mpc_val_t **xs) {
     if        (as[i] && as[i]->children_num == 0) {
       mpc_ast_add_child(r, as[i]);
     } else if (as[i] && as[i]->children_num == 1) {
-      mpc_ast_add_child(r, mpc_ast_add_root_tag(as[i]->children[0], as[i]->tag));
+      mpc_ast_add_child(r, mpc_ast_lift(as[i]));
       mpc_ast_delete_no_children(as[i]);
     } else if (as[i] && as[i]->children_num >= 2) {
       for (j = 0; j < as[i]->children_num; j++) {
@@ -3295,6 +4550,7 @@ mpc_parser_t *mpca_or(int n, ...) {
   p->type = MPC_TYPE_OR;
   p->data.or.n = n;
   p->data.or.xs = malloc(sizeof(mpc_parser_t*) * n);
+  p->data.or.first = NULL;
 
   va_start(va, n);
   for (i = 0; i < n; i++) {
@@ -3474,6 +4730,7 @@ static mpc_parser_t *mpca_grammar_find_parser(char *x, mpca_grammar_st_t *st) {
       if (st->parsers[st->parsers_num-1] == NULL) {
         return mpc_failf("No Parser in position %i! Only supplied %i Parsers!", i, st->parsers_num);
       }
+      st->parsers[st->parsers_num-1]->id = st->parsers_num;
     }
 
     return st->parsers[st->parsers_num-1];
@@ -3498,6 +4755,7 @@ static mpc_parser_t *mpca_grammar_find_parser(char *x, mpca_grammar_st_t *st) {
       st->parsers[st->parsers_num-1] = p;
 
       if (p == NULL || p->name == NULL) { return mpc_failf("Unknown Parser '%s'!", x); }
+      p->id = st->parsers_num;
       if (p->name && strcmp(p->name, x) == 0) { return p; }
 
     }
@@ -3506,6 +4764,16 @@ static mpc_parser_t *mpca_grammar_find_parser(char *x, mpca_grammar_st_t *st) {
 
 }
 
+/* Tags a node with the name and number of the rule it came from */
+static mpc_val_t *mpcaf_grammar_rule(mpc_val_t *x, void *s) {
+  mpc_parser_t *p = s;
+  mpc_ast_t *a = mpc_ast_add_tag(x, p->name);
+  if (a == NULL) { return a; }
+  if (a->rule == 0) { a->rule = p->id; }
+  if (p->id > 0 && p->id < MPC_RULES_MAX) { a->rules |= 1ul << p->id; }
+  return a;
+}
+
 static mpc_val_t *mpcaf_grammar_id(mpc_val_t *x, void *s) {
 
   mpca_grammar_st_t *st = s;
@@ -3513,7 +4781,7 @@ static mpc_val_t *mpcaf_grammar_id(mpc_val_t *x, void *s) {
   free(x);
 
   if (p->name) {
-    return mpca_state(mpca_root(mpca_add_tag(p, p->name)));
+    return mpca_state(mpca_root(mpc_apply_to(p, mpcaf_grammar_rule, p)));
   } else {
     return mpca_state(mpca_root(p));
   }
@@ -3650,8 +4918,11 @@ static void mpca_stmt_list_delete(mpc_val_t *x) {
 
 }
 
+static void mpc_first_unretained(mpc_parser_t *p, int force);
+
 static mpc_val_t *mpca_stmt_list_apply_to(mpc_val_t *x, void *s) {
 
+  int i;
   mpca_grammar_st_t *st = s;
   mpca_stmt_t *stmt;
   mpca_stmt_t **stmts = x;
@@ -3670,6 +4941,12 @@ static mpc_val_t *mpca_stmt_list_apply_to(mpc_val_t *x, void *s) {
     stmts++;
   }
 
+  /* Rules can refer to rules defined after them, so
+  ** first sets are only complete once all are defined */
+  for (i = 0; i < st->parsers_num; i++) {
+    if (st->parsers[i]) { mpc_first_unretained(st->parsers[i], 1); }
+  }
+
   free(x);
 
   return NULL;
@@ -3856,6 +5133,7 @@ static int mpc_nodecount_unretained(mpc_parser_t* p, int force) {
   if (p->type == MPC_TYPE_APPLY)    { return 1 + mpc_nodecount_unretained(p->data.apply.x, 0); }
   if (p->type == MPC_TYPE_APPLY_TO) { return 1 + mpc_nodecount_unretained(p->data.apply_to.x, 0); }
   if (p->type == MPC_TYPE_PREDICT)  { return 1 + mpc_nodecount_unretained(p->data.predict.x, 0); }
+  if (p->type == MPC_TYPE_DFA)      { return 1 + mpc_nodecount_unretained(p->data.dfa.x, 0); }
 
   if (p->type == MPC_TYPE_CHECK)    { return 1 + mpc_nodecount_unretained(p->data.check.x, 0); }
   if (p->type == MPC_TYPE_CHECK_WITH) { return 1 + mpc_nodecount_unretained(p->data.check_with.x, 0); }
@@ -3939,7 +5217,8 @@ static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
       p->data.or.n = n + m - 1;
       p->data.or.xs = realloc(p->data.or.xs, sizeof(mpc_parser_t*) * (n + m -1));
       memmove(p->data.or.xs + n - 1, t->data.or.xs, m * sizeof(mpc_parser_t*));
-      free(t->data.or.xs); free(t->name); free(t);
+      free(p->data.or.first); p->data.or.first = NULL;
+      free(t->data.or.xs); free(t->data.or.first); free(t->name); free(t);
       continue;
     }
 
@@ -3953,7 +5232,8 @@ static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
       p->data.or.xs = realloc(p->data.or.xs, sizeof(mpc_parser_t*) * (n + m -1));
       memmove(p->data.or.xs + m, p->data.or.xs + 1, (n - 1) * sizeof(mpc_parser_t*));
       memmove(p->data.or.xs, t->data.or.xs, m * sizeof(mpc_parser_t*));
-      free(t->data.or.xs); free(t->name); free(t);
+      free(p->data.or.first); p->data.or.first = NULL;
+      free(t->data.or.xs); free(t->data.or.first); free(t->name); free(t);
       continue;
     }
 
@@ -4062,7 +5342,716 @@ static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
 
 }
 
-void mpc_optimise(mpc_parser_t *p) {
-  mpc_optimise_unretained(p, 1);
-}
+/*
+** First Sets
+**
+** Every `or` gets a table of the bytes each of its
+** alternatives can start with, so that the ones that
+** would fail on the next byte are never tried. An
+** alternative that can succeed without consuming
+** anything gets every byte. Rules not yet defined,
+** or reached again through recursion, are assumed
+** to match anything.
+*/
 
+enum { MPC_FIRST_DEPTH_MAX = 64 };
+
+static void mpc_first_all(unsigned char *first) {
+  memset(first, 0xFF, MPC_FIRST_BYTES);
+}
+
+/* Adds the bytes p can start with to `first`, and
+** returns 1 if p can succeed without consuming input */
+static int mpc_first(mpc_parser_t *p, unsigned char *first, mpc_parser_t **stack, int depth) {
+
+  int j, c, x;
+
+  for (j = 0; j < depth; j++) {
+    if (stack[j] == p) { mpc_first_all(first); return 1; }
+  }
+  if (depth == MPC_FIRST_DEPTH_MAX) { mpc_first_all(first); return 1; }
+  stack[depth++] = p;
+
+  switch (p->type) {
+
+    case MPC_TYPE_FAIL: return 0;
+
+    case MPC_TYPE_PASS:
+    case MPC_TYPE_LIFT:
+    case MPC_TYPE_LIFT_VAL:
+    case MPC_TYPE_STATE:
+    case MPC_TYPE_ANCHOR:
+    case MPC_TYPE_SOI:
+    case MPC_TYPE_EOI:
+    case MPC_TYPE_NOT:
+      return 1;
+
+    case MPC_TYPE_ANY:
+    case MPC_TYPE_SINGLE:
+    case MPC_TYPE_RANGE:
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+    case MPC_TYPE_SATISFY:
+      for (c = 1; c < 256; c++) {
+        if (mpc_class_has(p, (char)c)) { first[c >> 3] |= 1 << (c & 7); }
+      }
+      return 0;
+
+    case MPC_TYPE_STRING:
+      c = (unsigned char)p->data.string.x[0];
+      if (c == 0) { return 1; }
+      first[c >> 3] |= 1 << (c & 7);
+      return 0;
+
+    case MPC_TYPE_EXPECT:     return mpc_first(p->data.expect.x, first, stack, depth);
+    case MPC_TYPE_APPLY:      return mpc_first(p->data.apply.x, first, stack, depth);
+    case MPC_TYPE_APPLY_TO:   return mpc_first(p->data.apply_to.x, first, stack, depth);
+    case MPC_TYPE_CHECK:      return mpc_first(p->data.check.x, first, stack, depth);
+    case MPC_TYPE_CHECK_WITH: return mpc_first(p->data.check_with.x, first, stack, depth);
+    case MPC_TYPE_PREDICT:    return mpc_first(p->data.predict.x, first, stack, depth);
+    case MPC_TYPE_DFA:        return mpc_first(p->data.dfa.x, first, stack, depth);
+    case MPC_TYPE_MANY1:      return mpc_first(p->data.repeat.x, first, stack, depth);
+
+    case MPC_TYPE_MAYBE: mpc_first(p->data.not.x, first, stack, depth); return 1;
+    case MPC_TYPE_MANY: mpc_first(p->data.repeat.x, first, stack, depth); return 1;
+
+    case MPC_TYPE_COUNT:
+      x = mpc_first(p->data.repeat.x, first, stack, depth);
+      return x || p->data.repeat.n == 0;
+
+    case MPC_TYPE_OR:
+      x = p->data.or.n == 0;
+      for (j = 0; j < p->data.or.n; j++) {
+        x = mpc_first(p->data.or.xs[j], first, stack, depth) || x;
+      }
+      return x;
+
+    case MPC_TYPE_AND:
+      for (j = 0; j < p->data.and.n; j++) {
+        if (!mpc_first(p->data.and.xs[j], first, stack, depth)) { return 0; }
+      }
+      return 1;
+
+    default:
+      mpc_first_all(first);
+      return 1;
+  }
+
+}
+
+static void mpc_first_unretained(mpc_parser_t *p, int force) {
+
+  int i, j, c;
+  unsigned char *first;
+  mpc_parser_t *stack[MPC_FIRST_DEPTH_MAX];
+
+  if (p->retained && !force) { return; }
+
+  if (p->type == MPC_TYPE_EXPECT)     { mpc_first_unretained(p->data.expect.x, 0); }
+  if (p->type == MPC_TYPE_APPLY)      { mpc_first_unretained(p->data.apply.x, 0); }
+  if (p->type == MPC_TYPE_APPLY_TO)   { mpc_first_unretained(p->data.apply_to.x, 0); }
+  if (p->type == MPC_TYPE_CHECK)      { mpc_first_unretained(p->data.check.x, 0); }
+  if (p->type == MPC_TYPE_CHECK_WITH) { mpc_first_unretained(p->data.check_with.x, 0); }
+  if (p->type == MPC_TYPE_PREDICT)    { mpc_first_unretained(p->data.predict.x, 0); }
+  if (p->type == MPC_TYPE_DFA)        { mpc_first_unretained(p->data.dfa.x, 0); }
+  if (p->type == MPC_TYPE_NOT)        { mpc_first_unretained(p->data.not.x, 0); }
+  if (p->type == MPC_TYPE_MAYBE)      { mpc_first_unretained(p->data.not.x, 0); }
+  if (p->type == MPC_TYPE_MANY)       { mpc_first_unretained(p->data.repeat.x, 0); }
+  if (p->type == MPC_TYPE_MANY1)      { mpc_first_unretained(p->data.repeat.x, 0); }
+  if (p->type == MPC_TYPE_COUNT)      { mpc_first_unretained(p->data.repeat.x, 0); }
+
+  if (p->type == MPC_TYPE_AND) {
+    for (i = 0; i < p->data.and.n; i++) {
+      mpc_first_unretained(p->data.and.xs[i], 0);
+    }
+  }
+
+  if (p->type != MPC_TYPE_OR) { return; }
+
+  for (i = 0; i < p->data.or.n; i++) {
+    mpc_first_unretained(p->data.or.xs[i], 0);
+  }
+
+  free(p->data.or.first);
+  p->data.or.first = calloc(p->data.or.n, MPC_FIRST_BYTES);
+
+  /* Tables that skip nothing are not kept */
+  for (i = 0, j = 0; i < p->data.or.n; i++) {
+    first = p->data.or.first + i * MPC_FIRST_BYTES;
+    if (mpc_first(p->data.or.xs[i], first, stack, 0)) { mpc_first_all(first); }
+    for (c = 0; c < MPC_FIRST_BYTES; c++) { j = j || first[c] != 0xFF; }
+  }
+
+  if (!j) {
+    free(p->data.or.first);
+    p->data.or.first = NULL;
+  }
+
+}
+
+void mpc_optimise(mpc_parser_t *p) {
+  mpc_optimise_unretained(p, 1);
+  mpc_first_unretained(p, 1);
+}
+
+
+/*
+** Parser Tables
+**
+** Callbacks are written as their index in this list,
+** along with the kind of data they are applied with,
+** so that new entries must only ever be appended.
+*/
+
+typedef void (*mpc_callback_t)(void);
+
+enum {
+  MPC_CALLBACK_NONE   = 0,
+  MPC_CALLBACK_STRING = 1,
+  MPC_CALLBACK_PARSER = 2
+};
+
+typedef struct {
+  mpc_callback_t f;
+  int data;
+} mpc_callback_info_t;
+
+#define MPC_CALLBACK(f, d) { (mpc_callback_t)(f), MPC_CALLBACK_##d }
+
+static const mpc_callback_info_t mpc_callbacks[] = {
+  MPC_CALLBACK(NULL, NONE),
+  MPC_CALLBACK(free, NONE),
+  MPC_CALLBACK(mpcf_dtor_null, NONE),
+  MPC_CALLBACK(mpcf_ctor_null, NONE),
+  MPC_CALLBACK(mpcf_ctor_str, NONE),
+  MPC_CALLBACK(mpcf_free, NONE),
+  MPC_CALLBACK(mpcf_int, NONE),
+  MPC_CALLBACK(mpcf_hex, NONE),
+  MPC_CALLBACK(mpcf_oct, NONE),
+  MPC_CALLBACK(mpcf_float, NONE),
+  MPC_CALLBACK(mpcf_strtriml, NONE),
+  MPC_CALLBACK(mpcf_strtrimr, NONE),
+  MPC_CALLBACK(mpcf_strtrim, NONE),
+  MPC_CALLBACK(mpcf_escape, NONE),
+  MPC_CALLBACK(mpcf_escape_regex, NONE),
+  MPC_CALLBACK(mpcf_escape_string_raw, NONE),
+  MPC_CALLBACK(mpcf_escape_char_raw, NONE),
+  MPC_CALLBACK(mpcf_unescape, NONE),
+  MPC_CALLBACK(mpcf_unescape_regex, NONE),
+  MPC_CALLBACK(mpcf_unescape_string_raw, NONE),
+  MPC_CALLBACK(mpcf_unescape_char_raw, NONE),
+  MPC_CALLBACK(mpcf_null, NONE),
+  MPC_CALLBACK(mpcf_fst, NONE),
+  MPC_CALLBACK(mpcf_snd, NONE),
+  MPC_CALLBACK(mpcf_trd, NONE),
+  MPC_CALLBACK(mpcf_fst_free, NONE),
+  MPC_CALLBACK(mpcf_snd_free, NONE),
+  MPC_CALLBACK(mpcf_trd_free, NONE),
+  MPC_CALLBACK(mpcf_freefold, NONE),
+  MPC_CALLBACK(mpcf_strfold, NONE),
+  MPC_CALLBACK(mpcf_maths, NONE),
+  MPC_CALLBACK(mpcf_fold_ast, NONE),
+  MPC_CALLBACK(mpcf_str_ast, NONE),
+  MPC_CALLBACK(mpcf_state_ast, NONE),
+  MPC_CALLBACK(mpc_ast_delete, NONE),
+  MPC_CALLBACK(mpc_ast_add_root, NONE),
+  MPC_CALLBACK(mpc_ast_tag, STRING),
+  MPC_CALLBACK(mpc_ast_add_tag, STRING),
+  MPC_CALLBACK(mpcaf_grammar_rule, PARSER),
+  MPC_CALLBACK(mpc_boundary_anchor, NONE),
+  MPC_CALLBACK(mpc_boundary_newline_anchor, NONE),
+  MPC_CALLBACK(mpc_soft_delete, NONE)
+};
+
+enum {
+  MPC_CALLBACKS_NUM = sizeof(mpc_callbacks) / sizeof(mpc_callbacks[0])
+};
+
+#define MPC_CALLBACK_GET(t, j) ((t)mpc_callbacks[j].f)
+
+/* Index of f in the list, or -1 if it is missing */
+static int mpc_callback_find(mpc_callback_t f) {
+  int j;
+  for (j = 0; j < MPC_CALLBACKS_NUM; j++) {
+    if (mpc_callbacks[j].f == f) { return j; }
+  }
+  return -1;
+}
+
+typedef struct {
+  int roots;
+  int num;
+  mpc_parser_t **ps;
+  mpc_table_parser_t *es;
+  int children_num;
+  int *children;
+  int dtors_num;
+  int *dtors;
+  int dfas_num;
+  mpc_dfa_t **dfas;
+  int failed;
+} mpc_dump_t;
+
+/*
+** Retained parsers must be among those given, and
+** unretained ones are only reached from one place,
+** so each gets the next index the first time it is
+** seen.
+*/
+
+static int mpc_dump_ref(mpc_dump_t *t, mpc_parser_t *p) {
+  int j;
+  if (p->retained) {
+    for (j = 0; j < t->roots; j++) {
+      if (t->ps[j] == p) { return j; }
+    }
+    t->failed = 1;
+    return -1;
+  }
+  t->ps = realloc(t->ps, sizeof(mpc_parser_t*) * (t->num + 1));
+  t->es = realloc(t->es, sizeof(mpc_table_parser_t) * (t->num + 1));
+  t->ps[t->num] = p;
+  return t->num++;
+}
+
+static int mpc_dump_callback(mpc_dump_t *t, mpc_callback_t f) {
+  int j = mpc_callback_find(f);
+  if (j < 0) { t->failed = 1; }
+  return j;
+}
+
+#define MPC_DUMP_CALLBACK(t, f) mpc_dump_callback(t, (mpc_callback_t)(f))
+
+static void mpc_dump_child(mpc_dump_t *t, mpc_parser_t *p) {
+  int j = mpc_dump_ref(t, p);
+  t->children = realloc(t->children, sizeof(int) * (t->children_num + 1));
+  t->children[t->children_num++] = j;
+}
+
+static void mpc_dump_dtor(mpc_dump_t *t, mpc_dtor_t d) {
+  int j = MPC_DUMP_CALLBACK(t, d);
+  t->dtors = realloc(t->dtors, sizeof(int) * (t->dtors_num + 1));
+  t->dtors[t->dtors_num++] = j;
+}
+
+static void mpc_dump_fill(mpc_dump_t *t, int k) {
+
+  int j;
+  mpc_parser_t *p = t->ps[k];
+  mpc_table_parser_t e;
+
+  memset(&e, 0, sizeof(e));
+  e.type = p->type;
+  e.id = p->id;
+  e.name = p->name;
+  e.x = -1;
+  e.dfa = -1;
+
+  switch (p->type) {
+
+    case MPC_TYPE_UNDEFINED: t->failed = 1; break;
+
+    case MPC_TYPE_FAIL: e.s = p->data.fail.m; break;
+
+    case MPC_TYPE_LIFT_VAL:
+      if (p->data.lift.x) { t->failed = 1; }
+      e.f = MPC_DUMP_CALLBACK(t, p->data.lift.lf);
+      break;
+
+    case MPC_TYPE_LIFT: e.f = MPC_DUMP_CALLBACK(t, p->data.lift.lf); break;
+
+    case MPC_TYPE_EXPECT:
+      e.x = mpc_dump_ref(t, p->data.expect.x);
+      e.s = p->data.expect.m;
+      break;
+
+    case MPC_TYPE_ANCHOR:  e.f = MPC_DUMP_CALLBACK(t, p->data.anchor.f); break;
+    case MPC_TYPE_SATISFY: e.f = MPC_DUMP_CALLBACK(t, p->data.satisfy.f); break;
+    case MPC_TYPE_SINGLE:  e.a = p->data.single.x; break;
+
+    case MPC_TYPE_RANGE:
+      e.a = p->data.range.x;
+      e.b = p->data.range.y;
+      break;
+
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+    case MPC_TYPE_STRING:
+      e.s = p->data.string.x;
+      break;
+
+    case MPC_TYPE_APPLY:
+      e.x = mpc_dump_ref(t, p->data.apply.x);
+      e.f = MPC_DUMP_CALLBACK(t, p->data.apply.f);
+      break;
+
+    case MPC_TYPE_APPLY_TO:
+      e.x = mpc_dump_ref(t, p->data.apply_to.x);
+      e.f = MPC_DUMP_CALLBACK(t, p->data.apply_to.f);
+      if (e.f < 0) { break; }
+      switch (mpc_callbacks[e.f].data) {
+        case MPC_CALLBACK_STRING: e.s = p->data.apply_to.d; break;
+        case MPC_CALLBACK_PARSER: e.b = mpc_dump_ref(t, p->data.apply_to.d); break;
+        default: if (p->data.apply_to.d) { t->failed = 1; } break;
+      }
+      break;
+
+    case MPC_TYPE_PREDICT: e.x = mpc_dump_ref(t, p->data.predict.x); break;
+
+    case MPC_TYPE_NOT:
+    case MPC_TYPE_MAYBE:
+      e.x = mpc_dump_ref(t, p->data.not.x);
+      e.f = MPC_DUMP_CALLBACK(t, p->data.not.lf);
+      e.g = MPC_DUMP_CALLBACK(t, p->data.not.dx);
+      break;
+
+    case MPC_TYPE_MANY:
+    case MPC_TYPE_MANY1:
+    case MPC_TYPE_COUNT:
+      e.x = mpc_dump_ref(t, p->data.repeat.x);
+      e.a = p->data.repeat.n;
+      e.f = MPC_DUMP_CALLBACK(t, p->data.repeat.f);
+      e.g = MPC_DUMP_CALLBACK(t, p->data.repeat.dx);
+      break;
+
+    case MPC_TYPE_OR:
+      e.a = p->data.or.n;
+      e.b = t->children_num;
+      e.first = p->data.or.first;
+      for (j = 0; j < p->data.or.n; j++) { mpc_dump_child(t, p->data.or.xs[j]); }
+      break;
+
+    case MPC_TYPE_AND:
+      e.a = p->data.and.n;
+      e.b = t->children_num;
+      e.f = MPC_DUMP_CALLBACK(t, p->data.and.f);
+      e.g = t->dtors_num;
+      for (j = 0; j < p->data.and.n; j++) { mpc_dump_child(t, p->data.and.xs[j]); }
+      for (j = 0; j < p->data.and.n-1; j++) { mpc_dump_dtor(t, p->data.and.dxs[j]); }
+      break;
+
+    case MPC_TYPE_CHECK:
+      e.x = mpc_dump_ref(t, p->data.check.x);
+      e.f = MPC_DUMP_CALLBACK(t, p->data.check.f);
+      e.g = MPC_DUMP_CALLBACK(t, p->data.check.dx);
+      e.s = p->data.check.e;
+      break;
+
+    case MPC_TYPE_CHECK_WITH:
+      if (p->data.check_with.d) { t->failed = 1; }
+      e.x = mpc_dump_ref(t, p->data.check_with.x);
+      e.f = MPC_DUMP_CALLBACK(t, p->data.check_with.f);
+      e.g = MPC_DUMP_CALLBACK(t, p->data.check_with.dx);
+      e.s = p->data.check_with.e;
+      break;
+
+    case MPC_TYPE_DFA:
+      e.x = mpc_dump_ref(t, p->data.dfa.x);
+      e.dfa = t->dfas_num;
+      t->dfas = realloc(t->dfas, sizeof(mpc_dfa_t*) * (t->dfas_num + 1));
+      t->dfas[t->dfas_num++] = p->data.dfa.d;
+      break;
+
+    default: break;
+  }
+
+  t->es[k] = e;
+}
+
+static void mpc_dump_string(FILE *f, const char *s) {
+  if (s == NULL) { fputs("NULL", f); return; }
+  fputc('"', f);
+  for (; *s; s++) {
+    unsigned char c = *s;
+    if (c == '"' || c == '\\' || c == '?') { fprintf(f, "\\%c", c); }
+    else if (c >= ' ' && c <= '~') { fputc(c, f); }
+    else { fprintf(f, "\\%03o", c); }
+  }
+  fputc('"', f);
+}
+
+enum {
+  MPC_DUMP_UCHAR,
+  MPC_DUMP_SCHAR,
+  MPC_DUMP_SHORT,
+  MPC_DUMP_INT
+};
+
+/* Writes n values as an array, with a trailing zero so it is never empty */
+static void mpc_dump_array(FILE *f, int kind, const char *name,
+  const char *part, int j, const void *xs, int n) {
+
+  static const char *types[] = { "unsigned char", "signed char", "short", "int" };
+  int k;
+  long x;
+
+  fprintf(f, "static const %s %s_%s", types[kind], name, part);
+  if (j >= 0) { fprintf(f, "_%i", j); }
+  fprintf(f, "[] = {");
+
+  for (k = 0; k < n; k++) {
+    switch (kind) {
+      case MPC_DUMP_UCHAR: x = ((const unsigned char*)xs)[k]; break;
+      case MPC_DUMP_SCHAR: x = ((const signed char*)xs)[k]; break;
+      case MPC_DUMP_SHORT: x = ((const short*)xs)[k]; break;
+      default:             x = ((const int*)xs)[k]; break;
+    }
+    fprintf(f, "%s%li,", k % 16 == 0 ? "\n  " : " ", x);
+  }
+  fprintf(f, "%s0\n};\n\n", n % 16 == 0 ? "\n  " : " ");
+}
+
+static void mpc_dump_write(mpc_dump_t *t, FILE *f, const char *name) {
+
+  int j;
+  mpc_table_parser_t *e;
+  mpc_dfa_t *d;
+
+  fprintf(f, "/* Parser tables written by mpc_dump */\n\n#include \"mpc.h\"\n\n");
+
+  for (j = 0; j < t->num; j++) {
+    e = &t->es[j];
+    if (e->first == NULL) { continue; }
+    mpc_dump_array(f, MPC_DUMP_UCHAR, name, "first", j, e->first, e->a * MPC_FIRST_BYTES);
+  }
+
+  for (j = 0; j < t->dfas_num; j++) {
+    d = t->dfas[j];
+    mpc_dump_array(f, MPC_DUMP_UCHAR, name, "classes", j, d->classes, 256);
+    mpc_dump_array(f, MPC_DUMP_SHORT, name, "next", j, d->next, d->states_num * d->classes_num);
+    mpc_dump_array(f, MPC_DUMP_UCHAR, name, "act", j, d->act, d->states_num * d->classes_num);
+    mpc_dump_array(f, MPC_DUMP_SCHAR, name, "acts", j, d->acts, d->acts_num * MPC_DFA_REGS_MAX);
+  }
+
+  mpc_dump_array(f, MPC_DUMP_INT, name, "children", -1, t->children, t->children_num);
+  mpc_dump_array(f, MPC_DUMP_INT, name, "dtors", -1, t->dtors, t->dtors_num);
+
+  fprintf(f, "static const mpc_table_dfa_t %s_dfas[] = {\n", name);
+  for (j = 0; j < t->dfas_num; j++) {
+    d = t->dfas[j];
+    fprintf(f, "  { %i, %i, %i, %i, %i, %s_classes_%i, %s_next_%i, %s_act_%i, %s_acts_%i },\n",
+      d->start, d->start_act, d->states_num, d->classes_num, d->acts_num,
+      name, j, name, j, name, j, name, j);
+  }
+  fprintf(f, "  { 0, 0, 0, 0, 0, NULL, NULL, NULL, NULL }\n};\n\n");
+
+  fprintf(f, "static const mpc_table_parser_t %s_parsers[] = {\n", name);
+  for (j = 0; j < t->num; j++) {
+    e = &t->es[j];
+    fprintf(f, "  { %i, %i, ", e->type, e->id);
+    mpc_dump_string(f, e->name);
+    fprintf(f, ", ");
+    mpc_dump_string(f, e->s);
+    fprintf(f, ", %i, %i, %i, %i, %i, ", e->a, e->b, e->x, e->f, e->g);
+    if (e->first) { fprintf(f, "%s_first_%i", name, j); } else { fprintf(f, "NULL"); }
+    fprintf(f, ", %i }%s\n", e->dfa, j == t->num-1 ? "" : ",");
+  }
+  fprintf(f, "};\n\n");
+
+  fprintf(f, "const mpc_table_t %s = {\n  %i, %s_parsers, %s_children, %s_dtors, %s_dfas\n};\n",
+    name, t->num, name, name, name, name);
+}
+
+int mpc_dump(FILE *f, const char *name, int n, ...) {
+
+  int j;
+  va_list va;
+  mpc_dump_t t;
+
+  memset(&t, 0, sizeof(t));
+  t.roots = n;
+  t.num = n;
+  t.ps = malloc(sizeof(mpc_parser_t*) * n);
+  t.es = malloc(sizeof(mpc_table_parser_t) * n);
+
+  va_start(va, n);
+  for (j = 0; j < n; j++) { t.ps[j] = va_arg(va, mpc_parser_t*); }
+  va_end(va);
+
+  for (j = 0; j < n; j++) {
+    if (!t.ps[j]->retained) { t.failed = 1; }
+  }
+
+  for (j = 0; j < t.num && !t.failed; j++) { mpc_dump_fill(&t, j); }
+
+  if (!t.failed) { mpc_dump_write(&t, f, name); }
+
+  free(t.ps);
+  free(t.es);
+  free(t.children);
+  free(t.dtors);
+  free(t.dfas);
+  return !t.failed;
+}
+
+static char *mpc_load_string(const char *s) {
+  if (s == NULL) { return NULL; }
+  return strcpy(malloc(strlen(s) + 1), s);
+}
+
+static mpc_dfa_t *mpc_load_dfa(const mpc_table_dfa_t *e) {
+  size_t cells = (size_t)e->states_num * e->classes_num;
+  mpc_dfa_t *d = malloc(sizeof(mpc_dfa_t));
+  d->start = e->start;
+  d->start_act = e->start_act;
+  d->states_num = e->states_num;
+  d->classes_num = e->classes_num;
+  d->acts_num = e->acts_num;
+  memcpy(d->classes, e->classes, 256);
+  d->next = malloc(sizeof(short) * cells + 1);
+  d->act = malloc(cells + 1);
+  d->acts = malloc(MPC_DFA_ACTS_MAX * MPC_DFA_REGS_MAX);
+  memcpy(d->next, e->next, sizeof(short) * cells);
+  memcpy(d->act, e->act, cells);
+  memcpy(d->acts, e->acts, e->acts_num * MPC_DFA_REGS_MAX);
+  return d;
+}
+
+static void mpc_load_parser(const mpc_table_t *t, mpc_parser_t **ps, int k) {
+
+  int j;
+  const mpc_table_parser_t *e = &t->parsers[k];
+  mpc_parser_t *p = ps[k];
+  mpc_parser_t *x = e->x >= 0 ? ps[e->x] : NULL;
+
+  p->type = e->type;
+  p->id = e->id;
+  if (!p->retained) { p->name = mpc_load_string(e->name); }
+
+  switch (e->type) {
+
+    case MPC_TYPE_FAIL: p->data.fail.m = mpc_load_string(e->s); break;
+
+    case MPC_TYPE_LIFT:
+    case MPC_TYPE_LIFT_VAL:
+      p->data.lift.lf = MPC_CALLBACK_GET(mpc_ctor_t, e->f);
+      p->data.lift.x = NULL;
+      break;
+
+    case MPC_TYPE_EXPECT:
+      p->data.expect.x = x;
+      p->data.expect.m = mpc_load_string(e->s);
+      break;
+
+    case MPC_TYPE_ANCHOR:  p->data.anchor.f = MPC_CALLBACK_GET(int(*)(char,char), e->f); break;
+    case MPC_TYPE_SATISFY: p->data.satisfy.f = MPC_CALLBACK_GET(int(*)(char), e->f); break;
+    case MPC_TYPE_SINGLE:  p->data.single.x = e->a; break;
+
+    case MPC_TYPE_RANGE:
+      p->data.range.x = e->a;
+      p->data.range.y = e->b;
+      break;
+
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+    case MPC_TYPE_STRING:
+      p->data.string.x = mpc_load_string(e->s);
+      break;
+
+    case MPC_TYPE_APPLY:
+      p->data.apply.x = x;
+      p->data.apply.f = MPC_CALLBACK_GET(mpc_apply_t, e->f);
+      break;
+
+    case MPC_TYPE_APPLY_TO:
+      p->data.apply_to.x = x;
+      p->data.apply_to.f = MPC_CALLBACK_GET(mpc_apply_to_t, e->f);
+      switch (mpc_callbacks[e->f].data) {
+        case MPC_CALLBACK_STRING: p->data.apply_to.d = (void*)e->s; break;
+        case MPC_CALLBACK_PARSER: p->data.apply_to.d = ps[e->b]; break;
+        default: p->data.apply_to.d = NULL; break;
+      }
+      break;
+
+    case MPC_TYPE_PREDICT: p->data.predict.x = x; break;
+
+    case MPC_TYPE_NOT:
+    case MPC_TYPE_MAYBE:
+      p->data.not.x = x;
+      p->data.not.lf = MPC_CALLBACK_GET(mpc_ctor_t, e->f);
+      p->data.not.dx = MPC_CALLBACK_GET(mpc_dtor_t, e->g);
+      break;
+
+    case MPC_TYPE_MANY:
+    case MPC_TYPE_MANY1:
+    case MPC_TYPE_COUNT:
+      p->data.repeat.x = x;
+      p->data.repeat.n = e->a;
+      p->data.repeat.f = MPC_CALLBACK_GET(mpc_fold_t, e->f);
+      p->data.repeat.dx = MPC_CALLBACK_GET(mpc_dtor_t, e->g);
+      break;
+
+    case MPC_TYPE_OR:
+      p->data.or.n = e->a;
+      p->data.or.xs = malloc(sizeof(mpc_parser_t*) * e->a);
+      for (j = 0; j < e->a; j++) { p->data.or.xs[j] = ps[t->children[e->b + j]]; }
+      p->data.or.first = NULL;
+      if (e->first) {
+        p->data.or.first = malloc(e->a * MPC_FIRST_BYTES);
+        memcpy(p->data.or.first, e->first, e->a * MPC_FIRST_BYTES);
+      }
+      break;
+
+    case MPC_TYPE_AND:
+      p->data.and.n = e->a;
+      p->data.and.f = MPC_CALLBACK_GET(mpc_fold_t, e->f);
+      p->data.and.xs = malloc(sizeof(mpc_parser_t*) * e->a);
+      p->data.and.dxs = malloc(sizeof(mpc_dtor_t) * (e->a - 1));
+      for (j = 0; j < e->a; j++) { p->data.and.xs[j] = ps[t->children[e->b + j]]; }
+      for (j = 0; j < e->a-1; j++) { p->data.and.dxs[j] = MPC_CALLBACK_GET(mpc_dtor_t, t->dtors[e->g + j]); }
+      break;
+
+    case MPC_TYPE_CHECK:
+      p->data.check.x = x;
+      p->data.check.f = MPC_CALLBACK_GET(mpc_check_t, e->f);
+      p->data.check.dx = MPC_CALLBACK_GET(mpc_dtor_t, e->g);
+      p->data.check.e = mpc_load_string(e->s);
+      break;
+
+    case MPC_TYPE_CHECK_WITH:
+      p->data.check_with.x = x;
+      p->data.check_with.f = MPC_CALLBACK_GET(mpc_check_with_t, e->f);
+      p->data.check_with.dx = MPC_CALLBACK_GET(mpc_dtor_t, e->g);
+      p->data.check_with.d = NULL;
+      p->data.check_with.e = mpc_load_string(e->s);
+      break;
+
+    case MPC_TYPE_DFA:
+      p->data.dfa.x = x;
+      p->data.dfa.d = mpc_load_dfa(&t->dfas[e->dfa]);
+      break;
+
+    default: break;
+  }
+
+}
+
+int mpc_load(const mpc_table_t *t, int n, ...) {
+
+  int j;
+  va_list va;
+  mpc_parser_t **ps;
+
+  if (n > t->parsers_num) { return 0; }
+
+  ps = malloc(sizeof(mpc_parser_t*) * t->parsers_num);
+
+  va_start(va, n);
+  for (j = 0; j < n; j++) { ps[j] = va_arg(va, mpc_parser_t*); }
+  va_end(va);
+
+  for (j = 0; j < n; j++) {
+    if (!ps[j]->retained || t->parsers[j].name == NULL
+    ||  strcmp(ps[j]->name, t->parsers[j].name) != 0) {
+      free(ps);
+      return 0;
+    }
+  }
+
+  for (j = 0; j < n; j++) { mpc_undefine(ps[j]); }
+  for (j = n; j < t->parsers_num; j++) { ps[j] = mpc_undefined(); }
+  for (j = 0; j < t->parsers_num; j++) { mpc_load_parser(t, ps, j); }
+
+  free(ps);
+  return 1;
+}
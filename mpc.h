@@ -71,6 +71,28 @@ int mpc_parse_file(const char *filename, FILE *file, mpc_parser_t *p, mpc_result
 int mpc_parse_pipe(const char *filename, FILE *pipe, mpc_parser_t *p, mpc_result_t *r);
 int mpc_parse_contents(const char *filename, mpc_parser_t *p, mpc_result_t *r);
 
+/*
+** Packrat mode remembers the result of every named parser at each input
+** position, so backtracking never parses a rule more than twice there.
+** Results are kept with mpc_ast_copy, so named parsers must produce
+** ASTs, as the parsers built by mpca_lang do.
+**
+** Arena mode builds the AST in one arena rather than with a malloc per
+** node and string. Every node of the result points at the arena, and
+** mpc_ast_delete on any of them releases the whole tree at once.
+** Nodes added to such a tree later are copied into its arena.
+*/
+
+enum {
+  MPC_PARSE_DEFAULT = 0,
+  MPC_PARSE_PACKRAT = 1,
+  MPC_PARSE_ARENA   = 2
+};
+
+int mpc_parse_with(const char *filename, const char *string, mpc_parser_t *p, mpc_result_t *r, int flags);
+int mpc_nparse_with(const char *filename, const char *string, size_t length, mpc_parser_t *p, mpc_result_t *r, int flags);
+int mpc_parse_contents_with(const char *filename, mpc_parser_t *p, mpc_result_t *r, int flags);
+
 /*
 ** Function Types
 */
@@ -286,6 +308,9 @@ typedef struct mpc_ast_t {
   mpc_state_t state;
   int children_num;
   struct mpc_ast_t** children;
+  struct mpc_arena_t *arena;
+  int rule;
+  unsigned long rules;
 } mpc_ast_t;
 
 mpc_ast_t *mpc_ast_new(const char *tag, const char *contents);
@@ -296,6 +321,7 @@ mpc_ast_t *mpc_ast_add_tag(mpc_ast_t *a, const char *t);
 mpc_ast_t *mpc_ast_add_root_tag(mpc_ast_t *a, const char *t);
 mpc_ast_t *mpc_ast_tag(mpc_ast_t *a, const char *t);
 mpc_ast_t *mpc_ast_state(mpc_ast_t *a, mpc_state_t s);
+mpc_ast_t *mpc_ast_copy(mpc_ast_t *a);
 
 void mpc_ast_delete(mpc_ast_t *a);
 void mpc_ast_print(mpc_ast_t *a);
@@ -356,6 +382,18 @@ enum {
   MPCA_LANG_WHITESPACE_SENSITIVE = 2
 };
 
+/*
+** The parsers given to mpca_lang are numbered from 1 in argument order.
+** An AST node's rule is the number of the innermost rule it came from,
+** or 0 for none, and bit n of its rules is set for each rule n that
+** encloses it, for n below MPC_RULES_MAX. These match the names in its
+** tag, so nodes can be told apart without comparing strings.
+*/
+
+enum {
+  MPC_RULES_MAX = 32
+};
+
 mpc_parser_t *mpca_grammar(int flags, const char *grammar, ...);
 
 mpc_err_t *mpca_lang(int flags, const char *language, ...);
@@ -363,6 +401,53 @@ mpc_err_t *mpca_lang_file(int flags, FILE *f, ...);
 mpc_err_t *mpca_lang_pipe(int flags, FILE *f, ...);
 mpc_err_t *mpca_lang_contents(int flags, const char *filename, ...);
 
+/*
+** Parser Tables
+**
+** mpc_dump writes C source for static tables describing the
+** given retained parsers and everything under them, so a
+** grammar can be built once at compile time. mpc_load defines
+** the same parsers from those tables, given in the same order
+** and with the same names. Callbacks are stored by number, so
+** only those from mpc itself can be written. Both return 1 on
+** success and 0 if the parsers can not be described.
+*/
+
+typedef struct {
+  int type;
+  int id;
+  const char *name;
+  const char *s;
+  int a, b;
+  int x;
+  int f, g;
+  const unsigned char *first;
+  int dfa;
+} mpc_table_parser_t;
+
+typedef struct {
+  int start;
+  int start_act;
+  int states_num;
+  int classes_num;
+  int acts_num;
+  const unsigned char *classes;
+  const short *next;
+  const unsigned char *act;
+  const signed char *acts;
+} mpc_table_dfa_t;
+
+typedef struct {
+  int parsers_num;
+  const mpc_table_parser_t *parsers;
+  const int *children;
+  const int *dtors;
+  const mpc_table_dfa_t *dfas;
+} mpc_table_t;
+
+int mpc_dump(FILE *f, const char *name, int n, ...);
+int mpc_load(const mpc_table_t *t, int n, ...);
+
 /*
 ** Misc
 */
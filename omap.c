@@ -0,0 +1,325 @@
+#include "lval.h"
+
+static omap_node* node_new(bool leaf) {
+    omap_node* n = malloc(sizeof(omap_node));
+    n->count = 0;
+    n->leaf = leaf;
+    return n;
+}
+
+static void node_del(omap_node* n) {
+    for (int i = 0; i < n->count; i++) {
+        lval_del(n->keys[i]);
+        lval_del(n->vals[i]);
+    }
+    if (!n->leaf) {
+        for (int i = 0; i <= n->count; i++) { node_del(n->children[i]); }
+    }
+    free(n);
+}
+
+/* Index of the first key not less than k */
+static int node_search(omap_node* n, lval* k, bool* found) {
+    int lo = 0, hi = n->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (lval_cmp(n->keys[mid], k) < 0) { lo = mid + 1; } else { hi = mid; }
+    }
+    *found = lo < n->count && lval_cmp(n->keys[lo], k) == 0;
+    return lo;
+}
+
+/* Moves entries and children of a node to make or close gaps */
+static void node_shift(omap_node* n, int from, int to) {
+    memmove(&n->keys[to], &n->keys[from], sizeof(lval*) * (n->count - from));
+    memmove(&n->vals[to], &n->vals[from], sizeof(lval*) * (n->count - from));
+    if (!n->leaf) {
+        memmove(&n->children[to + 1], &n->children[from + 1],
+            sizeof(omap_node*) * (n->count - from));
+    }
+}
+
+lomap* lomap_new(void) {
+    lomap* m = malloc(sizeof(lomap));
+    m->refs = 1;
+    m->count = 0;
+    m->root = node_new(true);
+    return m;
+}
+
+lomap* lomap_retain(lomap* m) {
+    m->refs++;
+    return m;
+}
+
+void lomap_release(lomap* m) {
+    if (--m->refs > 0) { return; }
+    node_del(m->root);
+    free(m);
+}
+
+/* Returns the value for k without copying it, or NULL if k is missing */
+lval* lomap_get(lomap* m, lval* k) {
+    omap_node* n = m->root;
+    while (true) {
+        bool found;
+        int i = node_search(n, k, &found);
+        if (found) { return n->vals[i]; }
+        if (n->leaf) { return NULL; }
+        n = n->children[i];
+    }
+}
+
+/* Splits the full child i of x, moving its median key up into x */
+static void node_split(omap_node* x, int i) {
+    omap_node* y = x->children[i];
+    omap_node* z = node_new(y->leaf);
+    z->count = OMAP_T - 1;
+    memcpy(z->keys, &y->keys[OMAP_T], sizeof(lval*) * (OMAP_T - 1));
+    memcpy(z->vals, &y->vals[OMAP_T], sizeof(lval*) * (OMAP_T - 1));
+    if (!y->leaf) {
+        memcpy(z->children, &y->children[OMAP_T], sizeof(omap_node*) * OMAP_T);
+    }
+    y->count = OMAP_T - 1;
+
+    node_shift(x, i, i + 1);
+    x->keys[i] = y->keys[OMAP_T - 1];
+    x->vals[i] = y->vals[OMAP_T - 1];
+    x->children[i + 1] = z;
+    x->count++;
+}
+
+/* Takes ownership of k and v, replacing any existing value for k.
+ * Full nodes are split on the way down so there is always room. */
+void lomap_put(lomap* m, lval* k, lval* v) {
+    if (m->root->count == OMAP_MAX_KEYS) {
+        omap_node* s = node_new(false);
+        s->children[0] = m->root;
+        m->root = s;
+        node_split(s, 0);
+    }
+
+    omap_node* n = m->root;
+    while (true) {
+        bool found;
+        int i = node_search(n, k, &found);
+        if (found) {
+            lval_del(n->vals[i]);
+            n->vals[i] = v;
+            lval_del(k);
+            return;
+        }
+        if (n->leaf) {
+            node_shift(n, i, i + 1);
+            n->keys[i] = k;
+            n->vals[i] = v;
+            n->count++;
+            m->count++;
+            return;
+        }
+        if (n->children[i]->count == OMAP_MAX_KEYS) {
+            node_split(n, i);
+            int c = lval_cmp(k, n->keys[i]);
+            if (c == 0) { continue; }
+            if (c > 0) { i++; }
+        }
+        n = n->children[i];
+    }
+}
+
+/* Joins child i+1 of x onto child i, with key i of x between them */
+static void node_merge(omap_node* x, int i) {
+    omap_node* y = x->children[i];
+    omap_node* z = x->children[i + 1];
+    y->keys[y->count] = x->keys[i];
+    y->vals[y->count] = x->vals[i];
+    memcpy(&y->keys[y->count + 1], z->keys, sizeof(lval*) * z->count);
+    memcpy(&y->vals[y->count + 1], z->vals, sizeof(lval*) * z->count);
+    if (!y->leaf) {
+        memcpy(&y->children[y->count + 1], z->children,
+            sizeof(omap_node*) * (z->count + 1));
+    }
+    y->count += z->count + 1;
+    free(z);
+
+    node_shift(x, i + 1, i);
+    x->count--;
+}
+
+/* Makes sure child i of x has at least OMAP_T keys before descending
+ * into it, by borrowing through x from a sibling or by merging.
+ * Returns the index of the child to descend into. */
+static int node_fill(omap_node* x, int i) {
+    omap_node* c = x->children[i];
+    if (c->count >= OMAP_T) { return i; }
+
+    if (i > 0 && x->children[i - 1]->count >= OMAP_T) {
+        omap_node* l = x->children[i - 1];
+        memmove(&c->keys[1], c->keys, sizeof(lval*) * c->count);
+        memmove(&c->vals[1], c->vals, sizeof(lval*) * c->count);
+        if (!c->leaf) {
+            memmove(&c->children[1], c->children, sizeof(omap_node*) * (c->count + 1));
+            c->children[0] = l->children[l->count];
+        }
+        c->keys[0] = x->keys[i - 1];
+        c->vals[0] = x->vals[i - 1];
+        x->keys[i - 1] = l->keys[l->count - 1];
+        x->vals[i - 1] = l->vals[l->count - 1];
+        c->count++;
+        l->count--;
+        return i;
+    }
+
+    if (i < x->count && x->children[i + 1]->count >= OMAP_T) {
+        omap_node* r = x->children[i + 1];
+        c->keys[c->count] = x->keys[i];
+        c->vals[c->count] = x->vals[i];
+        if (!c->leaf) { c->children[c->count + 1] = r->children[0]; }
+        c->count++;
+        x->keys[i] = r->keys[0];
+        x->vals[i] = r->vals[0];
+        memmove(r->keys, &r->keys[1], sizeof(lval*) * (r->count - 1));
+        memmove(r->vals, &r->vals[1], sizeof(lval*) * (r->count - 1));
+        if (!r->leaf) {
+            memmove(r->children, &r->children[1], sizeof(omap_node*) * r->count);
+        }
+        r->count--;
+        return i;
+    }
+
+    if (i < x->count) {
+        node_merge(x, i);
+        return i;
+    }
+    node_merge(x, i - 1);
+    return i - 1;
+}
+
+/* Removes k from the subtree at n, which has at least OMAP_T keys unless
+ * it is the root. The entry is only freed if del is set. */
+static bool node_remove(omap_node* n, lval* k, bool del) {
+    while (true) {
+        bool found;
+        int i = node_search(n, k, &found);
+
+        if (found && n->leaf) {
+            if (del) {
+                lval_del(n->keys[i]);
+                lval_del(n->vals[i]);
+            }
+            node_shift(n, i + 1, i);
+            n->count--;
+            return true;
+        }
+
+        if (found) {
+            omap_node* y = n->children[i];
+            omap_node* z = n->children[i + 1];
+            if (y->count >= OMAP_T || z->count >= OMAP_T) {
+                /* Replace the entry with its predecessor or successor,
+                 * then remove that from the leaf it came from */
+                omap_node* s = y->count >= OMAP_T ? y : z;
+                omap_node* leaf = s;
+                int j;
+                if (s == y) {
+                    while (!leaf->leaf) { leaf = leaf->children[leaf->count]; }
+                    j = leaf->count - 1;
+                } else {
+                    while (!leaf->leaf) { leaf = leaf->children[0]; }
+                    j = 0;
+                }
+                lval* ok = n->keys[i];
+                lval* ov = n->vals[i];
+                n->keys[i] = leaf->keys[j];
+                n->vals[i] = leaf->vals[j];
+                node_remove(s, n->keys[i], false);
+                if (del) {
+                    lval_del(ok);
+                    lval_del(ov);
+                }
+                return true;
+            }
+            node_merge(n, i);
+            n = y;
+            continue;
+        }
+
+        if (n->leaf) { return false; }
+        n = n->children[node_fill(n, i)];
+    }
+}
+
+/* Removes k, returning false if it was missing */
+bool lomap_remove(lomap* m, lval* k) {
+    bool removed = node_remove(m->root, k, true);
+    if (removed) { m->count--; }
+
+    /* The root shrinks once merges have emptied it */
+    if (m->root->count == 0 && !m->root->leaf) {
+        omap_node* r = m->root;
+        m->root = r->children[0];
+        free(r);
+    }
+    return removed;
+}
+
+/* Greatest entry with a key not greater than k. Entries are not copied. */
+bool lomap_floor(lomap* m, lval* k, lval** key, lval** val) {
+    bool any = false;
+    omap_node* n = m->root;
+    while (true) {
+        bool found;
+        int i = node_search(n, k, &found);
+        if (found) {
+            *key = n->keys[i];
+            *val = n->vals[i];
+            return true;
+        }
+        if (i > 0) {
+            *key = n->keys[i - 1];
+            *val = n->vals[i - 1];
+            any = true;
+        }
+        if (n->leaf) { return any; }
+        n = n->children[i];
+    }
+}
+
+/* Least entry with a key not less than k. Entries are not copied. */
+bool lomap_ceiling(lomap* m, lval* k, lval** key, lval** val) {
+    bool any = false;
+    omap_node* n = m->root;
+    while (true) {
+        bool found;
+        int i = node_search(n, k, &found);
+        if (i < n->count) {
+            *key = n->keys[i];
+            *val = n->vals[i];
+            any = true;
+            if (found) { return true; }
+        }
+        if (n->leaf) { return any; }
+        n = n->children[i];
+    }
+}
+
+static bool node_range(omap_node* n, lval* lo, lval* hi,
+        lomap_visit fn, void* arg) {
+    /* Subtrees left of the first key not less than lo are skipped */
+    bool found;
+    int i = lo ? node_search(n, lo, &found) : 0;
+    for (; i <= n->count; i++) {
+        if (!n->leaf && !node_range(n->children[i], lo, hi, fn, arg)) {
+            return false;
+        }
+        if (i == n->count) { break; }
+        if (hi && lval_cmp(n->keys[i], hi) >= 0) { return false; }
+        if (!fn(n->keys[i], n->vals[i], arg)) { return false; }
+    }
+    return true;
+}
+
+/* Visits entries with lo <= key < hi in order. A NULL bound is open. */
+void lomap_range(lomap* m, lval* lo, lval* hi, lomap_visit fn, void* arg) {
+    node_range(m->root, lo, hi, fn, arg);
+}
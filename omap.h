@@ -0,0 +1,45 @@
+#ifndef omap_h
+#define omap_h
+
+#include <stdbool.h>
+
+struct lval;
+
+/* Ordered map from lvals to lvals, kept in a B-tree.
+ * Keys are ordered with lval_cmp. Like a dictionary, the map is mutable
+ * and shared by every lval that refers to it. */
+
+/* Minimum degree. A node holds 7 to 15 keys, so its key pointers fill
+ * two cache lines and a search touches few nodes. */
+#define OMAP_T 8
+#define OMAP_MAX_KEYS (2 * OMAP_T - 1)
+
+typedef struct omap_node {
+    int count;
+    bool leaf;
+    struct lval* keys[OMAP_MAX_KEYS];
+    struct lval* vals[OMAP_MAX_KEYS];
+    struct omap_node* children[OMAP_MAX_KEYS + 1];
+} omap_node;
+
+typedef struct lomap {
+    int refs;
+    long count;
+    omap_node* root;
+} lomap;
+
+/* Called for each entry in order, returns false to stop */
+typedef bool (*lomap_visit)(struct lval* k, struct lval* v, void* arg);
+
+lomap* lomap_new(void);
+lomap* lomap_retain(lomap* m);
+void lomap_release(lomap* m);
+struct lval* lomap_get(lomap* m, struct lval* k);
+void lomap_put(lomap* m, struct lval* k, struct lval* v);
+bool lomap_remove(lomap* m, struct lval* k);
+bool lomap_floor(lomap* m, struct lval* k, struct lval** key, struct lval** val);
+bool lomap_ceiling(lomap* m, struct lval* k, struct lval** key, struct lval** val);
+void lomap_range(lomap* m, struct lval* lo, struct lval* hi,
+        lomap_visit fn, void* arg);
+
+#endif
@@ -0,0 +1,130 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "pool.h"
+
+/* Upper bound on threads, including the caller */
+#define POOL_MAX_THREADS 64
+
+static struct {
+    int threads;
+    int started;
+    pthread_t workers[POOL_MAX_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t idle;
+    bool quit;
+
+    /* Current job, a new generation wakes the workers */
+    unsigned long generation;
+    void (*fn)(void*, long);
+    void* arg;
+    long ntasks;
+    long next;
+    long pending;
+} pool = {
+    1, 0, {0}, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER
+};
+
+/* Claims and runs tasks of the current job until none are left.
+ * Called with the lock held. */
+static void pool_work(void) {
+    while (pool.next < pool.ntasks) {
+        long task = pool.next++;
+        void (*fn)(void*, long) = pool.fn;
+        void* arg = pool.arg;
+
+        pthread_mutex_unlock(&pool.lock);
+        fn(arg, task);
+        pthread_mutex_lock(&pool.lock);
+
+        if (--pool.pending == 0) {
+            pthread_cond_signal(&pool.idle);
+        }
+    }
+}
+
+static void* pool_worker(void* unused) {
+    pthread_mutex_lock(&pool.lock);
+    unsigned long seen = pool.generation;
+    while (true) {
+        while (!pool.quit && pool.generation == seen) {
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        }
+        if (pool.quit) { break; }
+        seen = pool.generation;
+        pool_work();
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+/* Joins all running workers */
+static void pool_stop(void) {
+    pthread_mutex_lock(&pool.lock);
+    pool.quit = true;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (int i = 0; i < pool.started; i++) {
+        pthread_join(pool.workers[i], NULL);
+    }
+    pool.started = 0;
+    pool.quit = false;
+}
+
+/* Reads the thread count from LISPY_THREADS, defaulting to one per CPU */
+void pool_init(void) {
+    char* env = getenv("LISPY_THREADS");
+    long n = env ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+    pool_set_threads(n > 0 ? (int) n : 1);
+}
+
+int pool_threads(void) {
+    return pool.threads;
+}
+
+/* Changes the number of threads. Workers are started on the next job */
+void pool_set_threads(int n) {
+    if (n < 1) { n = 1; }
+    if (n > POOL_MAX_THREADS) { n = POOL_MAX_THREADS; }
+    if (n == pool.threads) { return; }
+    pool_stop();
+    pool.threads = n;
+}
+
+void pool_run(void (*fn)(void* arg, long task), void* arg, long ntasks) {
+    if (pool.threads <= 1 || ntasks <= 1) {
+        for (long t = 0; t < ntasks; t++) { fn(arg, t); }
+        return;
+    }
+
+    /* Start the workers the first time they are needed. If a thread
+     * cannot be created, carry on with the ones already running. */
+    while (pool.started < pool.threads - 1) {
+        if (pthread_create(&pool.workers[pool.started], NULL, pool_worker, NULL) != 0) {
+            pool.threads = pool.started + 1;
+            break;
+        }
+        pool.started++;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.fn = fn;
+    pool.arg = arg;
+    pool.ntasks = ntasks;
+    pool.next = 0;
+    pool.pending = ntasks;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.wake);
+
+    pool_work();
+    while (pool.pending > 0) {
+        pthread_cond_wait(&pool.idle, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+}
@@ -0,0 +1,13 @@
+#ifndef pool_h
+#define pool_h
+
+/* Fixed pool of worker threads.
+ * pool_run splits a job into numbered tasks and blocks until every task
+ * has run. The calling thread works on tasks too. */
+
+void pool_init(void);
+int pool_threads(void);
+void pool_set_threads(int n);
+void pool_run(void (*fn)(void* arg, long task), void* arg, long ntasks);
+
+#endif
@@ -0,0 +1,152 @@
+#include "lval.h"
+
+#define QUEUE_MIN_CAPACITY 8
+
+/* Heap */
+
+lheap* lheap_new(void) {
+    lheap* h = malloc(sizeof(lheap));
+    h->refs = 1;
+    h->count = 0;
+    h->capacity = QUEUE_MIN_CAPACITY;
+    h->seq = 0;
+    h->items = malloc(sizeof(lheap_entry) * h->capacity);
+    return h;
+}
+
+lheap* lheap_retain(lheap* h) {
+    h->refs++;
+    return h;
+}
+
+void lheap_release(lheap* h) {
+    if (--h->refs > 0) { return; }
+    for (long i = 0; i < h->count; i++) {
+        lval_del(h->items[i].prio);
+        lval_del(h->items[i].val);
+    }
+    free(h->items);
+    free(h);
+}
+
+static bool heap_less(lheap_entry* a, lheap_entry* b) {
+    int c = lval_cmp(a->prio, b->prio);
+    return c < 0 || (c == 0 && a->seq < b->seq);
+}
+
+/* Takes ownership of prio and val */
+void lheap_push(lheap* h, lval* prio, lval* val) {
+    if (h->count == h->capacity) {
+        h->capacity *= 2;
+        h->items = realloc(h->items, sizeof(lheap_entry) * h->capacity);
+    }
+    lheap_entry x = { prio, val, h->seq++ };
+
+    /* Sift up, moving parents down into the hole */
+    long i = h->count++;
+    while (i > 0) {
+        long parent = (i - 1) / 2;
+        if (!heap_less(&x, &h->items[parent])) { break; }
+        h->items[i] = h->items[parent];
+        i = parent;
+    }
+    h->items[i] = x;
+}
+
+/* Removes the least entry, handing ownership to the caller.
+ * Returns false if the heap is empty. */
+bool lheap_pop(lheap* h, lval** prio, lval** val) {
+    if (h->count == 0) { return false; }
+    *prio = h->items[0].prio;
+    *val = h->items[0].val;
+
+    /* Sift the last entry down from the root */
+    lheap_entry x = h->items[--h->count];
+    long i = 0;
+    while (true) {
+        long child = 2 * i + 1;
+        if (child >= h->count) { break; }
+        if (child + 1 < h->count && heap_less(&h->items[child + 1], &h->items[child])) {
+            child++;
+        }
+        if (!heap_less(&h->items[child], &x)) { break; }
+        h->items[i] = h->items[child];
+        i = child;
+    }
+    if (h->count > 0) { h->items[i] = x; }
+    return true;
+}
+
+/* Deque */
+
+ldeque* ldeque_new(void) {
+    ldeque* d = malloc(sizeof(ldeque));
+    d->refs = 1;
+    d->head = 0;
+    d->count = 0;
+    d->capacity = QUEUE_MIN_CAPACITY;
+    d->items = malloc(sizeof(lval*) * d->capacity);
+    return d;
+}
+
+ldeque* ldeque_retain(ldeque* d) {
+    d->refs++;
+    return d;
+}
+
+void ldeque_release(ldeque* d) {
+    if (--d->refs > 0) { return; }
+    for (long i = 0; i < d->count; i++) {
+        lval_del(ldeque_get(d, i));
+    }
+    free(d->items);
+    free(d);
+}
+
+/* Element i from the front, not copied */
+lval* ldeque_get(ldeque* d, long i) {
+    return d->items[(d->head + i) & (d->capacity - 1)];
+}
+
+/* Doubles the buffer when full, unwrapping the elements to the start */
+static void ldeque_reserve(ldeque* d) {
+    if (d->count < d->capacity) { return; }
+    lval** items = malloc(sizeof(lval*) * d->capacity * 2);
+    long first = d->capacity - d->head;
+    memcpy(items, &d->items[d->head], sizeof(lval*) * first);
+    memcpy(&items[first], d->items, sizeof(lval*) * d->head);
+    free(d->items);
+    d->items = items;
+    d->head = 0;
+    d->capacity *= 2;
+}
+
+/* Pushes take ownership of x */
+void ldeque_push_front(ldeque* d, lval* x) {
+    ldeque_reserve(d);
+    d->head = (d->head - 1) & (d->capacity - 1);
+    d->items[d->head] = x;
+    d->count++;
+}
+
+void ldeque_push_back(ldeque* d, lval* x) {
+    ldeque_reserve(d);
+    d->items[(d->head + d->count) & (d->capacity - 1)] = x;
+    d->count++;
+}
+
+/* Pops hand ownership to the caller, NULL if the deque is empty */
+lval* ldeque_pop_front(ldeque* d) {
+    if (d->count == 0) { return NULL; }
+    lval* x = d->items[d->head];
+    d->head = (d->head + 1) & (d->capacity - 1);
+    d->count--;
+    return x;
+}
+
+lval* ldeque_pop_back(ldeque* d) {
+    if (d->count == 0) { return NULL; }
+    lval* x = ldeque_get(d, d->count - 1);
+    d->count--;
+    return x;
+}
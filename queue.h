@@ -0,0 +1,49 @@
+#ifndef queue_h
+#define queue_h
+
+#include <stdbool.h>
+
+struct lval;
+
+/* Binary min-heap of {priority value} entries and a double ended queue
+ * in a ring buffer. Both are mutable and shared by every lval that
+ * refers to them. */
+
+typedef struct lheap_entry {
+    struct lval* prio;
+    struct lval* val;
+    long seq;           /* Insertion order, breaks ties first in first out */
+} lheap_entry;
+
+typedef struct lheap {
+    int refs;
+    long count;
+    long capacity;
+    long seq;
+    lheap_entry* items;
+} lheap;
+
+typedef struct ldeque {
+    int refs;
+    long head;          /* Index of the front element */
+    long count;
+    long capacity;      /* Always a power of two */
+    struct lval** items;
+} ldeque;
+
+lheap* lheap_new(void);
+lheap* lheap_retain(lheap* h);
+void lheap_release(lheap* h);
+void lheap_push(lheap* h, struct lval* prio, struct lval* val);
+bool lheap_pop(lheap* h, struct lval** prio, struct lval** val);
+
+ldeque* ldeque_new(void);
+ldeque* ldeque_retain(ldeque* d);
+void ldeque_release(ldeque* d);
+struct lval* ldeque_get(ldeque* d, long i);
+void ldeque_push_front(ldeque* d, struct lval* x);
+void ldeque_push_back(ldeque* d, struct lval* x);
+struct lval* ldeque_pop_front(ldeque* d);
+struct lval* ldeque_pop_back(ldeque* d);
+
+#endif
@@ -0,0 +1,276 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "lval.h"
+#include "reader.h"
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/* Characters of the grammar's symbol regex */
+static bool is_symbol(char c) {
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || is_digit(c)) {
+        return true;
+    }
+    switch (c) {
+        case '_': case '+': case '-': case '*': case '/': case '%': case '^':
+        case '\\': case '=': case '<': case '>': case '!': case '&': case '|':
+            return true;
+        default: return false;
+    }
+}
+
+lval* lval_read_number(const char* s, long n) {
+    /* Numbers are short, copy them so strtol stops at the end */
+    char small[64];
+    char* text = n < (long) sizeof(small) ? small : malloc(n + 1);
+    memcpy(text, s, n);
+    text[n] = '\0';
+
+    lval* x;
+    errno = 0;
+    if (memchr(text, '.', n)) {
+        double d = strtof(text, NULL);
+        x = errno != ERANGE ? lval_dec(d) : lval_err("Invalid number.");
+    } else {
+        long i = strtol(text, NULL, 10);
+        /* Literals too large for a long are read as bignums */
+        x = errno != ERANGE ? lval_int(i) : lval_big(bignum_from_str(text));
+    }
+    if (text != small) { free(text); }
+    return x;
+}
+
+/* Length of the number at the reader, or 0. Matches the grammar's regex
+ * -?(([0-9]*[.])?[0-9]+([.][0-9]*)?) the way mpc does, without going back
+ * into the optional group once it has matched, so "5." is not a number. */
+static long number_length(reader* r) {
+    const char* q = r->p;
+    if (q < r->end && *q == '-') { q++; }
+    const char* d = q;
+    while (d < r->end && is_digit(*d)) { d++; }
+    if (d < r->end && *d == '.') { q = d + 1; }
+
+    const char* digits = q;
+    while (q < r->end && is_digit(*q)) { q++; }
+    if (q == digits) { return 0; }
+    if (q < r->end && *q == '.') {
+        q++;
+        while (q < r->end && is_digit(*q)) { q++; }
+    }
+    return q - r->p;
+}
+
+/* Skips whitespace and comments. As in the grammar, a comment is ';',
+ * a character other than a newline, then the rest of the line, so an
+ * empty comment is an error. */
+static bool skip(reader* r) {
+    while (r->p < r->end) {
+        if (is_space(*r->p)) {
+            r->p++;
+        } else if (*r->p == ';') {
+            if (r->end - r->p < 2 || r->p[1] == '\n') {
+                r->error = true;
+                return false;
+            }
+            r->p += 2;
+            while (r->p < r->end && *r->p != '\n' && *r->p != '\r') { r->p++; }
+        } else {
+            break;
+        }
+    }
+    return true;
+}
+
+static lval* read_symbol(reader* r) {
+    const char* start = r->p;
+    while (r->p < r->end && is_symbol(*r->p)) { r->p++; }
+    long n = r->p - start;
+    if (n == 4 && memcmp(start, "true", 4) == 0) { return lval_bool(true); }
+    if (n == 5 && memcmp(start, "false", 5) == 0) { return lval_bool(false); }
+
+    lval* v = malloc(sizeof(lval));
+    v->type = LVAL_SYM;
+    v->data.sym = malloc(n + 1);
+    memcpy(v->data.sym, start, n);
+    v->data.sym[n] = '\0';
+    return v;
+}
+
+/* Unescapes as mpcf_unescape does: C escapes are replaced, "\0" is
+ * dropped and any other backslash is kept as it is. */
+static lval* read_string(reader* r) {
+    const char* start = ++r->p;
+    while (r->p < r->end && *r->p != '"') {
+        r->p += *r->p == '\\' && r->p + 1 < r->end ? 2 : 1;
+    }
+    if (r->p >= r->end) {
+        r->error = true;
+        return NULL;
+    }
+    const char* stop = r->p++;
+
+    char* s = malloc(stop - start + 1);
+    long n = 0;
+    for (const char* q = start; q < stop; q++) {
+        if (*q != '\\') {
+            s[n++] = *q;
+            continue;
+        }
+        char c;
+        switch (q[1]) {
+            case 'a': c = '\a'; break;
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            case 't': c = '\t'; break;
+            case 'v': c = '\v'; break;
+            case '\\': c = '\\'; break;
+            case '\'': c = '\''; break;
+            case '"': c = '"'; break;
+            case '0': q++; continue;
+            default: s[n++] = '\\'; continue;
+        }
+        s[n++] = c;
+        q++;
+    }
+    s[n] = '\0';
+
+    lval* v = malloc(sizeof(lval));
+    v->type = LVAL_STR;
+    v->data.str = s;
+    v->hash = 0;
+    return v;
+}
+
+static lval* read_expr(reader* r);
+
+/* Reads expressions up to the closing character, or to the end of the
+ * input when close is 0. Cells grow by doubling rather than one at a
+ * time as lval_add does. */
+static lval* read_list(reader* r, lval* x, char close) {
+    int capacity = 0;
+    while (true) {
+        if (!skip(r)) { break; }
+        if (r->p == r->end) {
+            if (close == 0) { return x; }
+            break;
+        }
+        if (*r->p == close) {
+            r->p++;
+            return x;
+        }
+
+        lval* y = read_expr(r);
+        if (!y) { break; }
+        if (x->count == capacity) {
+            capacity = capacity ? capacity * 2 : 4;
+            x->cell = realloc(x->cell, sizeof(lval*) * capacity);
+        }
+        x->cell[x->count++] = y;
+    }
+    r->error = true;
+    lval_del(x);
+    return NULL;
+}
+
+static lval* read_expr(reader* r) {
+    long n = number_length(r);
+    if (n) {
+        r->p += n;
+        return lval_read_number(r->p - n, n);
+    }
+    char c = *r->p;
+    if (is_symbol(c)) { return read_symbol(r); }
+    if (c == '"') { return read_string(r); }
+    if (c == '(') {
+        r->p++;
+        return read_list(r, lval_sexpr(), ')');
+    }
+    if (c == '{') {
+        r->p++;
+        return read_list(r, lval_qexpr(), '}');
+    }
+    r->error = true;
+    return NULL;
+}
+
+void reader_init(reader* r, const char* s, long n) {
+    r->p = s;
+    r->end = s + n;
+    r->error = false;
+}
+
+lval* reader_next(reader* r) {
+    if (!skip(r) || r->p == r->end) { return NULL; }
+    return read_expr(r);
+}
+
+lval* lval_read_src(const char* s, long n) {
+    reader r;
+    reader_init(&r, s, n);
+    return read_list(&r, lval_sexpr(), 0);
+}
+
+/* Reads a file that cannot be mapped, such as a pipe */
+static bool lsource_read(lsource* s, int fd) {
+    long capacity = 4096;
+    char* data = malloc(capacity);
+    long n = 0;
+    ssize_t got;
+    while ((got = read(fd, data + n, capacity - n)) > 0) {
+        n += got;
+        if (n == capacity) {
+            capacity *= 2;
+            data = realloc(data, capacity);
+        }
+    }
+    if (got < 0) {
+        free(data);
+        return false;
+    }
+    s->data = data;
+    s->count = n;
+    s->mapped = false;
+    return true;
+}
+
+bool lsource_open(lsource* s, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { return false; }
+
+    struct stat st;
+    bool ok = false;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            /* The reader makes one pass from start to end */
+            posix_madvise(p, st.st_size, POSIX_MADV_SEQUENTIAL);
+            s->data = p;
+            s->count = st.st_size;
+            s->mapped = true;
+            ok = true;
+        }
+    }
+    if (!ok) { ok = lsource_read(s, fd); }
+    close(fd);
+    return ok;
+}
+
+void lsource_close(lsource* s) {
+    if (s->mapped) {
+        munmap((void*) s->data, s->count);
+    } else {
+        free((void*) s->data);
+    }
+}
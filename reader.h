@@ -0,0 +1,44 @@
+#ifndef reader_h
+#define reader_h
+
+#include <stdbool.h>
+
+struct lval;
+
+/* Reads source text straight into lvals in a single pass, accepting
+ * the same language as the mpc grammar in grammar.c. The mpc parser is
+ * only needed for its error messages when this reader fails. */
+
+typedef struct reader {
+    const char* p;
+    const char* end;
+    bool error;         /* Set when a read fails on a syntax error */
+} reader;
+
+void reader_init(reader* r, const char* s, long n);
+
+/* Reads the next top level expression, skipping comments. Returns NULL
+ * at the end of the input or on a syntax error, which error tells
+ * apart. */
+struct lval* reader_next(reader* r);
+
+/* Reads every expression in the n bytes at s into an S-Expr, skipping
+ * comments. Returns NULL on a syntax error. */
+struct lval* lval_read_src(const char* s, long n);
+
+/* Contents of a file. Regular files are mapped into memory rather than
+ * read, so the text is not NUL terminated. */
+typedef struct lsource {
+    const char* data;
+    long count;
+    bool mapped;
+} lsource;
+
+/* Returns false if the file cannot be read */
+bool lsource_open(lsource* s, const char* path);
+void lsource_close(lsource* s);
+
+/* A number literal of n characters, as an integer, bignum or decimal */
+struct lval* lval_read_number(const char* s, long n);
+
+#endif
@@ -0,0 +1,82 @@
+#include "lval.h"
+
+static char* copy_str(char* s) {
+    char* c = malloc(strlen(s) + 1);
+    strcpy(c, s);
+    return c;
+}
+
+lshape* lshape_new(char* name, int count, char** fields) {
+    lshape* s = malloc(sizeof(lshape));
+    s->refs = 1;
+    s->name = copy_str(name);
+    s->count = count;
+    s->fields = malloc(sizeof(char*) * count);
+    s->accessors = malloc(sizeof(char*) * count);
+    s->predicate = malloc(strlen(name) + 4);
+    sprintf(s->predicate, "is-%s", name);
+    for (int i = 0; i < count; i++) {
+        s->fields[i] = copy_str(fields[i]);
+        s->accessors[i] = malloc(strlen(name) + strlen(fields[i]) + 2);
+        sprintf(s->accessors[i], "%s-%s", name, fields[i]);
+    }
+    return s;
+}
+
+lshape* lshape_retain(lshape* s) {
+    s->refs++;
+    return s;
+}
+
+void lshape_release(lshape* s) {
+    if (--s->refs > 0) { return; }
+    for (int i = 0; i < s->count; i++) {
+        free(s->fields[i]);
+        free(s->accessors[i]);
+    }
+    free(s->fields);
+    free(s->accessors);
+    free(s->predicate);
+    free(s->name);
+    free(s);
+}
+
+/* Index of a field, or -1 if the shape has no such field */
+int lshape_index(lshape* s, char* field) {
+    for (int i = 0; i < s->count; i++) {
+        if (strcmp(s->fields[i], field) == 0) { return i; }
+    }
+    return -1;
+}
+
+/* True if s has this name and exactly these fields, in this order */
+bool lshape_matches(lshape* s, char* name, int count, char** fields) {
+    if (strcmp(s->name, name) != 0 || s->count != count) { return false; }
+    for (int i = 0; i < count; i++) {
+        if (strcmp(s->fields[i], fields[i]) != 0) { return false; }
+    }
+    return true;
+}
+
+/* Fields start out NULL and must all be filled in by the caller */
+lrecord* lrecord_new(lshape* s) {
+    lrecord* r = malloc(sizeof(lrecord) + sizeof(lval*) * s->count);
+    r->refs = 1;
+    r->shape = lshape_retain(s);
+    for (int i = 0; i < s->count; i++) { r->fields[i] = NULL; }
+    return r;
+}
+
+lrecord* lrecord_retain(lrecord* r) {
+    r->refs++;
+    return r;
+}
+
+void lrecord_release(lrecord* r) {
+    if (--r->refs > 0) { return; }
+    for (int i = 0; i < r->shape->count; i++) {
+        if (r->fields[i]) { lval_del(r->fields[i]); }
+    }
+    lshape_release(r->shape);
+    free(r);
+}
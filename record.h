@@ -0,0 +1,35 @@
+#ifndef record_h
+#define record_h
+
+struct lval;
+
+/* Shape of a record type, shared by the type's functions and values */
+typedef struct lshape {
+    int refs;
+    char* name;
+    int count;
+    char** fields;
+    char** accessors;   /* Names of the accessor functions, name-field */
+    char* predicate;    /* Name of the type test, is-name */
+} lshape;
+
+/* Immutable record value. Fields are stored inline in shape order, so
+ * an accessor is a single load at a fixed index. Values share their
+ * record between copies. */
+typedef struct lrecord {
+    int refs;
+    lshape* shape;
+    struct lval* fields[];
+} lrecord;
+
+lshape* lshape_new(char* name, int count, char** fields);
+lshape* lshape_retain(lshape* s);
+void lshape_release(lshape* s);
+int lshape_index(lshape* s, char* field);
+bool lshape_matches(lshape* s, char* name, int count, char** fields);
+
+lrecord* lrecord_new(lshape* s);
+lrecord* lrecord_retain(lrecord* r);
+void lrecord_release(lrecord* r);
+
+#endif
@@ -0,0 +1,245 @@
+#include <limits.h>
+#include "lval.h"
+#include "serial.h"
+
+enum { SER_INT, SER_DEC, SER_BIG, SER_BOOL, SER_STR, SER_SYM,
+       SER_SEXPR, SER_QEXPR, SER_VEC, SER_MAT };
+
+void lbuf_init(lbuf* b) {
+    b->data = NULL;
+    b->count = 0;
+    b->capacity = 0;
+}
+
+void lbuf_free(lbuf* b) {
+    free(b->data);
+    lbuf_init(b);
+}
+
+/* FNV-1a, the same in every run */
+uint64_t lbuf_hash(lbuf* b) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < b->count; i++) {
+        h ^= b->data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static void lbuf_put(lbuf* b, const void* p, size_t n) {
+    if (b->count + n > b->capacity) {
+        b->capacity = b->capacity * 2 > b->count + n ? b->capacity * 2 : b->count + n + 64;
+        b->data = realloc(b->data, b->capacity);
+    }
+    memcpy(b->data + b->count, p, n);
+    b->count += n;
+}
+
+static void lbuf_byte(lbuf* b, uint8_t x) {
+    lbuf_put(b, &x, 1);
+}
+
+static void lbuf_uint(lbuf* b, uint64_t x) {
+    while (x >= 0x80) {
+        lbuf_byte(b, (uint8_t) (x | 0x80));
+        x >>= 7;
+    }
+    lbuf_byte(b, (uint8_t) x);
+}
+
+/* Zigzag, so small negative numbers stay short */
+static void lbuf_int(lbuf* b, int64_t x) {
+    lbuf_uint(b, ((uint64_t) x << 1) ^ (uint64_t) (x >> 63));
+}
+
+static void lbuf_str(lbuf* b, const char* s) {
+    size_t n = strlen(s);
+    lbuf_uint(b, n);
+    lbuf_put(b, s, n);
+}
+
+bool lval_encode(lbuf* b, lval* v) {
+    switch (v->type) {
+        case LVAL_INT:
+            lbuf_byte(b, SER_INT);
+            lbuf_int(b, v->data.integer);
+            return true;
+        case LVAL_DEC:
+            lbuf_byte(b, SER_DEC);
+            lbuf_put(b, &v->data.decimal, sizeof(double));
+            return true;
+        case LVAL_BIG:
+            lbuf_byte(b, SER_BIG);
+            lbuf_int(b, v->data.big->sign);
+            lbuf_uint(b, v->data.big->count);
+            lbuf_put(b, v->data.big->limbs, sizeof(uint32_t) * v->data.big->count);
+            return true;
+        case LVAL_BOOL:
+            lbuf_byte(b, SER_BOOL);
+            lbuf_byte(b, v->data.boolean);
+            return true;
+        case LVAL_STR:
+            lbuf_byte(b, SER_STR);
+            lbuf_str(b, v->data.str);
+            return true;
+        case LVAL_SYM:
+            lbuf_byte(b, SER_SYM);
+            lbuf_str(b, v->data.sym);
+            return true;
+        case LVAL_SEXPR:
+        case LVAL_QEXPR:
+            lbuf_byte(b, v->type == LVAL_SEXPR ? SER_SEXPR : SER_QEXPR);
+            lbuf_uint(b, v->count);
+            for (int i = 0; i < v->count; i++) {
+                if (!lval_encode(b, v->cell[i])) { return false; }
+            }
+            return true;
+        /* A packed list encodes the same as the Q-Expr it stands for */
+        case LVAL_PACKED: {
+            lvec* x = v->data.vec;
+            lbuf_byte(b, SER_QEXPR);
+            lbuf_uint(b, x->count);
+            for (long i = 0; i < x->count; i++) {
+                if (x->kind == LVEC_INT) {
+                    lbuf_byte(b, SER_INT);
+                    lbuf_int(b, x->items.ints[i]);
+                } else {
+                    lbuf_byte(b, SER_DEC);
+                    lbuf_put(b, &x->items.decs[i], sizeof(double));
+                }
+            }
+            return true;
+        }
+        case LVAL_VEC:
+            lbuf_byte(b, SER_VEC);
+            lbuf_byte(b, v->data.vec->kind);
+            lbuf_uint(b, v->data.vec->count);
+            lbuf_put(b, v->data.vec->items.ints, 8 * v->data.vec->count);
+            return true;
+        case LVAL_MAT:
+            lbuf_byte(b, SER_MAT);
+            lbuf_uint(b, v->data.mat->rows);
+            lbuf_uint(b, v->data.mat->cols);
+            lbuf_put(b, v->data.mat->items,
+                sizeof(double) * v->data.mat->rows * v->data.mat->cols);
+            return true;
+        default: return false;
+    }
+}
+
+static bool read_uint(const uint8_t** p, const uint8_t* end, uint64_t* x) {
+    *x = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*p >= end) { return false; }
+        uint8_t c = *(*p)++;
+        *x |= (uint64_t) (c & 0x7f) << shift;
+        if (!(c & 0x80)) { return true; }
+    }
+    return false;
+}
+
+static bool read_int(const uint8_t** p, const uint8_t* end, int64_t* x) {
+    uint64_t u;
+    if (!read_uint(p, end, &u)) { return false; }
+    *x = (int64_t) (u >> 1) ^ -(int64_t) (u & 1);
+    return true;
+}
+
+/* Reads n bytes as a new NUL terminated string */
+static char* read_str(const uint8_t** p, const uint8_t* end) {
+    uint64_t n;
+    if (!read_uint(p, end, &n) || n > (uint64_t) (end - *p)) { return NULL; }
+    char* s = malloc(n + 1);
+    memcpy(s, *p, n);
+    s[n] = '\0';
+    *p += n;
+    return s;
+}
+
+lval* lval_decode(const uint8_t** p, const uint8_t* end) {
+    if (*p >= end) { return NULL; }
+    int tag = *(*p)++;
+    switch (tag) {
+        case SER_INT: {
+            int64_t x;
+            return read_int(p, end, &x) ? lval_int(x) : NULL;
+        }
+        case SER_DEC: {
+            double x;
+            if (end - *p < (long) sizeof(double)) { return NULL; }
+            memcpy(&x, *p, sizeof(double));
+            *p += sizeof(double);
+            return lval_dec(x);
+        }
+        case SER_BIG: {
+            int64_t sign;
+            uint64_t n;
+            if (!read_int(p, end, &sign) || !read_uint(p, end, &n) ||
+                    n > (uint64_t) (end - *p) / sizeof(uint32_t)) { return NULL; }
+            /* Only a normalised bignum is accepted: zero has no limbs and
+             * no sign, anything else a sign and a non-zero top limb */
+            uint32_t top = 0;
+            if (n) { memcpy(&top, *p + (n - 1) * sizeof(uint32_t), sizeof(uint32_t)); }
+            if (sign < -1 || sign > 1 || (sign == 0) != (n == 0) ||
+                    (n && top == 0) || n > INT_MAX) { return NULL; }
+            bignum* x = malloc(sizeof(bignum));
+            x->sign = (int) sign;
+            x->count = (int) n;
+            x->limbs = malloc((n ? n : 1) * sizeof(uint32_t));
+            memcpy(x->limbs, *p, n * sizeof(uint32_t));
+            *p += n * sizeof(uint32_t);
+            return lval_big(x);
+        }
+        case SER_BOOL:
+            if (*p >= end) { return NULL; }
+            return lval_bool(*(*p)++ != 0);
+        case SER_STR:
+        case SER_SYM: {
+            char* s = read_str(p, end);
+            if (!s) { return NULL; }
+            lval* x = tag == SER_STR ? lval_str(s) : lval_sym(s);
+            free(s);
+            return x;
+        }
+        case SER_SEXPR:
+        case SER_QEXPR: {
+            uint64_t n;
+            if (!read_uint(p, end, &n) || n > (uint64_t) (end - *p)) { return NULL; }
+            lval* x = tag == SER_SEXPR ? lval_sexpr() : lval_qexpr();
+            x->cell = malloc(sizeof(lval*) * (n ? n : 1));
+            for (uint64_t i = 0; i < n; i++) {
+                lval* y = lval_decode(p, end);
+                if (!y) {
+                    lval_del(x);
+                    return NULL;
+                }
+                x->cell[x->count++] = y;
+            }
+            return x;
+        }
+        case SER_VEC: {
+            uint64_t n;
+            if (*p >= end) { return NULL; }
+            int kind = *(*p)++;
+            if ((kind != LVEC_INT && kind != LVEC_DEC) || !read_uint(p, end, &n) ||
+                    n > (uint64_t) (end - *p) / 8) { return NULL; }
+            lvec* x = lvec_new(kind, n);
+            memcpy(x->items.ints, *p, 8 * n);
+            *p += 8 * n;
+            return lval_vec(x);
+        }
+        case SER_MAT: {
+            uint64_t rows, cols;
+            if (!read_uint(p, end, &rows) || !read_uint(p, end, &cols) ||
+                    (rows && cols > (uint64_t) (end - *p) / sizeof(double) / rows)) {
+                return NULL;
+            }
+            lmat* x = lmat_new(rows, cols);
+            if (!x) { return NULL; }
+            memcpy(x->items, *p, sizeof(double) * rows * cols);
+            *p += sizeof(double) * rows * cols;
+            return lval_mat(x);
+        }
+        default: return NULL;
+    }
+}
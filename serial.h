@@ -0,0 +1,33 @@
+#ifndef serial_h
+#define serial_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct lval;
+
+/* Compact binary form of an lval: a tag byte, then integers as
+ * variable length (LEB128) numbers and decimals as their 8 raw bytes.
+ * Only plain data can be encoded: numbers, booleans, strings, symbols,
+ * lists, vectors and matrices. */
+
+typedef struct lbuf {
+    uint8_t* data;
+    size_t count;
+    size_t capacity;
+} lbuf;
+
+void lbuf_init(lbuf* b);
+void lbuf_free(lbuf* b);
+uint64_t lbuf_hash(lbuf* b);
+
+/* Appends v to b, returning false if v holds something without an
+ * encoding. b is left with a partial value in that case. */
+bool lval_encode(lbuf* b, struct lval* v);
+
+/* Decodes one value starting at *p, advancing *p past it.
+ * Returns NULL if the bytes are not a valid encoding. */
+struct lval* lval_decode(const uint8_t** p, const uint8_t* end);
+
+#endif
@@ -0,0 +1,103 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sort.h"
+
+#define SIGN_BIT 0x8000000000000000ULL
+
+uint64_t sort_key_i(int64_t x) {
+    return (uint64_t) x ^ SIGN_BIT;
+}
+
+int64_t sort_unkey_i(uint64_t k) {
+    return (int64_t) (k ^ SIGN_BIT);
+}
+
+/* Flips all bits of negative numbers and just the sign bit of positive
+ * ones. -0.0 is treated as 0.0 so equal values keep their order. */
+uint64_t sort_key_d(double x) {
+    if (x == 0) { x = 0; }
+    uint64_t k;
+    memcpy(&k, &x, sizeof(k));
+    return k & SIGN_BIT ? ~k : k | SIGN_BIT;
+}
+
+/* Least significant digit radix sort on bytes, carrying items (which may
+ * be NULL) along with their keys. Stable, and the scatter loop has no
+ * data dependent branches. Passes where every key has the same byte are
+ * skipped, so small integers only take one or two passes. */
+void sort_radix(uint64_t* keys, void** items, long n) {
+    if (n < 2) { return; }
+
+    long (*counts)[256] = calloc(8, sizeof(*counts));
+    for (long i = 0; i < n; i++) {
+        for (int p = 0; p < 8; p++) {
+            counts[p][(keys[i] >> (8 * p)) & 0xff]++;
+        }
+    }
+
+    uint64_t* ktmp = malloc(sizeof(uint64_t) * n);
+    void** itmp = items ? malloc(sizeof(void*) * n) : NULL;
+
+    for (int p = 0; p < 8; p++) {
+        int shift = 8 * p;
+        if (counts[p][(keys[0] >> shift) & 0xff] == n) { continue; }
+
+        /* Turn counts into starting offsets */
+        long offset = 0;
+        for (int d = 0; d < 256; d++) {
+            long c = counts[p][d];
+            counts[p][d] = offset;
+            offset += c;
+        }
+
+        for (long i = 0; i < n; i++) {
+            long j = counts[p][(keys[i] >> shift) & 0xff]++;
+            ktmp[j] = keys[i];
+            if (items) { itmp[j] = items[i]; }
+        }
+        memcpy(keys, ktmp, sizeof(uint64_t) * n);
+        if (items) { memcpy(items, itmp, sizeof(void*) * n); }
+    }
+
+    free(counts);
+    free(ktmp);
+    free(itmp);
+}
+
+/* Merges the sorted runs src[lo, mid) and src[mid, hi) into dst.
+ * Ties take from the left run, keeping the sort stable. */
+static void merge_runs(void** dst, void** src, long lo, long mid, long hi,
+        sort_less less, void* arg) {
+    long i = lo, j = mid, k = lo;
+    while (i < mid && j < hi) {
+        dst[k++] = less(src[j], src[i], arg) ? src[j++] : src[i++];
+    }
+    while (i < mid) { dst[k++] = src[i++]; }
+    while (j < hi) { dst[k++] = src[j++]; }
+}
+
+/* Bottom up merge sort, for when comparisons are expensive. Pairs of
+ * runs that are already in order are copied without merging, so sorted
+ * input takes about n comparisons in total. */
+void sort_merge(void** items, long n, sort_less less, void* arg) {
+    if (n < 2) { return; }
+    void** tmp = malloc(sizeof(void*) * n);
+    void** src = items;
+    void** dst = tmp;
+
+    for (long width = 1; width < n; width *= 2) {
+        for (long lo = 0; lo < n; lo += 2 * width) {
+            long mid = lo + width < n ? lo + width : n;
+            long hi = lo + 2 * width < n ? lo + 2 * width : n;
+            if (mid == hi || !less(src[mid], src[mid - 1], arg)) {
+                memcpy(&dst[lo], &src[lo], sizeof(void*) * (hi - lo));
+            } else {
+                merge_runs(dst, src, lo, mid, hi, less, arg);
+            }
+        }
+        void** t = src; src = dst; dst = t;
+    }
+
+    if (src != items) { memcpy(items, src, sizeof(void*) * n); }
+    free(tmp);
+}
@@ -0,0 +1,20 @@
+#ifndef sort_h
+#define sort_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Stable sorts for the sort builtin */
+
+/* True if a must come before b */
+typedef bool (*sort_less)(void* a, void* b, void* arg);
+
+/* Unsigned keys that order the same way as the numbers they encode */
+uint64_t sort_key_i(int64_t x);
+uint64_t sort_key_d(double x);
+int64_t sort_unkey_i(uint64_t k);
+
+void sort_radix(uint64_t* keys, void** items, long n);
+void sort_merge(void** items, long n, sort_less less, void* arg);
+
+#endif
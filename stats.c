@@ -0,0 +1,83 @@
+#include <math.h>
+#include "stats.h"
+
+void welford_init(welford* w) {
+    w->count = 0;
+    w->mean = 0;
+    w->m2 = 0;
+}
+
+void welford_add(welford* w, double x) {
+    w->count++;
+    double delta = x - w->mean;
+    w->mean += delta / w->count;
+    w->m2 += delta * (x - w->mean);
+}
+
+/* Sample variance, needs at least two values */
+double welford_variance(welford* w) {
+    return w->m2 / (w->count - 1);
+}
+
+static void swap_d(double* a, double* b) {
+    double t = *a; *a = *b; *b = t;
+}
+
+/* Returns the k-th smallest value (from 0) by quickselect.
+ * Reorders a so everything before k is <= a[k] <= everything after. */
+double stats_select(double* a, long n, long k) {
+    long lo = 0, hi = n - 1;
+    while (hi > lo) {
+        /* Median of three pivot, moved to a[lo] */
+        long mid = lo + (hi - lo) / 2;
+        if (a[mid] < a[lo]) { swap_d(&a[mid], &a[lo]); }
+        if (a[hi] < a[lo]) { swap_d(&a[hi], &a[lo]); }
+        if (a[hi] < a[mid]) { swap_d(&a[hi], &a[mid]); }
+        swap_d(&a[lo], &a[mid]);
+        double pivot = a[lo];
+
+        /* Hoare partition */
+        long i = lo, j = hi + 1;
+        while (1) {
+            do { i++; } while (i <= hi && a[i] < pivot);
+            do { j--; } while (a[j] > pivot);
+            if (i >= j) { break; }
+            swap_d(&a[i], &a[j]);
+        }
+        swap_d(&a[lo], &a[j]);
+
+        if (j == k) { return a[k]; }
+        if (j < k) { lo = j + 1; } else { hi = j - 1; }
+    }
+    return a[k];
+}
+
+/* Quantile q in [0, 1], interpolating linearly between the two closest
+ * order statistics. Reorders a. */
+double stats_quantile(double* a, long n, double q) {
+    double pos = q * (n - 1);
+    long k = (long) floor(pos);
+    double lower = stats_select(a, n, k);
+    if (k + 1 >= n || pos == k) { return lower; }
+
+    /* The next order statistic is the smallest value above k */
+    double upper = a[k+1];
+    for (long i = k + 2; i < n; i++) {
+        if (a[i] < upper) { upper = a[i]; }
+    }
+    return lower + (pos - k) * (upper - lower);
+}
+
+/* Counts values into equal width bins over [lo, hi]. Values equal to hi
+ * go in the last bin, values outside the range and NaNs are ignored. */
+void stats_histogram(const double* a, long n, double lo, double hi,
+        long bins, long* counts) {
+    for (long b = 0; b < bins; b++) { counts[b] = 0; }
+    double scale = hi > lo ? bins / (hi - lo) : 0;
+    for (long i = 0; i < n; i++) {
+        if (isnan(a[i]) || a[i] < lo || a[i] > hi) { continue; }
+        /* Clamped as a double, so the cast is always in range */
+        double x = (a[i] - lo) * scale;
+        counts[x >= 0 && x < bins ? (long) x : bins - 1]++;
+    }
+}
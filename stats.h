@@ -0,0 +1,21 @@
+#ifndef stats_h
+#define stats_h
+
+/* Running mean and sum of squared deviations, updated one value at a
+ * time with Welford's method */
+typedef struct welford {
+    long count;
+    double mean;
+    double m2;
+} welford;
+
+void welford_init(welford* w);
+void welford_add(welford* w, double x);
+double welford_variance(welford* w);
+
+double stats_select(double* a, long n, long k);
+double stats_quantile(double* a, long n, double q);
+void stats_histogram(const double* a, long n, double lo, double hi,
+        long bins, long* counts);
+
+#endif
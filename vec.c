@@ -0,0 +1,679 @@
+#include <stdlib.h>
+#include "vec.h"
+#include "pool.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VEC_X86
+#include <immintrin.h>
+#endif
+
+/***************************************************
+ *  Vector storage
+ ***************************************************/
+
+lvec* lvec_new(int kind, long count) {
+    lvec* v = malloc(sizeof(lvec));
+    v->refs = 1;
+    v->kind = kind;
+    v->count = count;
+    /* Both element types are 8 bytes wide */
+    v->items.ints = malloc(sizeof(int64_t) * (count ? count : 1));
+    return v;
+}
+
+lvec* lvec_retain(lvec* v) {
+    v->refs++;
+    return v;
+}
+
+void lvec_release(lvec* v) {
+    if (--v->refs > 0) { return; }
+    free(v->items.ints);
+    free(v);
+}
+
+/***************************************************
+ *  Scalar kernels
+ ***************************************************/
+
+static bool add_i_scalar(int64_t* r, const int64_t* a, const int64_t* b, long n) {
+    bool ok = true;
+    for (long i = 0; i < n; i++) {
+        ok &= !__builtin_add_overflow(a[i], b[i], &r[i]);
+    }
+    return ok;
+}
+
+/* Sums into 128 bits so no partial sum can overflow */
+static __int128 sum_i_scalar(const int64_t* a, long n) {
+    __int128 total = 0;
+    for (long i = 0; i < n; i++) { total += a[i]; }
+    return total;
+}
+
+static int64_t min_i_scalar(const int64_t* a, long n) {
+    int64_t m = a[0];
+    for (long i = 1; i < n; i++) { m = a[i] < m ? a[i] : m; }
+    return m;
+}
+
+static int64_t max_i_scalar(const int64_t* a, long n) {
+    int64_t m = a[0];
+    for (long i = 1; i < n; i++) { m = a[i] > m ? a[i] : m; }
+    return m;
+}
+
+static void add_d_scalar(double* r, const double* a, const double* b, long n) {
+    for (long i = 0; i < n; i++) { r[i] = a[i] + b[i]; }
+}
+
+static void mul_d_scalar(double* r, const double* a, const double* b, long n) {
+    for (long i = 0; i < n; i++) { r[i] = a[i] * b[i]; }
+}
+
+static void sub_d_scalar(double* r, const double* a, const double* b, long n) {
+    for (long i = 0; i < n; i++) { r[i] = a[i] - b[i]; }
+}
+
+static void axpy_d_scalar(double* y, double a, const double* x, long n) {
+    for (long i = 0; i < n; i++) { y[i] += a * x[i]; }
+}
+
+static double sum_d_scalar(const double* a, long n) {
+    double s = 0;
+    for (long i = 0; i < n; i++) { s += a[i]; }
+    return s;
+}
+
+static double min_d_scalar(const double* a, long n) {
+    double m = a[0];
+    for (long i = 1; i < n; i++) { m = a[i] < m ? a[i] : m; }
+    return m;
+}
+
+static double max_d_scalar(const double* a, long n) {
+    double m = a[0];
+    for (long i = 1; i < n; i++) { m = a[i] > m ? a[i] : m; }
+    return m;
+}
+
+static double dot_d_scalar(const double* a, const double* b, long n) {
+    double s = 0;
+    for (long i = 0; i < n; i++) { s += a[i] * b[i]; }
+    return s;
+}
+
+#ifdef VEC_X86
+
+/***************************************************
+ *  SSE2 kernels
+ ***************************************************/
+
+__attribute__((target("sse2")))
+static bool add_i_sse2(int64_t* r, const int64_t* a, const int64_t* b, long n) {
+    __m128i ov = _mm_setzero_si128();
+    long i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*) (b + i));
+        __m128i s = _mm_add_epi64(x, y);
+        /* Signed overflow iff both operands differ in sign from the sum */
+        ov = _mm_or_si128(ov, _mm_and_si128(_mm_xor_si128(x, s), _mm_xor_si128(y, s)));
+        _mm_storeu_si128((__m128i*) (r + i), s);
+    }
+    bool ok = _mm_movemask_pd(_mm_castsi128_pd(ov)) == 0;
+    return add_i_scalar(r + i, a + i, b + i, n - i) && ok;
+}
+
+/* Accumulates the unsigned high halves, low halves and the number of
+ * negative elements. x = hi * 2^32 + lo - neg * 2^64 */
+__attribute__((target("sse2")))
+static __int128 sum_i_sse2(const int64_t* a, long n) {
+    __int128 total = 0;
+    long i = 0;
+    while (i + 2 <= n) {
+        /* Blocks small enough that no lane can wrap */
+        long end = i + (1L << 30) < n ? i + (1L << 30) : n;
+        __m128i hi = _mm_setzero_si128(), lo = _mm_setzero_si128();
+        __m128i neg = _mm_setzero_si128();
+        __m128i mask = _mm_set1_epi64x(0xffffffff);
+        for (; i + 2 <= end; i += 2) {
+            __m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+            hi = _mm_add_epi64(hi, _mm_srli_epi64(x, 32));
+            lo = _mm_add_epi64(lo, _mm_and_si128(x, mask));
+            neg = _mm_add_epi64(neg, _mm_srli_epi64(x, 63));
+        }
+        uint64_t h[2], l[2], g[2];
+        _mm_storeu_si128((__m128i*) h, hi);
+        _mm_storeu_si128((__m128i*) l, lo);
+        _mm_storeu_si128((__m128i*) g, neg);
+        for (int k = 0; k < 2; k++) {
+            total += ((__int128) h[k] << 32) + l[k] - ((__int128) g[k] << 64);
+        }
+    }
+    return total + sum_i_scalar(a + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void add_d_sse2(double* r, const double* a, const double* b, long n) {
+    long i = 0;
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(r + i, _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    }
+    add_d_scalar(r + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void mul_d_sse2(double* r, const double* a, const double* b, long n) {
+    long i = 0;
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(r + i, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    }
+    mul_d_scalar(r + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void sub_d_sse2(double* r, const double* a, const double* b, long n) {
+    long i = 0;
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(r + i, _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    }
+    sub_d_scalar(r + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void axpy_d_sse2(double* y, double a, const double* x, long n) {
+    __m128d va = _mm_set1_pd(a);
+    long i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d t = _mm_mul_pd(va, _mm_loadu_pd(x + i));
+        _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), t));
+    }
+    axpy_d_scalar(y + i, a, x + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static double sum_d_sse2(const double* a, long n) {
+    __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 = _mm_add_pd(s0, _mm_loadu_pd(a + i));
+        s1 = _mm_add_pd(s1, _mm_loadu_pd(a + i + 2));
+    }
+    double t[2];
+    _mm_storeu_pd(t, _mm_add_pd(s0, s1));
+    return t[0] + t[1] + sum_d_scalar(a + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static double min_d_sse2(const double* a, long n) {
+    if (n < 2) { return min_d_scalar(a, n); }
+    __m128d m = _mm_loadu_pd(a);
+    long i = 2;
+    for (; i + 2 <= n; i += 2) { m = _mm_min_pd(m, _mm_loadu_pd(a + i)); }
+    double t[2];
+    _mm_storeu_pd(t, m);
+    double r = t[0] < t[1] ? t[0] : t[1];
+    for (; i < n; i++) { r = a[i] < r ? a[i] : r; }
+    return r;
+}
+
+__attribute__((target("sse2")))
+static double max_d_sse2(const double* a, long n) {
+    if (n < 2) { return max_d_scalar(a, n); }
+    __m128d m = _mm_loadu_pd(a);
+    long i = 2;
+    for (; i + 2 <= n; i += 2) { m = _mm_max_pd(m, _mm_loadu_pd(a + i)); }
+    double t[2];
+    _mm_storeu_pd(t, m);
+    double r = t[0] > t[1] ? t[0] : t[1];
+    for (; i < n; i++) { r = a[i] > r ? a[i] : r; }
+    return r;
+}
+
+__attribute__((target("sse2")))
+static double dot_d_sse2(const double* a, const double* b, long n) {
+    __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+    double t[2];
+    _mm_storeu_pd(t, _mm_add_pd(s0, s1));
+    return t[0] + t[1] + dot_d_scalar(a + i, b + i, n - i);
+}
+
+/***************************************************
+ *  AVX2 kernels
+ ***************************************************/
+
+__attribute__((target("avx2")))
+static bool add_i_avx2(int64_t* r, const int64_t* a, const int64_t* b, long n) {
+    __m256i ov = _mm256_setzero_si256();
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*) (b + i));
+        __m256i s = _mm256_add_epi64(x, y);
+        ov = _mm256_or_si256(ov, _mm256_and_si256(_mm256_xor_si256(x, s), _mm256_xor_si256(y, s)));
+        _mm256_storeu_si256((__m256i*) (r + i), s);
+    }
+    bool ok = _mm256_movemask_pd(_mm256_castsi256_pd(ov)) == 0;
+    return add_i_scalar(r + i, a + i, b + i, n - i) && ok;
+}
+
+__attribute__((target("avx2")))
+static __int128 sum_i_avx2(const int64_t* a, long n) {
+    __int128 total = 0;
+    long i = 0;
+    while (i + 4 <= n) {
+        long end = i + (1L << 30) < n ? i + (1L << 30) : n;
+        __m256i hi = _mm256_setzero_si256(), lo = _mm256_setzero_si256();
+        __m256i neg = _mm256_setzero_si256();
+        __m256i mask = _mm256_set1_epi64x(0xffffffff);
+        for (; i + 4 <= end; i += 4) {
+            __m256i x = _mm256_loadu_si256((const __m256i*) (a + i));
+            hi = _mm256_add_epi64(hi, _mm256_srli_epi64(x, 32));
+            lo = _mm256_add_epi64(lo, _mm256_and_si256(x, mask));
+            neg = _mm256_add_epi64(neg, _mm256_srli_epi64(x, 63));
+        }
+        uint64_t h[4], l[4], g[4];
+        _mm256_storeu_si256((__m256i*) h, hi);
+        _mm256_storeu_si256((__m256i*) l, lo);
+        _mm256_storeu_si256((__m256i*) g, neg);
+        for (int k = 0; k < 4; k++) {
+            total += ((__int128) h[k] << 32) + l[k] - ((__int128) g[k] << 64);
+        }
+    }
+    return total + sum_i_scalar(a + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static int64_t min_i_avx2(const int64_t* a, long n) {
+    if (n < 4) { return min_i_scalar(a, n); }
+    __m256i m = _mm256_loadu_si256((const __m256i*) a);
+    long i = 4;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (a + i));
+        m = _mm256_blendv_epi8(m, x, _mm256_cmpgt_epi64(m, x));
+    }
+    int64_t t[4];
+    _mm256_storeu_si256((__m256i*) t, m);
+    int64_t r = min_i_scalar(t, 4);
+    for (; i < n; i++) { r = a[i] < r ? a[i] : r; }
+    return r;
+}
+
+__attribute__((target("avx2")))
+static int64_t max_i_avx2(const int64_t* a, long n) {
+    if (n < 4) { return max_i_scalar(a, n); }
+    __m256i m = _mm256_loadu_si256((const __m256i*) a);
+    long i = 4;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (a + i));
+        m = _mm256_blendv_epi8(m, x, _mm256_cmpgt_epi64(x, m));
+    }
+    int64_t t[4];
+    _mm256_storeu_si256((__m256i*) t, m);
+    int64_t r = max_i_scalar(t, 4);
+    for (; i < n; i++) { r = a[i] > r ? a[i] : r; }
+    return r;
+}
+
+__attribute__((target("avx2")))
+static void add_d_avx2(double* r, const double* a, const double* b, long n) {
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(r + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    }
+    add_d_scalar(r + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void mul_d_avx2(double* r, const double* a, const double* b, long n) {
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(r + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    }
+    mul_d_scalar(r + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void sub_d_avx2(double* r, const double* a, const double* b, long n) {
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(r + i, _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    }
+    sub_d_scalar(r + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void axpy_d_avx2(double* y, double a, const double* x, long n) {
+    __m256d va = _mm256_set1_pd(a);
+    long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d t0 = _mm256_mul_pd(va, _mm256_loadu_pd(x + i));
+        __m256d t1 = _mm256_mul_pd(va, _mm256_loadu_pd(x + i + 4));
+        _mm256_storeu_pd(y + i, _mm256_add_pd(_mm256_loadu_pd(y + i), t0));
+        _mm256_storeu_pd(y + i + 4, _mm256_add_pd(_mm256_loadu_pd(y + i + 4), t1));
+    }
+    axpy_d_scalar(y + i, a, x + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static double sum_d_avx2(const double* a, long n) {
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm256_add_pd(s0, _mm256_loadu_pd(a + i));
+        s1 = _mm256_add_pd(s1, _mm256_loadu_pd(a + i + 4));
+    }
+    double t[4];
+    _mm256_storeu_pd(t, _mm256_add_pd(s0, s1));
+    return (t[0] + t[1]) + (t[2] + t[3]) + sum_d_scalar(a + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static double min_d_avx2(const double* a, long n) {
+    if (n < 4) { return min_d_scalar(a, n); }
+    __m256d m = _mm256_loadu_pd(a);
+    long i = 4;
+    for (; i + 4 <= n; i += 4) { m = _mm256_min_pd(m, _mm256_loadu_pd(a + i)); }
+    double t[4];
+    _mm256_storeu_pd(t, m);
+    double r = min_d_scalar(t, 4);
+    for (; i < n; i++) { r = a[i] < r ? a[i] : r; }
+    return r;
+}
+
+__attribute__((target("avx2")))
+static double max_d_avx2(const double* a, long n) {
+    if (n < 4) { return max_d_scalar(a, n); }
+    __m256d m = _mm256_loadu_pd(a);
+    long i = 4;
+    for (; i + 4 <= n; i += 4) { m = _mm256_max_pd(m, _mm256_loadu_pd(a + i)); }
+    double t[4];
+    _mm256_storeu_pd(t, m);
+    double r = max_d_scalar(t, 4);
+    for (; i < n; i++) { r = a[i] > r ? a[i] : r; }
+    return r;
+}
+
+__attribute__((target("avx2")))
+static double dot_d_avx2(const double* a, const double* b, long n) {
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm256_add_pd(s0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        s1 = _mm256_add_pd(s1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+    }
+    double t[4];
+    _mm256_storeu_pd(t, _mm256_add_pd(s0, s1));
+    return (t[0] + t[1]) + (t[2] + t[3]) + dot_d_scalar(a + i, b + i, n - i);
+}
+
+#endif
+
+/***************************************************
+ *  Dispatch
+ ***************************************************/
+
+/* Kernels in use, scalar until vec_init finds something better */
+static struct {
+    char* isa;
+    bool (*add_i)(int64_t*, const int64_t*, const int64_t*, long);
+    __int128 (*sum_i)(const int64_t*, long);
+    int64_t (*min_i)(const int64_t*, long);
+    int64_t (*max_i)(const int64_t*, long);
+    void (*add_d)(double*, const double*, const double*, long);
+    void (*mul_d)(double*, const double*, const double*, long);
+    void (*sub_d)(double*, const double*, const double*, long);
+    void (*axpy_d)(double*, double, const double*, long);
+    double (*sum_d)(const double*, long);
+    double (*min_d)(const double*, long);
+    double (*max_d)(const double*, long);
+    double (*dot_d)(const double*, const double*, long);
+} kernels = {
+    "scalar", add_i_scalar, sum_i_scalar, min_i_scalar, max_i_scalar,
+    add_d_scalar, mul_d_scalar, sub_d_scalar, axpy_d_scalar, sum_d_scalar,
+    min_d_scalar, max_d_scalar, dot_d_scalar
+};
+
+void vec_init(void) {
+#ifdef VEC_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.isa = "avx2";
+        kernels.add_i = add_i_avx2;
+        kernels.sum_i = sum_i_avx2;
+        kernels.min_i = min_i_avx2;
+        kernels.max_i = max_i_avx2;
+        kernels.add_d = add_d_avx2;
+        kernels.mul_d = mul_d_avx2;
+        kernels.sub_d = sub_d_avx2;
+        kernels.axpy_d = axpy_d_avx2;
+        kernels.sum_d = sum_d_avx2;
+        kernels.min_d = min_d_avx2;
+        kernels.max_d = max_d_avx2;
+        kernels.dot_d = dot_d_avx2;
+    }
+    else if (__builtin_cpu_supports("sse2")) {
+        kernels.isa = "sse2";
+        kernels.add_i = add_i_sse2;
+        kernels.sum_i = sum_i_sse2;
+        kernels.add_d = add_d_sse2;
+        kernels.mul_d = mul_d_sse2;
+        kernels.sub_d = sub_d_sse2;
+        kernels.axpy_d = axpy_d_sse2;
+        kernels.sum_d = sum_d_sse2;
+        kernels.min_d = min_d_sse2;
+        kernels.max_d = max_d_sse2;
+        kernels.dot_d = dot_d_sse2;
+    }
+#endif
+}
+
+/* Name of the instruction set the kernels were selected for */
+char* vec_isa(void) {
+    return kernels.isa;
+}
+
+bool vec_add_i(int64_t* r, const int64_t* a, const int64_t* b, long n) {
+    return kernels.add_i(r, a, b, n);
+}
+
+/* There is no packed 64 bit multiply before AVX-512, so this stays scalar */
+bool vec_mul_i(int64_t* r, const int64_t* a, const int64_t* b, long n) {
+    bool ok = true;
+    for (long i = 0; i < n; i++) {
+        ok &= !__builtin_mul_overflow(a[i], b[i], &r[i]);
+    }
+    return ok;
+}
+
+void vec_add_d(double* r, const double* a, const double* b, long n) {
+    kernels.add_d(r, a, b, n);
+}
+
+void vec_mul_d(double* r, const double* a, const double* b, long n) {
+    kernels.mul_d(r, a, b, n);
+}
+
+void vec_sub_d(double* r, const double* a, const double* b, long n) {
+    kernels.sub_d(r, a, b, n);
+}
+
+/* y += a * x */
+void vec_axpy_d(double* y, double a, const double* x, long n) {
+    kernels.axpy_d(y, a, x, n);
+}
+
+/***************************************************
+ *  Reductions
+ ***************************************************/
+
+/* Elements per reduction chunk. Large vectors are reduced chunk by chunk
+ * and the chunk results combined in a fixed order, so sums of decimals
+ * come out the same no matter how many threads ran the chunks. */
+#define VEC_CHUNK 16384
+
+/* Vectors with fewer chunks than this are reduced on the calling thread */
+#define VEC_PARALLEL_CHUNKS 4
+
+enum { RED_SUM_I, RED_MIN_I, RED_MAX_I, RED_DOT_I,
+       RED_SUM_D, RED_MIN_D, RED_MAX_D, RED_DOT_D };
+
+/* Result of reducing one chunk */
+typedef struct {
+    union {
+        __int128 wide;
+        int64_t integer;
+        double decimal;
+    } value;
+    bool ok;
+} vec_partial;
+
+typedef struct {
+    int op;
+    const void* a;
+    const void* b;
+    long n;
+    vec_partial* parts;
+} vec_reduction;
+
+/* Products are accumulated in 128 bits, false if even that overflows */
+static bool dot_i_scalar(const int64_t* a, const int64_t* b, long n, __int128* r) {
+    __int128 s = 0;
+    for (long i = 0; i < n; i++) {
+        if (__builtin_add_overflow(s, (__int128) a[i] * b[i], &s)) { return false; }
+    }
+    *r = s;
+    return true;
+}
+
+static void vec_reduce_chunk(void* arg, long task) {
+    vec_reduction* r = arg;
+    long start = task * VEC_CHUNK;
+    long len = r->n - start < VEC_CHUNK ? r->n - start : VEC_CHUNK;
+    const int64_t* ai = (const int64_t*) r->a + start;
+    const int64_t* bi = (const int64_t*) r->b + start;
+    const double* ad = (const double*) r->a + start;
+    const double* bd = (const double*) r->b + start;
+    vec_partial* p = &r->parts[task];
+
+    p->ok = true;
+    switch (r->op) {
+        case RED_SUM_I: p->value.wide = kernels.sum_i(ai, len); break;
+        case RED_MIN_I: p->value.integer = kernels.min_i(ai, len); break;
+        case RED_MAX_I: p->value.integer = kernels.max_i(ai, len); break;
+        case RED_DOT_I: p->ok = dot_i_scalar(ai, bi, len, &p->value.wide); break;
+        case RED_SUM_D: p->value.decimal = kernels.sum_d(ad, len); break;
+        case RED_MIN_D: p->value.decimal = kernels.min_d(ad, len); break;
+        case RED_MAX_D: p->value.decimal = kernels.max_d(ad, len); break;
+        case RED_DOT_D: p->value.decimal = kernels.dot_d(ad, bd, len); break;
+    }
+}
+
+/* Reduces every chunk, spreading them over the thread pool when there
+ * are enough. Returns the chunk results, which must be freed. */
+static vec_partial* vec_reduce(int op, const void* a, const void* b, long n, long* chunks) {
+    *chunks = (n + VEC_CHUNK - 1) / VEC_CHUNK;
+    vec_reduction r = { op, a, b, n, malloc(sizeof(vec_partial) * *chunks) };
+    if (*chunks < VEC_PARALLEL_CHUNKS) {
+        for (long t = 0; t < *chunks; t++) { vec_reduce_chunk(&r, t); }
+    } else {
+        pool_run(vec_reduce_chunk, &r, *chunks);
+    }
+    return r.parts;
+}
+
+/* Sums chunk results as a balanced tree */
+static double vec_pairwise(const vec_partial* p, long n) {
+    if (n == 1) { return p[0].value.decimal; }
+    long h = n / 2;
+    return vec_pairwise(p, h) + vec_pairwise(p + h, n - h);
+}
+
+__int128 vec_sum_i(const int64_t* a, long n) {
+    if (n <= VEC_CHUNK) { return kernels.sum_i(a, n); }
+    long c;
+    vec_partial* p = vec_reduce(RED_SUM_I, a, NULL, n, &c);
+    __int128 s = 0;
+    for (long i = 0; i < c; i++) { s += p[i].value.wide; }
+    free(p);
+    return s;
+}
+
+int64_t vec_min_i(const int64_t* a, long n) {
+    if (n <= VEC_CHUNK) { return kernels.min_i(a, n); }
+    long c;
+    vec_partial* p = vec_reduce(RED_MIN_I, a, NULL, n, &c);
+    int64_t m = p[0].value.integer;
+    for (long i = 1; i < c; i++) { m = p[i].value.integer < m ? p[i].value.integer : m; }
+    free(p);
+    return m;
+}
+
+int64_t vec_max_i(const int64_t* a, long n) {
+    if (n <= VEC_CHUNK) { return kernels.max_i(a, n); }
+    long c;
+    vec_partial* p = vec_reduce(RED_MAX_I, a, NULL, n, &c);
+    int64_t m = p[0].value.integer;
+    for (long i = 1; i < c; i++) { m = p[i].value.integer > m ? p[i].value.integer : m; }
+    free(p);
+    return m;
+}
+
+/* False if the result does not fit in 128 bits */
+bool vec_dot_i(const int64_t* a, const int64_t* b, long n, __int128* r) {
+    if (n <= VEC_CHUNK) { return dot_i_scalar(a, b, n, r); }
+    long c;
+    vec_partial* p = vec_reduce(RED_DOT_I, a, b, n, &c);
+    bool ok = true;
+    __int128 s = 0;
+    for (long i = 0; i < c && ok; i++) {
+        ok = p[i].ok && !__builtin_add_overflow(s, p[i].value.wide, &s);
+    }
+    free(p);
+    *r = s;
+    return ok;
+}
+
+double vec_sum_d(const double* a, long n) {
+    if (n <= VEC_CHUNK) { return kernels.sum_d(a, n); }
+    long c;
+    vec_partial* p = vec_reduce(RED_SUM_D, a, NULL, n, &c);
+    double s = vec_pairwise(p, c);
+    free(p);
+    return s;
+}
+
+double vec_min_d(const double* a, long n) {
+    if (n <= VEC_CHUNK) { return kernels.min_d(a, n); }
+    long c;
+    vec_partial* p = vec_reduce(RED_MIN_D, a, NULL, n, &c);
+    double m = p[0].value.decimal;
+    for (long i = 1; i < c; i++) { m = p[i].value.decimal < m ? p[i].value.decimal : m; }
+    free(p);
+    return m;
+}
+
+double vec_max_d(const double* a, long n) {
+    if (n <= VEC_CHUNK) { return kernels.max_d(a, n); }
+    long c;
+    vec_partial* p = vec_reduce(RED_MAX_D, a, NULL, n, &c);
+    double m = p[0].value.decimal;
+    for (long i = 1; i < c; i++) { m = p[i].value.decimal > m ? p[i].value.decimal : m; }
+    free(p);
+    return m;
+}
+
+double vec_dot_d(const double* a, const double* b, long n) {
+    if (n <= VEC_CHUNK) { return kernels.dot_d(a, b, n); }
+    long c;
+    vec_partial* p = vec_reduce(RED_DOT_D, a, b, n, &c);
+    double s = vec_pairwise(p, c);
+    free(p);
+    return s;
+}
@@ -0,0 +1,48 @@
+#ifndef vec_h
+#define vec_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Element kinds of a numeric vector */
+enum { LVEC_INT, LVEC_DEC };
+
+/* Contiguous array of unboxed numbers.
+ * The array is shared between copies of an lval, it is freed when the
+ * last reference is released. */
+typedef struct lvec {
+    int refs;
+    int kind;
+    long count;
+    union {
+        int64_t* ints;
+        double* decs;
+    } items;
+} lvec;
+
+lvec* lvec_new(int kind, long count);
+lvec* lvec_retain(lvec* v);
+void lvec_release(lvec* v);
+
+/* Picks the fastest kernels the CPU supports */
+void vec_init(void);
+char* vec_isa(void);
+
+/* Integer kernels report overflow by returning false */
+bool vec_add_i(int64_t* r, const int64_t* a, const int64_t* b, long n);
+bool vec_mul_i(int64_t* r, const int64_t* a, const int64_t* b, long n);
+__int128 vec_sum_i(const int64_t* a, long n);
+int64_t vec_min_i(const int64_t* a, long n);
+int64_t vec_max_i(const int64_t* a, long n);
+bool vec_dot_i(const int64_t* a, const int64_t* b, long n, __int128* r);
+
+void vec_add_d(double* r, const double* a, const double* b, long n);
+void vec_mul_d(double* r, const double* a, const double* b, long n);
+void vec_sub_d(double* r, const double* a, const double* b, long n);
+void vec_axpy_d(double* y, double a, const double* x, long n);
+double vec_sum_d(const double* a, long n);
+double vec_min_d(const double* a, long n);
+double vec_max_d(const double* a, long n);
+double vec_dot_d(const double* a, const double* b, long n);
+
+#endif